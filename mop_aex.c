@@ -0,0 +1,162 @@
+/** @file   mop_aex.c
+  *
+  * @brief MOPTOP acquisition auto-exposure
+  *
+  *        Before an acquisition (-xq) run the master takes up to AEX_FRAMES single, internally triggered frames
+  *        of the target and measures peak and background with img_stats(). Exposure is scaled each frame so the
+  *        peak approaches aex_peak of the saturation level, in steps of at most AEX_STEP. If the exposure needed
+  *        is too long even at AEX_VEL_MIN the binning is raised. The rotator is slowed if the exposure no longer
+  *        fits between triggers. Results are applied with option codes, as from the command line, and the same
+  *        codes are passed on for the slaves to append to their RUN message.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#include "mopnet.h"
+#define FAC FAC_AEX
+
+/** @brief      Take a single internally triggered frame and measure it
+  *
+  * @param[in]  *cam = pointer to camera info structure, configured
+  * @param[in]   exp = [s] exposure
+  * @param[out] *sta = frame statistics
+  *
+  * @return      true | false = Success | Failure
+  */
+static bool aex_frame( mop_cam_t *cam, double exp, img_sta_t *sta )
+{
+    AT_U8 *buf;
+    int    len;
+    bool   ok;
+
+    if (!( at_try( cam, AT_SetEnumString, L"TriggerMode" , CAM_TRG_INT    )&&
+           at_try( cam, AT_SetEnumString, L"CycleMode"   , L"Fixed"       )&&
+           at_try( cam, AT_SetInt       , L"FrameCount"  , (AT_64)1       )&&
+           at_try( cam, AT_SetFloat     , L"ExposureTime", exp            )&&
+           at_try( cam, AT_GetFloat     , L"ExposureTime", &cam->ExpVal   )  ))
+        return mop_log( false, LOG_ERR, FAC, "aex_frame() setup" );
+
+    ok = at_chk( AT_QueueBuffer( cam->Handle, cam->ImageBuffer[0], cam->ImageSizeBytes ), "QueueBuffer", L"" ) &&
+         at_try( cam, AT_Command, L"AcquisitionStart", NULL ) &&
+         at_chk( AT_WaitBuffer( cam->Handle, &buf, &len, TIM_MILLISECOND * exp + TMO_XFR ), "WaitBuffer", L"" );
+
+    at_try( cam, AT_Command, L"AcquisitionStop", NULL );
+    at_try( cam, AT_Flush  , L""               , NULL );
+
+    return ok ? img_stats( cam, fts_mono16( cam, 0 ), sta ) : mop_log( false, LOG_ERR, FAC, "aex_frame() acquisition" );
+}
+
+
+/** @brief      Longest exposure this run can use. Rotating runs keep at least AEX_VEL_MIN
+  *
+  * @param[in] *cam = pointer to camera info structure, configured
+  *
+  * @return     [s] exposure
+  */
+static double aex_max( mop_cam_t *cam )
+{
+    double max = fmin( cam->ExpMax, AEX_EXP_MAX );
+
+    if ( rot_sign )
+        max = fmin( max, fabs( rot_stp ) / AEX_VEL_MIN - 2.0 * cam->ReadoutTime );
+
+    return fmax( max, cam->ExpMin );
+}
+
+
+/** @brief      Find exposure, and if needed binning and rotator velocity, for the target.
+  *             Master only. Filter must be in the beam so waits for the wheel.
+  *
+  * @param[in]  *cam = pointer to camera info structure
+  * @param[out] *opt = option codes applied, to forward to slaves. Empty if none
+  * @param[in]   len = size of opt
+  *
+  * @return      true | false = Target level reached | Settings unchanged or best effort
+  */
+bool aex_run( mop_cam_t *cam, char *opt, size_t len )
+{
+    img_sta_t sta;
+    char      arg[3][MAX_STR];
+    char     *argv[4] = { "aex", arg[0], arg[1], arg[2] };
+    int       argc = 2;
+    int       bin  = img_bin;
+    double    exp, max, full, sig, f;
+    double    vel  = rot_vel;
+    bool      done = false;
+    struct timespec beg;
+    struct timespec end;
+
+    *opt = '\0';
+    if ( fts_pfx != FTS_PFX_ACQ || aex_peak <= 0.0 )
+        return true;
+
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    mop_log( whl_wait( TMO_WHL ), LOG_DBG, FAC, "whl_wait()");
+    if ( !cam_conf( cam, cam_exp ) )
+        return mop_log( false, LOG_ERR, FAC, "cam_conf()" );
+
+    exp = cam->ExpVal;
+    for ( int i = 0; i < AEX_FRAMES; i++ )
+    {
+        if ( !aex_frame( cam, exp, &sta ) )
+            return false;
+
+//      Scale peak above background towards target, large steps down if saturated
+        full = sta.lim / IMG_SAT;
+        sig  = sta.max - sta.bkg;
+        if ( sta.sat || aex_peak * full <= sta.bkg )
+            f = 1.0 / AEX_STEP;
+        else if ( sig < 1.0 )
+            f = AEX_STEP;
+        else
+            f = fmin( fmax( ( aex_peak * full - sta.bkg ) / sig, 1.0 / AEX_STEP ), AEX_STEP );
+
+        mop_log( true, LOG_INF, FAC, "Frame %i bin %i exp %.4fs. Peak %u bkg %.1f sat %u. Target %.0f ADU",
+                 i+1, img_bin, cam->ExpVal, sta.max, sta.bkg, sta.sat, aex_peak * full );
+
+        if ( fabs( f - 1.0 ) < AEX_TOL )
+        {
+            done = true;
+            break;
+        }
+
+//      Too faint at longest exposure so bin up if possible, 4x signal per pixel
+        max = aex_max( cam );
+        if ( exp * f > max && img_bin < AEX_BIN_MAX )
+        {
+            snprintf( arg[0], MAX_STR, "-b%i", img_bin * 2 );
+            if ( !mop_opts( 2, argv, CAM_ARGS, CAM_CHKS ) || !cam_conf( cam, exp ))
+                return mop_log( false, LOG_ERR, FAC, "Binning %s", arg[0] );
+            f  /= 4.0;
+            max = aex_max( cam );
+        }
+
+        f = fmin( fmax( exp * f, cam->ExpMin ), max );
+        if ( f == exp )
+        {
+            mop_log( false, LOG_WRN, FAC, "Exposure at %s limit %.4fs", exp == max ? "upper" : "lower", exp );
+            break;
+        }
+        exp = f;
+    }
+
+//  Slow rotator if exposure and readout no longer fit between triggers
+    if ( rot_sign && exp + 2.0 * cam->ReadoutTime > fabs( rot_stp ) / rot_vel )
+        vel = fabs( rot_stp ) / ( exp + 2.0 * cam->ReadoutTime );
+
+    snprintf( arg[0], MAX_STR, "-e%.6f", exp );
+    if ( vel != rot_vel )
+        snprintf( argv[argc++], MAX_STR, "-v%.3f", rot_sign == ROT_CCW ? -vel : vel );
+    if ( bin != img_bin )
+        snprintf( argv[argc++], MAX_STR, "-b%i", img_bin );
+    if ( !mop_opts( argc, argv, CAM_ARGS, CAM_CHKS ))
+        return mop_log( false, LOG_ERR, FAC, "mop_opts()" );
+
+    for ( int i = 1; i < argc; i++ )
+        snprintf( opt + strlen( opt ), len - strlen( opt ), " %s", argv[i] );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    return mop_log( done, done ? LOG_INF : LOG_WRN, FAC, "Auto-exposure%s in %.3fs", opt, utl_ts_dif( &end, &beg ));
+}
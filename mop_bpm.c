@@ -0,0 +1,317 @@
+/** @file   mop_bpm.c
+  *
+  * @brief MOPTOP bad pixel map
+  *
+  *        Every master dark also makes a map of pixels more than BPM_NSIG robust sigma, and at least BPM_ADU,
+  *        away from the master's median. Hot pixels are flagged BPM_HOT and cold ones BPM_COLD. Maps are one
+  *        byte per pixel, saved next to the masters and keyed by camera serial number, binning and window.
+  *        The camera's own StaticBlemishCorrection stays off so frames remain raw. With -I1 the map is written
+  *        to each frame as a DQ extension. With -I2 flagged pixels of science frames are replaced by the mean of
+  *        their good 4-neighbours in a copy, leaving the published frame untouched. Flagged pixels are sparse
+  *        so they are kept as an index list and only they are visited after the frame is copied.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#include "mopnet.h"
+#define FAC FAC_BPM
+
+static uint8_t  *bpm_map = NULL;  // Map for bpm_cur
+static size_t    bpm_cap = 0;     // Map allocation [pixels]
+static uint32_t *bpm_idx = NULL;  // Indices of flagged pixels
+static int       bpm_num = -1;    // Flagged pixels. -1 = No map for bpm_cur
+static char      bpm_cur[MAX_STR];// Key of map held, even if a miss
+static uint16_t *bpm_out = NULL;  // Interpolated output
+static size_t    bpm_max = 0;     // Output allocation [pixels]
+
+/** @brief      Compare floats for qsort()
+  *
+  * @param[in]  *a = value
+  * @param[in]  *b = value
+  *
+  * @return     <0 | 0 | >0 = a < b | a == b | a > b
+  */
+static int bpm_cmp( const void *a, const void *b )
+{
+    float d = *(const float *)a - *(const float *)b;
+
+    return ( d > 0.0f ) - ( d < 0.0f );
+}
+
+
+/** @brief      Interpolate one flagged pixel from whichever good 4-neighbours exist
+  *
+  * @param[in]  *in  = input pixels
+  * @param[in]  *bad = map
+  * @param[in]   w   = width
+  * @param[in]   h   = height
+  * @param[in]   i   = pixel index
+  *
+  * @return      interpolated value, or input if no good neighbour
+  */
+static uint16_t bpm_pix( const uint16_t *in, const uint8_t *bad, size_t w, size_t h, size_t i )
+{
+    size_t x = i % w;
+    size_t y = i / w;
+    int    n = 0;
+    int    s = 0;
+
+    if ( x > 0     && !bad[i-1] ) { s += in[i-1]; n++; }
+    if ( x + 1 < w && !bad[i+1] ) { s += in[i+1]; n++; }
+    if ( y > 0     && !bad[i-w] ) { s += in[i-w]; n++; }
+    if ( y + 1 < h && !bad[i+w] ) { s += in[i+w]; n++; }
+
+    return n ? ( s + n / 2 ) / n : in[i];
+}
+
+
+/** @brief      Build map key for the current geometry. Only filename-safe characters kept
+  *
+  * @param[in]  *cam = pointer to camera info structure, configured
+  * @param[out] *key = key
+  */
+static void bpm_key( mop_cam_t *cam, char *key )
+{
+    char  raw[MAX_STR];
+    char *k = key;
+
+    snprintf( raw, sizeof(raw), "%ls_bpm_b%i_%lldx%lld+%lld+%lld",
+              cam->SerialNumber, img_bin, cam->AOIWidth, cam->AOIHeight, cam->AOILeft-1, cam->AOITop-1 );
+
+    for ( char *r = raw; *r; r++ )
+        if ( isalnum( *r ) || strchr( "+-._", *r ))
+            *k++ = *r;
+    *k = '\0';
+}
+
+
+/** @brief      Make room for a map of the current frame size. Allocation only grows
+  *
+  * @return     true | false = Success | Failure
+  */
+static bool bpm_alloc( void )
+{
+    if ( img_mono16size <= bpm_cap )
+        return true;
+
+    free( bpm_map );
+    bpm_cap = 0;
+    if ( !( bpm_map = aligned_alloc( 16, ( img_mono16size + 15 ) / 16 * 16 )))
+        return mop_log( false, LOG_SYS, FAC, "aligned_alloc() %s", strerror(errno) );
+    bpm_cap = img_mono16size;
+
+    return true;
+}
+
+
+/** @brief      Count flagged pixels and list their indices
+  *
+  * @return     true | false = Success | Failure, no map held
+  */
+static bool bpm_list( void )
+{
+    size_t    num = img_mono16size;
+    uint8_t  *map = bpm_map;
+    uint32_t *idx;
+    int       n   = 0;
+
+    for ( size_t i = 0; i < num; i++ )
+        n += map[i] != 0;
+
+    if ( !( idx = realloc( bpm_idx, ( n + 1 ) * sizeof(uint32_t) )))
+    {
+        bpm_num = -1;
+        return mop_log( false, LOG_SYS, FAC, "realloc() %s", strerror(errno) );
+    }
+    bpm_idx = idx;
+
+    n = 0;
+    for ( size_t i = 0; i < num; i++ )
+        if ( map[i] )
+            idx[n++] = i;
+    bpm_num = n;
+
+    return true;
+}
+
+
+/** @brief      Make, hold and save the map from a new master dark
+  *
+  * @param[in]  *cam  = pointer to camera info structure, configured
+  * @param[in]  *dark = master dark [ADU]
+  *
+  * @return      true | false = Success | Failure
+  */
+bool bpm_make( mop_cam_t *cam, const float *dark )
+{
+    static float smp[BPM_SAMPLES];
+    char      name[MAX_STR];
+    char      text[80];
+    size_t    num  = img_mono16size;
+    size_t    step = num / BPM_SAMPLES | 1;
+    int       n    = 0;
+    int       stat = 0;
+    int       hot  = 0;
+    float     med, sig, lo, hi;
+    uint8_t  *map;
+    fitsfile *fp;
+
+    bpm_cur[0] = '\0';
+    bpm_num    = -1;
+    if ( !bpm_alloc() )
+        return false;
+    map = bpm_map;
+
+//  Median and robust sigma from an evenly spread sample
+    for ( size_t i = step / 2; i < num && n < BPM_SAMPLES; i += step )
+        smp[n++] = dark[i];
+    if ( !n )
+        return mop_log( false, LOG_ERR, FAC, "Empty master" );
+    qsort( smp, n, sizeof(float), bpm_cmp );
+    med = smp[n/2];
+    for ( int i = 0; i < n; i++ )
+        smp[i] = fabsf( smp[i] - med );
+    qsort( smp, n, sizeof(float), bpm_cmp );
+    sig = 1.4826f * smp[n/2];
+
+    hi = med + fmaxf( BPM_NSIG * sig, BPM_ADU );
+    lo = med - fmaxf( BPM_NSIG * sig, BPM_ADU );
+    for ( size_t i = 0; i < num; i++ )
+        map[i] = ( dark[i] > hi ) * BPM_HOT | ( dark[i] < lo ) * BPM_COLD;
+
+    for ( size_t i = 0; i < num; i++ )
+        hot += map[i] == BPM_HOT;
+    if ( !bpm_list() )
+        return false;
+    bpm_key( cam, bpm_cur );
+
+//  Save, overwriting any older map
+    snprintf( name, sizeof(name), "!"LIB_FILE, bpm_cur );
+    fits_create_file( &fp, name, &stat );
+    fits_create_img ( fp, BYTE_IMG, IMG_DIMENSIONS, cam->Dimension, &stat );
+    fits_write_key  ( fp, TSTRING, "OBSTYPE ", "BAD-PIXEL-MAP", "", &stat );
+    fits_write_key  ( fp, TINT   , "NBADPIX ", &bpm_num     , "Pixels flagged"                    , &stat );
+    fits_write_key  ( fp, TINT   , "NHOTPIX ", &hot         , "Flagged hot, value 1. Cold are 2"  , &stat );
+    fits_write_key  ( fp, TFLOAT , "DARKMED ", &med         , "[ADU] Master dark median"          , &stat );
+    fits_write_key  ( fp, TFLOAT , "DARKSIG ", &sig         , "[ADU] Master dark robust sigma"    , &stat );
+    fits_write_key  ( fp, TINT   , "RUN     ", &fts_run     , "Source run number"                 , &stat );
+    fits_write_key  ( fp, TDOUBLE, "EXPTIME ", &cam->ExpVal , "[sec] Dark exposure"               , &stat );
+    fits_write_img  ( fp, TBYTE  , 1, img_mono16size, bpm_map, &stat );
+    fits_close_file ( fp, &stat );
+    if ( stat )
+    {
+        fits_get_errstatus( stat, text );
+        return mop_log( false, LOG_ERR, FAC, "Map %s status=%i=%s. Held in memory only", name+1, stat, text );
+    }
+
+    return mop_log( true, LOG_INF, FAC, "Map %s. %i hot, %i cold. Median %.1f sigma %.2f ADU",
+                    name+1, hot, bpm_num - hot, med, sig );
+}
+
+
+/** @brief      Map for the current geometry. Loaded from disk when the geometry changes
+  *
+  * @param[in]  *cam = pointer to camera info structure, configured
+  * @param[out] *num = pixels flagged
+  * @param[out] *key = key of map
+  *
+  * @return      map | NULL = No map
+  */
+uint8_t *bpm_get( mop_cam_t *cam, int *num, char *key )
+{
+    char      name[MAX_STR];
+    long      dim[IMG_DIMENSIONS] = {0};
+    int       stat = 0;
+    int       nul;
+    bool      ok;
+    fitsfile *fp;
+
+    bpm_key( cam, key );
+    if ( strcmp( key, bpm_cur ))
+    {
+        strcpy( bpm_cur, key );
+        bpm_num = -1;
+        snprintf( name, sizeof(name), LIB_FILE, key );
+        if ( fits_open_file( &fp, name, READONLY, &stat ))
+        {
+            mop_log( false, LOG_WRN, FAC, "No bad pixel map %s. Take a dark run", name );
+            return NULL;
+        }
+
+        fits_get_img_size( fp, IMG_DIMENSIONS, dim, &stat );
+        ok = !stat && dim[IMG_WIDTH] * dim[IMG_HEIGHT] == img_mono16size && bpm_alloc();
+        if ( ok )
+            fits_read_img( fp, TBYTE, 1, img_mono16size, NULL, bpm_map, &nul, &stat );
+        fits_close_file( fp, &stat );
+        if ( stat || !ok )
+        {
+            mop_log( false, LOG_WRN, FAC, "Bad pixel map %s unreadable or wrong size", name );
+            return NULL;
+        }
+
+        if ( !bpm_list() )
+            return NULL;
+        mop_log( true, LOG_INF, FAC, "Loaded bad pixel map %s. %i pixels", name, bpm_num );
+    }
+
+    *num = bpm_num;
+    return bpm_num < 0 ? NULL : bpm_map;
+}
+
+
+/** @brief      Copy of a frame with flagged pixels interpolated
+  *
+  * @param[in]  *cam = pointer to camera info structure, configured
+  * @param[in]  *pix = Mono16 pixels
+  * @param[in]  *bad = map from bpm_get()
+  *
+  * @return      interpolated copy | NULL = Allocation failed, write uncorrected
+  */
+AT_U8 *bpm_fix( mop_cam_t *cam, AT_U8 *pix, const uint8_t *bad )
+{
+    const uint16_t *in = (uint16_t *)pix;
+    size_t          w  = cam->Dimension[IMG_WIDTH];
+    size_t          h  = cam->Dimension[IMG_HEIGHT];
+
+    if ( img_mono16size > bpm_max )
+    {
+        free( bpm_out );
+        bpm_max = 0;
+        if ( !( bpm_out = aligned_alloc( 16, ( 2 * img_mono16size + 15 ) / 16 * 16 )))
+        {
+            mop_log( false, LOG_SYS, FAC, "aligned_alloc() %s. Writing uncorrected", strerror(errno) );
+            return NULL;
+        }
+        bpm_max = img_mono16size;
+    }
+
+    memcpy( bpm_out, in, 2 * img_mono16size );
+    for ( int k = 0; k < bpm_num; k++ )
+        bpm_out[ bpm_idx[k] ] = bpm_pix( in, bad, w, h, bpm_idx[k] );
+
+    return (AT_U8 *)bpm_out;
+}
+
+
+/** @brief      Append map as a DQ image extension to an open FITS file
+  *
+  * @param[in]  *fp  = open FITS file, primary image written
+  * @param[in]  *cam = pointer to camera info structure
+  * @param[in]  *bad = map from bpm_get()
+  *
+  * @return      FITS status
+  */
+int bpm_dq( fitsfile *fp, mop_cam_t *cam, uint8_t *bad )
+{
+    int stat = 0;
+
+    fits_create_img( fp, BYTE_IMG, IMG_DIMENSIONS, cam->Dimension, &stat );
+    fits_write_key ( fp, TSTRING, "EXTNAME ", "DQ", "Data quality", &stat );
+    fits_write_key ( fp, TSTRING, "BPMAP   ", bpm_cur, "Bad pixel map", &stat );
+    fits_write_comment( fp, "0 = Good, 1 = Hot, 2 = Cold in master dark", &stat );
+    fits_write_img ( fp, TBYTE, 1, img_mono16size, bad, &stat );
+
+    return stat;
+}
@@ -0,0 +1,224 @@
+/** @file   mop_cal.c
+  *
+  * @brief MOPTOP readout mode calibration and selection
+  *
+  *        Calibration sweeps the supported read rate, read order, encoding, amplifier and binning combinations.
+  *        For each it records the camera ReadoutTime, ImageSizeBytes and a measured frame period in a cache file.
+  *        Run setup can then pick the fastest cached mode meeting a bit depth and read noise requirement.
+  *        Modes are applied through mop_opts() using the same option codes as the command line.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#include "mopnet.h"
+#define FAC FAC_CAL
+
+// Sweep, as command line option codes
+static char *cal_mhz[] = { "100", "270" };
+static char *cal_rd [] = { "BUSEQ", "BUSIM", "COSIM", "OISIM", "TDSEQ", "TDSIM" };
+static char *cal_enc[] = { "12", "12PACK", "16" };
+static char *cal_amp[] = { "12H", "12L", "16L" };
+static char *cal_bin[] = { "1", "2", "3", "4", "8" };
+
+#define CAL_N(a) ( sizeof(a) / sizeof(a[0]) )
+
+/** @brief      Bit depth delivered by an amplifier mode
+  *
+  * @param[in] *amp = amplifier option code
+  *
+  * @return     bits
+  */
+static int cal_bits( char *amp )
+{
+    return strcmp( amp, "16L" ) ? 12 : 16;
+}
+
+
+/** @brief      Apply a mode using option codes
+  *
+  * @param[in] *mhz = read rate
+  * @param[in] *rd  = read order
+  * @param[in] *enc = encoding
+  * @param[in] *amp = amplifier mode
+  * @param[in] *bin = binning. NULL = unchanged
+  *
+  * @return     true | false = Success | Failure
+  */
+static bool cal_set( char *mhz, char *rd, char *enc, char *amp, char *bin )
+{
+    char  opt[5][MAX_STR];
+    char *arg[6] = { "cal", opt[0], opt[1], opt[2], opt[3], opt[4] };
+
+    snprintf( opt[0], MAX_STR, "-f%s", mhz );
+    snprintf( opt[1], MAX_STR, "-o%s", rd  );
+    snprintf( opt[2], MAX_STR, "-p%s", enc );
+    snprintf( opt[3], MAX_STR, "-m%s", amp );
+    snprintf( opt[4], MAX_STR, "-b%s", bin ? bin : "" );
+
+    return mop_opts( bin ? 6 : 5, arg, CAM_ARGS, CAM_CHKS );
+}
+
+
+/** @brief      Measure frame period with internal triggering at minimum exposure.
+  *             Uses camera timestamps so host scheduling does not affect the result.
+  *
+  * @param[in]  *cam    = pointer to camera info structure, configured
+  * @param[out] *period = frame period [s]
+  *
+  * @return      true | false = Success | Failure
+  */
+static bool cal_period( mop_cam_t *cam, double *period )
+{
+    AT_U8 *buf;
+    int    len;
+    AT_64  clk[CAL_FRAMES];
+    bool   ok = true;
+
+    if (!( at_try( cam, AT_SetEnumString, L"TriggerMode", CAM_TRG_INT      )&&
+           at_try( cam, AT_SetEnumString, L"CycleMode"  , L"Fixed"         )&&
+           at_try( cam, AT_SetInt       , L"FrameCount" , (AT_64)CAL_FRAMES)&&
+           at_try( cam, AT_SetFloat     , L"ExposureTime", cam->ExpMin     )  ))
+        return mop_log( false, LOG_ERR, FAC, "cal_period() setup" );
+
+    for ( int i = 0; i < CAL_FRAMES; i++ )
+        ok = ok && at_chk( AT_QueueBuffer( cam->Handle, cam->ImageBuffer[i], cam->ImageSizeBytes ), "QueueBuffer", L"" );
+
+    ok = ok && at_try( cam, AT_Command, L"AcquisitionStart", NULL );
+    for ( int i = 0; ok && i < CAL_FRAMES; i++ )
+        if (( ok = at_chk( AT_WaitBuffer( cam->Handle, &buf, &len, TMO_XFR ), "WaitBuffer", L"" )))
+            clk[i] = cam_ticks( cam, i );
+
+    at_try( cam, AT_Command, L"AcquisitionStop", NULL );
+    at_try( cam, AT_Flush  , L""               , NULL );
+
+    if ( !ok || !cam->TimestampClockFrequency )
+        return mop_log( false, LOG_ERR, FAC, "cal_period() acquisition" );
+
+    *period = (double)( clk[CAL_FRAMES-1] - clk[0] ) / ( CAL_FRAMES-1 ) / cam->TimestampClockFrequency;
+
+    return true;
+}
+
+
+/** @brief      Calibrate all supported modes and write the cache file.
+  *             Camera is opened here so run stand-alone, e.g. mopnet -c1 -K
+  *
+  * @param[in] *cam = pointer to camera info structure
+  *
+  * @return     true | false = Success | Failure
+  */
+bool cal_run( mop_cam_t *cam )
+{
+    char   name[MAX_STR];
+    FILE  *fp;
+    double period = 0.0;
+    int    num = 0;
+    int    bad = 0;
+
+    snprintf( name, sizeof(name), CAL_FILE, cam_num+1 );
+    if ( !( cam_init( cam_num ) && cam_open( cam ) && cam_conf( cam, cam_exp ) && cam_alloc( cam ) && cam_ring( cam, CAL_FRAMES ) ))
+        return mop_log( false, LOG_ERR, FAC, "Camera init. failed" );
+
+    if ( !( fp = fopen( name, "w" )))
+        return mop_log( false, LOG_SYS, FAC, "fopen(%s) %s", name, strerror(errno) );
+
+    fprintf( fp, "# MOPTOP readout mode calibration %s\n", MOP_VERSION );
+    fprintf( fp, "# Serial MHz Order Encoding Amp Bin ReadoutTime[s] ImageSizeBytes Period[s] Noise[e] Gain[e/ADU]\n" );
+
+    for ( int f = 0; f < CAL_N(cal_mhz); f++ )
+    for ( int o = 0; o < CAL_N(cal_rd ); o++ )
+    for ( int p = 0; p < CAL_N(cal_enc); p++ )
+    for ( int m = 0; m < CAL_N(cal_amp); m++ )
+    for ( int b = 0; b < CAL_N(cal_bin); b++ )
+    {
+//      12-bit encodings cannot hold 16-bit amplifier data
+        if ( cal_bits( cal_amp[m] ) > 12 && strcmp( cal_enc[p], "16" ))
+            continue;
+
+        if ( !cal_set( cal_mhz[f], cal_rd[o], cal_enc[p], cal_amp[m], cal_bin[b] ) ||
+             !cam_conf( cam, cam_exp ) || !cal_period( cam, &period ))
+        {
+            bad++;
+            mop_log( false, LOG_WRN, FAC, "Unsupported -f%s -o%s -p%s -m%s -b%s", cal_mhz[f], cal_rd[o], cal_enc[p], cal_amp[m], cal_bin[b] );
+            continue;
+        }
+
+        fprintf( fp, "%ls %s %s %s %s %s %.6f %lld %.6f %.3f %.3f\n", cam->SerialNumber,
+                 cal_mhz[f], cal_rd[o], cal_enc[p], cal_amp[m], cal_bin[b],
+                 cam->ReadoutTime, (long long)cam->ImageSizeBytes, period, cam->Noise, cam->Gain );
+        fflush( fp );
+        num++;
+        mop_log( true, LOG_INF, FAC, "-f%s -o%s -p%s -m%s -b%s ReadoutTime = %.4fs Period = %.4fs",
+                 cal_mhz[f], cal_rd[o], cal_enc[p], cal_amp[m], cal_bin[b], cam->ReadoutTime, period );
+    }
+    fclose( fp );
+
+    return mop_log( num > 0, LOG_INF, FAC, "Calibrated %i modes, %i unsupported. Cache %s", num, bad, name );
+}
+
+
+/** @brief      Select the fastest cached mode for this camera and the current binning.
+  *             Fastest is shortest ReadoutTime, then shortest measured frame period.
+  *
+  * @param[in] *cam   = pointer to camera info structure, serial number known
+  * @param[in]  bits  = minimum bit depth
+  * @param[in]  noise = maximum read noise [e]. 0 = Any
+  *
+  * @return     true | false = Mode applied | No cache or no mode meets requirement
+  */
+bool cal_pick( mop_cam_t *cam, int bits, double noise )
+{
+    char   name[MAX_STR];
+    char   line[MAX_STR];
+    char   ser[MAX_STR];
+    char   serial[MAX_STR];
+    char   mhz[16], rd[16], enc[16], amp[16], bin[16];
+    char   best[5][16];
+    double rdt, per, nse, gain;
+    double best_rdt = 0.0;
+    double best_per = 0.0;
+    long long size;
+    bool   found = false;
+    FILE  *fp;
+
+    snprintf( name, sizeof(name), CAL_FILE, cam_num+1 );
+    if ( !( fp = fopen( name, "r" )))
+        return mop_log( false, LOG_WRN, FAC, "No mode cache %s. Run mopnet -K", name );
+
+    snprintf( serial, sizeof(serial), "%ls", cam->SerialNumber );
+    while ( fgets( line, sizeof(line), fp ))
+    {
+        if ( *line == '#' ||
+             sscanf( line, "%255s %15s %15s %15s %15s %15s %lf %lld %lf %lf %lf",
+                     ser, mhz, rd, enc, amp, bin, &rdt, &size, &per, &nse, &gain ) != 11 )
+            continue;
+
+//      Requirements
+        if ( strcmp( ser, serial ) || atoi( bin ) != img_bin || cal_bits( amp ) < bits ||
+             ( bits > 12 && strcmp( enc, "16" ) ) || ( noise > 0.0 && nse > noise ))
+            continue;
+
+        if ( !found || rdt < best_rdt || ( rdt == best_rdt && per < best_per ))
+        {
+            found    = true;
+            best_rdt = rdt;
+            best_per = per;
+            strcpy( best[0], mhz );
+            strcpy( best[1], rd  );
+            strcpy( best[2], enc );
+            strcpy( best[3], amp );
+        }
+    }
+    fclose( fp );
+
+    if ( !found )
+        return mop_log( false, LOG_WRN, FAC, "No cached %i-bit mode for %s bin %i with noise <= %.2fe. Mode unchanged", bits, serial, img_bin, noise );
+
+    if ( !cal_set( best[0], best[1], best[2], best[3], NULL ))
+        return mop_log( false, LOG_ERR, FAC, "cal_set()" );
+
+    return mop_log( true, LOG_INF, FAC, "Fastest %i-bit mode -f%s -o%s -p%s -m%s ReadoutTime = %.4fs Period = %.4fs",
+                    bits, best[0], best[1], best[2], best[3], best_rdt, best_per );
+}
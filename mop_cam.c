@@ -10,6 +10,14 @@
 #include "mopnet.h"
 #define FAC FAC_CAM
 
+static AT_U8 *cam_arena      = NULL;  // Image arena, Mono16 scratch then buffer ring
+static size_t cam_arena_len  = 0;     // [bytes] mapped
+static size_t cam_arena_mono = 0;     // [bytes] of it for Mono16 scratch
+static bool   cam_arena_huge = false; // Reserved hugepages
+static bool   cam_arena_lock = false; // Locked in memory
+
+static void cam_unmap( mop_cam_t *cam );
+
 /** @brief     Check Andor API AT_*() function return value
   *
   * @param[in]  ret = AT_ function return value to be checked
@@ -67,6 +75,8 @@ bool at_try( mop_cam_t *cam, void *fn, AT_WC *cmd, ...  )
             ok=at_chk( AT_SetEnumString(cam->Handle, cmd, va_arg(val,AT_WC  *)),"SetEnumString",cmd);
         else if (fn == AT_SetFloat     )     
             ok=at_chk( AT_SetFloat     (cam->Handle, cmd, va_arg(val,double  )),"SetFloat"     ,cmd);
+        else if (fn == AT_SetInt       )     
+            ok=at_chk( AT_SetInt       (cam->Handle, cmd, va_arg(val,AT_64   )),"SetInt"       ,cmd);
         else if (fn == AT_GetBool      )     
             ok=at_chk( AT_GetBool      (cam->Handle, cmd, va_arg(val,AT_BOOL*)),"GetBool"      ,cmd);
         else if (fn == AT_GetString    )    
@@ -153,20 +163,8 @@ bool cam_close( mop_cam_t *cam )
         at_try(cam, AT_Close, L"", NULL );
     }
 
-//  Release output buffer memory 
-    if ( img_mono16 )
-    {
-        free( img_mono16 );
-        img_mono16 = NULL;
-    }
-
-//  Release circular buffer memory 
-    for ( int i = 0; i < MAX_CYCLE; i++ )
-        if ( cam->ImageBuffer[i] )
-        { 
-           free( cam->ImageBuffer[i] );
-           cam->ImageBuffer[i] = NULL;
-        }
+//  Release output and circular buffer memory 
+    cam_unmap( cam );
 
 //  Close AT libraries
     return at_chk( AT_FinaliseLibrary()       ,"FinaliseLibrary"       , L"")&&
@@ -258,6 +256,9 @@ bool cam_open( mop_cam_t *cam )
   */
 bool cam_conf( mop_cam_t *cam, double exp )
 {
+//   Frame info lets pixels be unpacked from metadata. Optional, settings are used without it 
+     AT_SetBool( cam->Handle, L"MetadataFrameInfo", AT_TRUE );
+
      if (at_try(cam,(void*)AT_SetBool      ,L"SensorCooling"            ,AT_TRUE                      )&&
          at_try(cam,(void*)AT_SetBool      ,L"MetadataEnable"           ,AT_TRUE                      )&&
          at_try(cam,(void*)AT_SetBool      ,L"MetadataTimestamp"        ,AT_TRUE                      )&&
@@ -271,6 +272,7 @@ bool cam_conf( mop_cam_t *cam, double exp )
          at_try(cam,(void*)AT_SetEnumString,L"PixelReadoutRate"         ,cam_mhz                      )&&
          at_try(cam,(void*)AT_SetEnumString,L"CycleMode"                ,L"Continuous"                )&&
          at_try(cam,(void*)AT_SetEnumString,L"AOIBinning"               ,cam_bin                      )&&
+         cam_aoi( cam )                                                                                &&
          at_try(cam,(void*)AT_SetEnumString,L"TriggerMode"              ,cam_trg                      )&&
          at_try(cam,(void*)AT_SetFloat     ,L"ExposureTime"             ,exp                          )&&
          at_try(cam,(void*)AT_GetBool      ,L"FullAOIControl"           ,&cam->FullAOIControl         )&&
@@ -293,7 +295,7 @@ bool cam_conf( mop_cam_t *cam, double exp )
          if ( cam_auto &&   // Use auto exposure 
               rot_sign    ) // and not static
          {
-             cam_exp = exp = fabs((rot_stp / rot_vel)) - 2.0 * cam->ReadoutTime;
+             cam_exp = exp = fmax( fabs((rot_stp / rot_vel)) - 2.0 * cam->ReadoutTime, cam->ExpMin );
              at_try(cam, AT_SetFloat, L"ExposureTime", exp         );
              at_try(cam, AT_GetFloat, L"ExposureTime", &cam->ExpVal);
              mop_log( true, LOG_INF, FAC, "Automatic exposure = %fs", cam->ExpVal ); 
@@ -304,15 +306,19 @@ bool cam_conf( mop_cam_t *cam, double exp )
      
 //       Get constants for this camera
          cam_param( cam );
-         cam->Dimension[IMG_WIDTH]  = (int)cam->SensorWidth/img_bin;
-         cam->Dimension[IMG_HEIGHT] = (int)cam->SensorHeight/img_bin;
+         cam->Dimension[IMG_WIDTH]  = (int)cam->AOIWidth;
+         cam->Dimension[IMG_HEIGHT] = (int)cam->AOIHeight;
      
 //       Exposure info
          cam->ExpReq = exp;                       // Requested exposure time
          cam->ExpDif = cam->ExpReq - cam->ExpVal; // Difference from actual
 
 //       Set image size 
-         img_mono16size = (cam->SensorWidth/img_bin) * (cam->SensorHeight/img_bin);  
+         img_mono16size = cam->AOIWidth * cam->AOIHeight;  
+     
+//       Refit image arena to this configuration. Nothing is queued after the flush 
+         if ( img_ring && !cam_ring( cam, img_ring ))
+             return mop_log( false, LOG_ERR, FAC, "cam_conf() image arena" );
      
 //       Blank space added to line up camera info output 
          mop_log( true, LOG_INF, FAC, 
@@ -327,10 +333,12 @@ bool cam_conf( mop_cam_t *cam, double exp )
                  LOG_BLANK "Well Depth = %i e"
                  LOG_BLANK "Dark Curr. = %f e/px/s"
                  LOG_BLANK "Binning    = %ls"
-                 LOG_BLANK "FullAOICtl = %s",
+                 LOG_BLANK "FullAOICtl = %s"
+                 LOG_BLANK "AOI        = %lldx%lld+%lld+%lld",
                  cam->SerialNumber, cam->Model, cam->FirmwareVersion, 
                  cam_trg, cam_enc, cam_mhz, cam_amp, 
-                 cam->Gain, cam->WellDepth, cam->DarkCurrent, cam_bin, btoa(cam->FullAOIControl) );
+                 cam->Gain, cam->WellDepth, cam->DarkCurrent, cam_bin, btoa(cam->FullAOIControl),
+                 cam->AOIWidth, cam->AOIHeight, cam->AOILeft-1, cam->AOITop-1 );
 	 return mop_log( true, LOG_INF, FAC, 
                                    "ImageSize  = 0x%X bytes"
                          LOG_BLANK "ReadoutTime= %.4f s" 
@@ -345,6 +353,55 @@ bool cam_conf( mop_cam_t *cam, double exp )
 }
 
 
+/** @brief      Set the area of interest. Full sensor unless a window was requested with -g.
+  *             A window is centred by default so it stays symmetric about the sensor mid-line,
+  *             where simultaneous read orders start, giving the shortest readout for its height.
+  *             Must follow AOIBinning as AOI width and height are in binned pixels.
+  *
+  * @param[in] *cam = pointer to camera info structure
+  *
+  * @return     true | false = Success | Failure
+  */
+bool cam_aoi( mop_cam_t *cam )
+{
+    AT_64 w, h; // [px] Window size, unbinned 
+    AT_64 x, y; // [px] Window offset from sensor origin, unbinned 
+
+    if (!( at_try( cam, AT_GetBool, L"FullAOIControl", &cam->FullAOIControl )&&
+           at_try( cam, AT_GetInt , L"SensorWidth"   , &cam->SensorWidth    )&&
+           at_try( cam, AT_GetInt , L"SensorHeight"  , &cam->SensorHeight   )  ))
+        return mop_log( false, LOG_ERR, FAC, "cam_aoi()" );
+
+    w = img_aoi_w ? img_aoi_w : cam->SensorWidth;
+    h = img_aoi_h ? img_aoi_h : cam->SensorHeight;
+    x = img_aoi_x < 0 ? ( cam->SensorWidth  - w ) / 2 : img_aoi_x;
+    y = img_aoi_y < 0 ? ( cam->SensorHeight - h ) / 2 : img_aoi_y;
+
+    if ( img_aoi_w && !cam->FullAOIControl )
+        return mop_log( false, LOG_ERR, FAC, "Window %lldx%lld needs FullAOIControl", w, h );
+
+    if ( w < img_bin || h < img_bin || x + w > cam->SensorWidth || y + h > cam->SensorHeight )
+        return mop_log( false, LOG_ERR, FAC, "Window %lldx%lld+%lld+%lld outside %lldx%lld sensor",
+                        w, h, x, y, cam->SensorWidth, cam->SensorHeight );
+
+//  Home the corner first so any width and height are in range. AOILeft and AOITop are 1-based 
+    if (!( at_try( cam, AT_SetInt, L"AOILeft"  , (AT_64)1           )&&
+           at_try( cam, AT_SetInt, L"AOITop"   , (AT_64)1           )&&
+           at_try( cam, AT_SetInt, L"AOIWidth" , w / img_bin        )&&
+           at_try( cam, AT_SetInt, L"AOILeft"  , x + 1              )&&
+           at_try( cam, AT_SetInt, L"AOIHeight", h / img_bin        )&&
+           at_try( cam, AT_SetInt, L"AOITop"   , y + 1              )&&
+           at_try( cam, AT_GetInt, L"AOIWidth" , &cam->AOIWidth     )&&
+           at_try( cam, AT_GetInt, L"AOIHeight", &cam->AOIHeight    )&&
+           at_try( cam, AT_GetInt, L"AOILeft"  , &cam->AOILeft      )&&
+           at_try( cam, AT_GetInt, L"AOITop"   , &cam->AOITop       )&&
+           at_try( cam, AT_GetInt, L"AOIStride", &cam->AOIStride    )  ))
+        return mop_log( false, LOG_ERR, FAC, "cam_aoi() Window %lldx%lld+%lld+%lld", w, h, x, y );
+
+    return true;
+}
+
+
 /** @brief     Populate camera data-sheet parameters based on serial number 
   *
   * @param[in] *cam = pointer to camera info structure
@@ -364,6 +421,7 @@ bool cam_param( mop_cam_t *cam )
            cam->WellDepth   = cam_info[c].WellDepth;
            cam->DarkCurrent = cam_info[c].DarkCurrent;
            cam->Filter      = cam_info[c].Filter;
+           cam->PolAngle    = cam_info[c].PolAngle;
            cam->FilterID    = cam_info[c].FilterID;
 
 //         What's the frequency Kenneth? 
@@ -412,18 +470,154 @@ bool cam_queue( mop_cam_t *cam )
 {
     int b = 0; // Buffer number
 
+//  Grow ring if this run has more positions per revolution
+    if ( !cam_ring( cam, img_cycle ) )
+        return mop_log( false, LOG_ERR, FAC, "cam_queue()" );
+
     for ( int i = 0; i < img_total; i++ )
     { 
         if ( !at_chk( AT_QueueBuffer( cam->Handle, cam->ImageBuffer[b], cam->ImageSizeBytes), "QueueBuffer", L""))
             return mop_log( false, LOG_ERR, FAC, "cam_queue()" );
 
-        if ( ++b >= IMG_CYCLE )
+        if ( ++b >= img_ring )
              b = 0;       
     }
     return true;
 }
 
 
+/** @brief      Release the image arena
+  *
+  * @param[in] *cam = pointer to camera info structure
+  */
+static void cam_unmap( mop_cam_t *cam )
+{
+    if ( cam_arena )
+    {
+        munmap( cam_arena, cam_arena_len );
+        cam_arena      = NULL;
+        cam_arena_len  = 0;
+        cam_arena_mono = 0;
+    }
+
+    for ( int i = 0; i < img_ring; i++ )
+        cam->ImageBuffer[i] = NULL;
+    img_mono16 = NULL;
+    img_ring   = 0;
+    cam->BufferBytes = 0;
+}
+
+
+/** @brief      Map the image arena. Reserved 2MB hugepages if any, else normal pages advised to be transparent
+  *             hugepages. Locked and prefaulted so the acquisition loop takes no page faults
+  *
+  * @param[in]  len = [bytes] size, a multiple of CAM_HUGE_PAGE
+  *
+  * @return     true | false = Success | Failure
+  */
+static bool cam_map( size_t len )
+{
+    cam_arena_huge = true;
+    cam_arena = mmap( NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+    if ( cam_arena == MAP_FAILED )
+    {
+        cam_arena_huge = false;
+        cam_arena = mmap( NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( cam_arena == MAP_FAILED )
+        {
+            cam_arena = NULL;
+            return mop_log( false, LOG_SYS, FAC, "mmap(%zu) %s", len, strerror(errno) );
+        }
+        madvise( cam_arena, len, MADV_HUGEPAGE );
+    }
+    cam_arena_len = len;
+
+//  Lock needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK. Without it pages are still prefaulted
+    if ( !( cam_arena_lock = !mlock( cam_arena, len )))
+        mop_log( false, LOG_WRN, FAC, "mlock(%zu) %s. Image arena not locked", len, strerror(errno) );
+    memset( cam_arena, 0, len );
+
+    return true;
+}
+
+
+/** @brief      Lay out the image arena for the current configuration: Mono16 scratch then a ring of camera buffers
+  *             of at least one revolution. The ring only grows. Buffers are ImageSizeBytes, which includes any row
+  *             padding and metadata. The arena is remapped when the layout does not fit or would use under half of it.
+  *             Call only with no buffers queued.
+  *
+  * @param[in] *cam   = pointer to camera info structure, configured
+  * @param[in]  cycle = images per revolution
+  *
+  * @return     true | false = Success | Failure
+  */
+bool cam_ring( mop_cam_t *cam, int cycle )
+{
+    int    num  = cycle > IMG_CYCLE ? cycle : IMG_CYCLE;
+    size_t mono = ( 2 * img_mono16size + CAM_BUF_ALIGN - 1 ) / CAM_BUF_ALIGN * CAM_BUF_ALIGN;
+    size_t slot = ( cam->ImageSizeBytes + CAM_BUF_ALIGN - 1 ) / CAM_BUF_ALIGN * CAM_BUF_ALIGN;
+    size_t need;
+    size_t len;
+
+    if ( num < img_ring )
+        num = img_ring;
+    if ( num > MAX_CYCLE )
+        return mop_log( false, LOG_ERR, FAC, "Ring of %i buffers > %i", num, MAX_CYCLE );
+
+    need = mono + num * slot;
+    len  = ( need + CAM_HUGE_PAGE - 1 ) / CAM_HUGE_PAGE * CAM_HUGE_PAGE;
+
+//  Same layout needs nothing
+    if ( cam_arena && num == img_ring && slot == (size_t)cam->BufferBytes && mono == cam_arena_mono )
+        return true;
+
+    if ( len > cam_arena_len || len <= cam_arena_len / 2 )
+    {
+        cam_unmap( cam );
+        if ( !cam_map( len ))
+            return mop_log( false, LOG_ERR, FAC, "Image arena %.1f MB", len / MEM_MB );
+    }
+
+    img_mono16     = cam_arena;
+    cam_arena_mono = mono;
+    for ( img_ring = 0; img_ring < num; img_ring++ )
+        cam->ImageBuffer[img_ring] = cam_arena + mono + img_ring * slot;
+    cam->BufferBytes = slot;
+
+    return mop_log( true, LOG_INF, FAC, "Image arena %.1f MB %s pages%s. Mono16 %.1f MB + %i x %.1f MB buffers",
+                    cam_arena_len / MEM_MB, cam_arena_huge ? "2MB huge" : "normal", cam_arena_lock ? " locked" : "",
+                    mono / MEM_MB, num, slot / MEM_MB );
+}
+
+
+/** @brief      Check the run plan fits the camera timing for the current configuration.
+  *             Rotating: exposure plus readout must fit the trigger interval between positions.
+  *             Stepped with a fixed period: exposure plus readout must fit the period.
+  *
+  * @param[in] *cam = pointer to camera info structure, configured
+  *
+  * @return     true | false = Plan OK | Rejected
+  */
+bool cam_plan( mop_cam_t *cam )
+{
+    double interval; // [s] Time between triggers 
+
+    if ( rot_sign ) 
+        interval = fabs( rot_stp / rot_vel );
+    else if ( rot_stp && cam_stp > 0.0 )
+        interval = cam_stp;
+    else 
+        return true; // Software triggered, paced by camera 
+
+    if ( cam->ExpVal + cam->ReadoutTime > interval )
+        return mop_log( false, LOG_ERR, FAC, "Plan rejected. %i positions. Exposure %.4fs + readout %.4fs > trigger interval %.4fs. Max. exposure %.4fs", 
+                        img_cycle, cam->ExpVal, cam->ReadoutTime, interval, interval - cam->ReadoutTime );
+
+    return mop_log( true, LOG_INF, FAC, "Plan OK. %i positions. Exposure %.4fs + readout %.4fs <= trigger interval %.4fs", 
+                    img_cycle, cam->ExpVal, cam->ReadoutTime, interval );
+}
+
+
 /** @brief      Allocate memory blocks for image storage
   *
   * @param[in] *cam = pointer to camera info structure
@@ -432,34 +626,79 @@ bool cam_queue( mop_cam_t *cam )
   */
 bool cam_alloc( mop_cam_t *cam )
 {
-//  Set maximum size in words for 1x1 binning. Actual image size handled elsewhere 
-    img_mono16size =  cam->SensorWidth * cam->SensorHeight;
-
-//  Output will be 16-bit mono so double mono buffer size   
-    if ( !( img_mono16 = aligned_alloc( 16,  2 * img_mono16size )))
-        return mop_log( false, LOG_SYS, FAC, "Mono16 image aligned_alloc()" );
+//  Sized for the configuration. cam_conf() refits it whenever that changes 
+    return cam_ring( cam, img_cycle );
+}
 
-    for ( int i = 0; i < IMG_CYCLE; i++ )
-        if ( !(cam->ImageBuffer[i] = aligned_alloc( 16, 2 * img_mono16size )))
-           return mop_log( false, LOG_SYS, FAC, "aligned_alloc(CIRC)" );
 
-    return true;
+/** @brief      Record a frame missed by a rotating run. Its rotator position is logged and, unless
+  *             stacking, a MSG_GAP notification takes the place of the frame's so mopcmd's count still holds
+  *
+  * @param[in]     *cam  = pointer to camera info structure
+  * @param[in]      i    = image sequence number within run
+  * @param[in,out] *next = file name generator state, the missed frame's name is used up
+  */
+static void cam_gap( mop_cam_t *cam, int i, int *next )
+{
+    char   msg_buf[1024];
+    double rot_req = rot_zero + i * rot_stp;
+
+//  Nominal angles as no frame was exposed
+    cam->RotReq[i] = rot_req;
+    cam->RotAng[i] = fmod( rot_req, 360.0 );
+    cam->RotEnd[i] = fmod( rot_req + rot_stp, 360.0 );
+    cam->RotDif[i] = rot_stp;
+    cam->RotN[i]   = 1 + (i / img_cycle);
+    cam->SeqN[i]   = 1 + (i % img_cycle);
+    cam->TimestampClock[i] = 0;
+    cam->GapN++;
+
+    mop_log( false, LOG_WRN, FAC, "Gap. Frame %i missed. Rot %i pos %i at %.2f deg",
+             i+1, cam->RotN[i], cam->SeqN[i], cam->RotAng[i] );
+
+    if ( !stk_gap() )
+    {
+        snprintf( msg_buf, sizeof(msg_buf), MSG_GAP" %s ROT=%.2f GAPS=%i",
+                  fts_mkname( cam, fts_pfx, next ), cam->RotAng[i], cam->GapN );
+        msg_send( 0, msg_buf, ipcommand, NULL, 0 );
+    }
 }
 
 
-/** @brief     Image acquisition using circular frame buffer
+/** @brief      Image acquisition using circular frame buffer.
+  *             A missed or late frame is a gap and the run carries on. Each frame's sequence number comes from
+  *             its timestamp, the nearest trigger after the last frame, so later frames keep their positions.
+  *             The first frame is placed by its timestamp against the expected first trigger, the camera clock
+  *             at rotation start plus the lead-in from the initial angle. If that is more than CAM_ANCHOR_TOL of
+  *             a trigger period out, or cannot be worked out, the run is flagged as not anchored.
+  *             Frames not acquired after CAM_GAP_TRY failed waits, a few trigger periods, are gaps too.
   *
   * @param[in] *cam = pointer to camera info structure
   *
-  * @return    true | false = Success | Failure
+  * @return     true | false = All frames | Gaps recorded
   */
 bool cam_acq_circ( mop_cam_t *cam )
 {
     int    b = 0;              // Image buffer
-    double rot_req = rot_zero; // Requested rotator angle
+    int    i = -1;             // Image sequence number of last frame
+    int    k;                  // Image sequence number of this frame
+    int    len;                // Returned buffer size
+    int    got  = 0;           // Frames acquired
+    int    fail = 0;           // Consecutive failed waits
+    int    gap_max = 0;        // Longest gap
+    AT_64  ticks;              // Camera timestamp of this frame
+    AT_64  last = 0;           // of last frame
+    AT_64  now  = 0;           // at rotation start
+    double per;                // [ticks] Trigger period
+    double first = 0.0;        // [ticks] Expected first trigger. 0 = Unknown
+    double lead;               // [s] Rotation start to first trigger
+    double x = 0.0;            // First frame trigger periods after expected first trigger
+    double rot_req;            // Requested rotator angle
     double clk_dif;            // Camera timestamp clock difference
     double rot_now;
     double timeout = TIM_MILLISECOND * cam->ExpVal + TMO_XFR;
+    double wait    = timeout;  // [ms] Buffer wait once triggers are running
+    bool   ok;
 
     char  msg_buf[1024];
     int   msg_len;
@@ -478,19 +717,77 @@ bool cam_acq_circ( mop_cam_t *cam )
         at_try(cam, AT_SetFloat, L"ExposureTime", cam_exp );
     }
 
+    cam->GapN     = 0;
+    cam->Anchored = false;
+    per = rot_vel ? fabs( rot_stp / rot_vel ) * cam->TimestampClockFrequency : 0.0;
+
+//  Rotation is starting from the initial angle. First trigger follows after the lead-in.
+//  Once it should have fired a wait longer than a few trigger periods means the triggers have stopped
+    if ( per > 0.0 )
+    {
+        lead = fabs( rot_zero + ROT_TRG_OFF + rot_sign * ROT_INI_ANGLE ) / fabs( rot_vel );
+        if ( at_try( cam, (void*)AT_GetInt, L"TimestampClock", &now ) && now > 0 )
+            first = now + lead * cam->TimestampClockFrequency;
+        wait    = TIM_MILLISECOND * ( CAM_GAP_WAIT * per / cam->TimestampClockFrequency + cam->ExpVal );
+        timeout = TIM_MILLISECOND * ( lead + CAM_GAP_LEAD ) + wait;
+    }
+
 //  Loop to acquire all images
-    for ( int i = 0; i < img_total; i++ )
+    while ( i + 1 < img_total )
     {
         gettimeofday(&cam->ObsStart, NULL);
 
+//      Wait for image buffer to be filled. Repeated failures mean the trigger stream has stopped
+        if ( !at_chk( AT_WaitBuffer( cam->Handle, &cam->ReturnBuffer[b], &len, timeout ),"WaitBuffer",L""))
+        {
+            mop_log( false, LOG_ERR, FAC, "No image after frame %i. Wait %i of %i, %.3fs", i+1, fail+1, CAM_GAP_TRY, timeout / TIM_MILLISECOND );
+            if ( ++fail >= CAM_GAP_TRY )
+                break;
+            timeout = wait;
+            continue;
+        }
+        fail = 0;
+
+//      Resynchronise to the trigger stream. Triggers between this frame and the last were missed
+        ticks = cam_ticks( cam, b );
+        k     = i + 1;
+        if ( got && per > 0.0 )
+        {
+            k = i + (int)fmax( 1.0, lround( (double)( ticks - last ) / per ));
+        }
+        else if ( first > 0.0 && ticks )
+        {
+            x = ( ticks - first ) / per;
+            k = MAX( 0, lround( x ));
+            cam->Anchored = fabs( x - k ) <= CAM_ANCHOR_TOL;
+        }
+
+//      First frame placed, or assumed to be at first trigger. Later frames need not wait for the lead-in
+        if ( !got )
+        {
+            if ( cam->Anchored )
+                mop_log( true, LOG_DBG, FAC, "First frame at trigger %i. %+.3f periods", k+1, x - k );
+            else
+                mop_log( false, LOG_WRN, FAC, "First frame position not confirmed. %s. Run not anchored",
+                         first > 0.0 && ticks ? "Not on a trigger" : "No timestamp" );
+            timeout = wait;
+        }
+        if ( k >= img_total )
+        {
+            mop_log( false, LOG_WRN, FAC, "Frame %i after end of run. Discarded", k+1 );
+            break;
+        }
+        if ( k - i - 1 > gap_max )
+            gap_max = k - i - 1;
+        while ( ++i < k )
+            cam_gap( cam, i, &next );
+
+        rot_req = rot_zero + i * rot_stp;
         cam->RotReq[i] = rot_req;
         cam->RotAng[i] = fmod( rot_req, 360.0 );
         cam->RotN[i]   = 1 + (i / img_cycle);
         cam->SeqN[i]   = 1 + (i % img_cycle);
-
-//      Wait for image buffer to be filled.
-        if ( !at_chk( AT_WaitBuffer( cam->Handle, &cam->ReturnBuffer[b], &cam->ReturnSize[i], timeout ),"WaitBuffer",L""))
-            mop_exit( mop_log( false, LOG_ERR, FAC, "Missed image %i. Exiting", i+1 ));
+        cam->ReturnSize[i] = len;
 
         if ( mop_master )
         {
@@ -506,17 +803,28 @@ bool cam_acq_circ( mop_cam_t *cam )
             cam->RotEnd[i] = fmod(rot_req + rot_stp, 360.0 );
         }
 
-        cam->TimestampClock[i] = cam_ticks( cam, b );
-        if (i)
-            clk_dif = (double)(cam->TimestampClock[i] - cam->TimestampClock[i-1]) / cam->TimestampClockFrequency;
+        cam->TimestampClock[i] = ticks;
+        trg_add( cam, i );
+        sch_mark( SCH_ACQ );
+        if ( got )
+            clk_dif = (double)(ticks - last) / cam->TimestampClockFrequency;
         else
-            clk_dif = (double)cam->TimestampClock[i] / cam->TimestampClockFrequency;
+            clk_dif = (double)ticks / cam->TimestampClockFrequency;
+        last = ticks;
+        got++;
 
-//      Write to file 
+//      Add to stack or write to file 
         gettimeofday(&cam->ObsEnd, NULL);
-        fts_write( name = fts_mkname( cam, fts_pfx, &next ), cam, i, b );
-        msg_len = sprintf( msg_buf, "%s", name );
-        msg_send( 0, msg_buf, ipcommand, NULL, 0 ); 
+        if ( !stk_add( cam, i, b ) )
+        {
+            fts_write( name = fts_mkname( cam, fts_pfx, &next ), cam, i, b );
+            msg_len = img_note( msg_buf, sizeof(msg_buf), name, cam );
+            msg_send( 0, msg_buf, ipcommand, NULL, 0 ); 
+        }
+
+//      Pick up any RUN requests sent while busy
+        if ( mop_master )
+            msg_poll( NULL, 0 );
 
 //      Logging
         mop_log( true, LOG_IMG, FAC,
@@ -525,18 +833,25 @@ bool cam_acq_circ( mop_cam_t *cam )
                  cam->RotEnd[i], cam->RotDif[i], fabs(cam->RotDif[i]/rot_vel - rot_sign*cam->ExpVal), clk_dif,
                  i+1 == img_total ? '#':' ' ); // Mark last image 
 
-        rot_req += rot_stp;
-        if ( ++b >= MAX_CYCLE )
+        if ( ++b >= img_ring )
             b = 0; // Loop circular buffer back to start 
     }
 
+//  Frames not acquired by the end of the run
+    if ( img_total - i - 1 > gap_max )
+        gap_max = img_total - i - 1;
+    while ( ++i < img_total )
+        cam_gap( cam, i, &next );
+
 //  Stop acquisition, get temperature and don't forget to flush
     cam_acq_ena( cam, AT_FALSE   );
     cam_trg_set( cam, CAM_TRG_SW );
     at_try( cam, AT_GetFloat,  L"SensorTemperature", &cam->SensorTemperature );
     at_try( cam, AT_Flush   ,  L"", NULL );
 
-    return true;
+    ok = !cam->GapN && cam->Anchored;
+    return mop_log( ok, ok ? LOG_INF : LOG_WRN, FAC, "Run %i. %i/%i frames. %i gaps, longest %i%s",
+                    fts_run, got, img_total, cam->GapN, gap_max, cam->Anchored ? "" : ". NOT ANCHORED" );
 }
 
 /** @brief      Image acquisition loop (static)  
@@ -558,6 +873,9 @@ bool cam_acq_stat( mop_cam_t *cam )
     char *name;
     int   next = FTS_NEXT;
 
+    cam->GapN     = 0;    // Only rotating runs record gaps
+    cam->Anchored = true; // or place frames by timestamp
+
 //  If bias frame then use minimum exposure else restore global value
     if ( fts_pfx == FTS_PFX_BIAS )
     {
@@ -585,13 +903,13 @@ bool cam_acq_stat( mop_cam_t *cam )
             if ( !rot_goto( rot_req, TMO_ROTATOR, &cam->RotEnd[i] ) )
                 return mop_log( false, LOG_ERR, FAC, "rot_goto(Static)");
            
-//          If not single camera mode send signal to slave 
+//          If not single camera mode send signal to all slaves together 
             if ( !one_cam )
             {
-                if ( msg_send( TMO_MSG, MSG_TRG, ipslave, MSG_ACK, strlen(MSG_ACK) ) )
+                if ( msg_fan( TMO_MSG, MSG_TRG, ipslaves, mop_slaves, MSG_ACK, strlen(MSG_ACK), NULL, NULL ) )
                     mop_log( true, LOG_DBG, FAC, "Master sent SW trigger" );
                 else
-                    return mop_log( false, LOG_ERR, FAC, "msg_send()");
+                    return mop_log( false, LOG_ERR, FAC, "msg_fan(%s)", MSG_TRG );
             }
         }
         else // Slave process 
@@ -609,16 +927,25 @@ bool cam_acq_stat( mop_cam_t *cam )
         cam->RotEnd[i] = fmod( cam->RotEnd[i], 360.0 );
         cam->RotDif[i] = cam->RotEnd[i] - cam->RotAng[i];
         cam->TimestampClock[i] = cam_ticks( cam, b );
+        trg_add( cam, i );
+        sch_mark( SCH_ACQ );
         if (i)
             clk_dif = (double)(cam->TimestampClock[i] - cam->TimestampClock[i-1]) / cam->TimestampClockFrequency;
         else
             clk_dif = (double)cam->TimestampClock[i] / cam->TimestampClockFrequency;
 
-//      Write to file 
+//      Add to stack or write to file 
         gettimeofday(&cam->ObsEnd, NULL);
-        fts_write( fts_mkname( cam, fts_pfx, &next ), cam, i, b );
-        msg_len = sprintf( msg_buf, "%s", name );
-        msg_send( 0, msg_buf, ipcommand, NULL, 0 ); 
+        if ( !stk_add( cam, i, b ) )
+        {
+            fts_write( name = fts_mkname( cam, fts_pfx, &next ), cam, i, b );
+            msg_len = img_note( msg_buf, sizeof(msg_buf), name, cam );
+            msg_send( 0, msg_buf, ipcommand, NULL, 0 ); 
+        }
+
+//      Pick up any RUN requests sent while busy
+        if ( mop_master )
+            msg_poll( NULL, 0 );
 
 //      Logging
         mop_log( true, LOG_IMG, FAC,
@@ -628,7 +955,7 @@ bool cam_acq_stat( mop_cam_t *cam )
                  i+1 == img_total ? '#':' ' ); // Mark final image 
 
         rot_req += rot_stp;
-        if ( ++b >= MAX_CYCLE )
+        if ( ++b >= img_ring )
             b = 0; // Loop circular buffer back to start 
     }
 
@@ -641,61 +968,248 @@ bool cam_acq_stat( mop_cam_t *cam )
 }
 
 
-/** @brief      Read camera ticks from image meta-data.
-  *             Meta-data reporting must be enabled.  
+/** @brief      Pipelined image acquisition (static or stepped rotator, software trigger)  
+  *
+  *             All cameras trigger on a schedule agreed once at the start, t0 + i * period, so there is
+  *             no per-frame master-slave round trip. The master starts moving to the next position as soon
+  *             as the frame is read out, as rolling shutter rows integrate until read, so the rotator moves
+  *             during file writing. Opt-in with -y, lock-step cam_acq_stat() is the default.
+  *             The schedule uses CLOCK_REALTIME so cameras on different hosts need NTP synchronised clocks.
   *
   * @param[in] *cam = pointer to camera info structure
-  * @param[in]  buf = Index into image buffer array 
   *
-  * @return     Image size or 0 = Failure  
+  * @return     true | false = Success | Failure
   */
-unsigned long cam_ticks( mop_cam_t *cam, int buf )
+bool cam_acq_step( mop_cam_t *cam )
 {
-    int i;
+    int    b = 0;              // Image buffer
+    int    late = 0;           // Number of late triggers
+    double rot_req = rot_zero; // Requested rotator angle. Default zero position
+    double clk_dif;            // Camera timestamp clock difference
+    double period;             // [s] Time between triggers
+    double move;               // [s] Step move and settle 
+    double dly;                // [s] Trigger lateness
+    double timeout = TIM_MILLISECOND * cam->ExpVal + TMO_XFR;
+    struct timespec t0;        // Schedule start
+    struct timespec trg;       // Trigger time
+    struct timespec dur;
+
+    char msg_buf[1024];
+    int  msg_len;
+
+    char *name;
+    int   next = FTS_NEXT;
 
-    unsigned char *ptr1;
-    unsigned int len;
-    unsigned int cid;
+    cam->GapN     = 0;    // Only rotating runs record gaps
+    cam->Anchored = true; // or place frames by timestamp
 
-    ptr1 = cam->ImageBuffer[buf] + cam->ImageSizeBytes;
+//  If bias frame then use minimum exposure else restore global value
+    if ( fts_pfx == FTS_PFX_BIAS )
+    {
+        cam->ExpVal = cam->ExpMin;
+        at_try(cam, AT_SetFloat, L"ExposureTime", cam->ExpMin );
+    }
+    else
+    {
+        cam->ExpVal = cam_exp; 
+        at_try(cam, AT_SetFloat, L"ExposureTime", cam_exp );
+    }
 
-// DEBUG:  Used for per-byte verify of meta-data structure    
-//    for( i = 0; i < 40; i++ )
-//      printf( "%i=%i\n", i, *--ptr0 );
+    if ( mop_master ) 
+    {
+//      Auto period allows for readout then a step move 
+        move   = rot_stp ? fabs(rot_stp) / ROT_VEL_MAX + ROT_SETTLE : 0.0;
+        period = cam_stp > 0.0 ? cam_stp : cam->ExpVal + cam->ReadoutTime + move + CAM_STP_MARGIN;
+        if ( period < cam->ExpVal + cam->ReadoutTime + move )
+            mop_log( false, LOG_WRN, FAC, "Step period %.3fs < exposure + readout + move %.3fs", period, cam->ExpVal + cam->ReadoutTime + move ); 
+
+        if ( !rot_goto( rot_req, TMO_ROTATOR, NULL ) )
+            return mop_log( false, LOG_ERR, FAC, "rot_goto(Step)");
+
+//      Start far enough ahead for the slaves to get the schedule 
+        clock_gettime( CLOCK_REALTIME, &t0 );
+        dur = utl_dbl2ts( CAM_STP_LEAD );
+        t0  = utl_ts_add( &t0, &dur );
+        snprintf( msg_buf, sizeof(msg_buf), MSG_TRG" %ld %ld %f", t0.tv_sec, t0.tv_nsec, period );
+        if ( !one_cam && !msg_fan( TMO_ACK, msg_buf, ipslaves, mop_slaves, MSG_ACK, strlen(MSG_ACK), NULL, NULL ) )
+            return mop_log( false, LOG_ERR, FAC, "msg_fan(%s)", msg_buf );
+    }
+    else // Slave process 
+    {
+        if ( !msg_recv( TMO_MSG, msg_buf, sizeof(msg_buf)-1, &msg_len, MSG_TRG, strlen(MSG_TRG)) ||
+             sscanf( msg_buf, MSG_TRG" %ld %ld %lf", &t0.tv_sec, &t0.tv_nsec, &period ) != 3 )
+            return mop_log( false, LOG_ERR, FAC, "cam_acq_step() no schedule" );
+    }
+    mop_log( true, LOG_INF, FAC, "Step schedule %i positions every %.3fs", img_total, period ); 
 
-//  Handles Andor's tacked-on meta-data, see Sec 4.5 METADATA in SDK 3.11 for gruesome details
-//  Parse backwards from the end of image 
-    for( i = 0; i < 3; i++ )
+//  Loop to acquire images
+    for ( int i = 0; i < img_total; i++ )
     {
-//      Move back and read int length field
-        ptr1 -= 4;
-        len = *(unsigned int *)ptr1;
+        gettimeofday(&cam->ObsStart, NULL);
+
+        cam->RotReq[i] = rot_req;                 // Absolute rotation
+        cam->RotAng[i] = fmod( rot_req, 360.0 );  // 0-360 rotation
+        cam->RotN[i]   = 1 + (i / img_cycle);     // Rotation number
+        cam->SeqN[i]   = 1 + (i % img_cycle);     // Position within rotation
+        cam->RotEnd[i] = rot_req;
+
+//      Master must be in position before triggering. Normally it already is 
+        if ( mop_master && !rot_ont( TMO_ROTATOR ) )
+            return mop_log( false, LOG_ERR, FAC, "rot_ont(Step)");
+
+        dur = utl_dbl2ts( i * period );
+        trg = utl_ts_add( &t0, &dur );
+        if ( ( dly = utl_ts_sleep( &trg ) ) > CAM_STP_MARGIN )
+        {
+            late++;
+            mop_log( false, LOG_WRN, FAC, "Trigger %i late by %.3fs", i+1, dly );
+        }
+        at_try( cam, AT_Command, L"SoftwareTrigger", NULL );
+        clock_gettime( CLOCK_REALTIME, &trg ); // Exposure started by now 
 
-//      Move back and read int CID field        
-        ptr1 -= 4;
-        cid = *(unsigned int *)ptr1;
+//      Static during exposure so read position now, then move on once the last row is read out.
+//      Rolling shutter with global clear, so later rows are still integrating after ExpVal
+        if ( mop_master )
+        {
+            rot_get( &cam->RotEnd[i] );
+            if ( rot_stp && i+1 < img_total )
+            {
+                dur = utl_dbl2ts( cam->ExpVal + cam->ReadoutTime );
+                trg = utl_ts_add( &trg, &dur );
+                utl_ts_sleep( &trg );
+                rot_move( rot_req + rot_stp );
+            }
+        }
+
+        if (!at_chk( AT_WaitBuffer(cam->Handle, &cam->ReturnBuffer[b], &cam->ReturnSize[i], timeout),"WaitBuffer",L""))
+            return mop_log( false, LOG_ERR, FAC, "Missed image %i", i+1 );
+
+        cam->RotEnd[i] = fmod( cam->RotEnd[i], 360.0 );
+        cam->RotDif[i] = cam->RotEnd[i] - cam->RotAng[i];
+        cam->TimestampClock[i] = cam_ticks( cam, b );
+        trg_add( cam, i );
+        sch_mark( SCH_ACQ );
+        if (i)
+            clk_dif = (double)(cam->TimestampClock[i] - cam->TimestampClock[i-1]) / cam->TimestampClockFrequency;
+        else
+            clk_dif = (double)cam->TimestampClock[i] / cam->TimestampClockFrequency;
+
+//      Add to stack or write to file while rotator moves
+        gettimeofday(&cam->ObsEnd, NULL);
+        if ( !stk_add( cam, i, b ) )
+        {
+            fts_write( name = fts_mkname( cam, fts_pfx, &next ), cam, i, b );
+            msg_len = img_note( msg_buf, sizeof(msg_buf), name, cam );
+            msg_send( 0, msg_buf, ipcommand, NULL, 0 ); 
+        }
+
+//      Pick up any RUN requests sent while busy
+        if ( mop_master )
+            msg_poll( NULL, 0 );
+
+//      Logging
+        mop_log( true, LOG_IMG, FAC,
+                "Exp %2.2i %-2.2i %f Rot %9.2f %7.2f %7.2f Dif %6.2f %5.4f %c",
+                 cam->RotN[i],   cam->SeqN[i],   cam->ExpVal, cam->RotReq[i], cam->RotAng[i],
+                 cam->RotEnd[i], cam->RotDif[i], clk_dif,
+                 i+1 == img_total ? '#':' ' ); // Mark final image 
+
+        rot_req += rot_stp;
+        if ( ++b >= img_ring )
+            b = 0; // Loop circular buffer back to start 
+    }
+
+//  Throughput from first trigger to last image written
+    clock_gettime( CLOCK_REALTIME, &trg );
+    dly = utl_ts_dif( &trg, &t0 );
+    mop_log( true, LOG_INF, FAC, "Stepped %i positions in %.3fs = %.1f positions/min. Period %.3fs. Late %i",
+             img_total, dly, dly > 0.0 ? 60.0 * img_total / dly : 0.0, period, late );
+
+//  Stop acquisition, get temperature and don't forget to flush   
+    at_try( cam, AT_Command,  L"AcquisitionStop", NULL);
+    at_try( cam, AT_GetFloat, L"SensorTemperature", &cam->SensorTemperature);
+    at_try( cam, AT_Flush,    L"", NULL);
+
+    return true;
+}
+
+
+/** @brief      Decode frame metadata in place, see Sec 4.5 METADATA in SDK 3.11.
+  *             Blocks are walked backwards from the end of the buffer, each one checked to lie inside it.
+  *             Walk ends at the frame data block, which must start the buffer.
+  *
+  * @param[in]  *buf  = image buffer
+  * @param[in]   size = buffer size, ImageSizeBytes
+  * @param[out] *md   = metadata
+  *
+  * @return      true | false = Frame data block starts buffer | Metadata absent or corrupt
+  */
+bool cam_meta( AT_U8 *buf, size_t size, cam_md_t *md )
+{
+    AT_U8   *end = buf + size;
+    uint32_t len;
+    uint32_t cid;
+    size_t   n;
+
+    memset( md, 0, sizeof(cam_md_t) );
+    while ( md->blocks < CAM_MD_BLOCKS && (size_t)( end - buf ) >= 2 * CAM_MD_FIELD )
+    {
+//      Length, then CID, before the end. Length counts CID and data 
+        memcpy( &len, end - CAM_MD_FIELD, CAM_MD_FIELD );
+        memcpy( &cid, end - 2 * CAM_MD_FIELD, CAM_MD_FIELD );
+        if ( len < CAM_MD_FIELD || len - CAM_MD_FIELD > (size_t)( end - buf ) - 2 * CAM_MD_FIELD )
+            return false;
+        n    = len - CAM_MD_FIELD;
+        end -= 2 * CAM_MD_FIELD + n;
+        md->blocks++;
 
-//      Move back and point to data by subtracting CID field length     
-        ptr1 -= (len - 4);
         switch ( cid )
         {
-            case 0:
-// DEBUG         printf( "cid=%i len=%i\n", cid, len-4 );
-                 break;
-            case 1:
-// DEBUG         printf( "cid=%i ticks=%lu\n", cid, *(unsigned long*)ptr1 );
-                 return *(unsigned long*)ptr1;
-                 break;
-            case 7:
-// DEBUG         printf( "cid=%i\n", cid );
-                 break;
-
-            default:
-                 break;
+            case CAM_MD_FRAME:
+                if ( end != buf )
+                    return false;
+                md->pix   = end;
+                md->bytes = n;
+                return true;
+            case CAM_MD_TICKS:
+                if ( n < sizeof(md->ticks) )
+                    return false;
+                memcpy( &md->ticks, end, sizeof(md->ticks) );
+                md->has_ticks = true;
+                break;
+            case CAM_MD_INFO:
+                if ( n < CAM_MD_INFO_N )
+                    return false;
+                memcpy( &md->stride, end    , sizeof(uint16_t) );
+                md->enc = end[2];
+                memcpy( &md->width , end + 4, sizeof(uint16_t) );
+                memcpy( &md->height, end + 6, sizeof(uint16_t) );
+                md->has_info = true;
+                break;
+            default: // Skip blocks not used
+                break;
         }
     }
 
-    return 0;
+    return false;
+}
+
+
+/** @brief      Read camera ticks from image meta-data.
+  *             Meta-data reporting must be enabled.  
+  *
+  * @param[in] *cam = pointer to camera info structure
+  * @param[in]  buf = Index into image buffer array 
+  *
+  * @return     Ticks or 0 = Failure  
+  */
+unsigned long cam_ticks( mop_cam_t *cam, int buf )
+{
+    cam_md_t md;
+
+    cam_meta( cam->ImageBuffer[buf], cam->ImageSizeBytes, &md );
+
+    return md.has_ticks ? md.ticks : 0;
 }
 
 
@@ -144,7 +144,7 @@ const cam_info_t cam_info[CAM_COUNT] =
 };
 
 // Facility names, NUL is unused. Must match FAC order in mopnet.h
-const char *fac_levels[] = {"NUL","MOP","LOG","UTL","OPT","CAM","ROT","FTS","MSG","WHL","CMD"}; 
+const char *fac_levels[] = {"NUL","MOP","LOG","UTL","OPT","CAM","ROT","FTS","MSG","WHL","CMD","SHM","XFR","CAL","STK","POL","LIB","IMG","AEX","FOC","BPM","TRG","SCH","TST"}; 
 
 // In decreasing order of severity as used for debug level, Must match LOG order in mopnet.h
 const char *log_levels[] = {"NONE","CRIT","SYS","ERR","WRN","IMG","INF","MSG","DBG","CMD"}; 
@@ -162,6 +162,9 @@ FILE     *mop_log_fp;                // Log file pointer
 mop_cam_t mop_cam;         
 char     *mop_proc    = "";          // Process name
 bool      mop_kill    = false;       // Kill flag (used by command process 
+char     *mop_seq     = NULL;        // Sequence file  (used by command process)
+bool      mop_qry     = false;       // Query flag     (used by command process)
+bool      mop_abt     = false;       // Abort flag     (used by command process)
                                      
 int       rot_id      =  1;          // Rotator device ID (fixed)
 char     *rot_axis    = "1";         // Rotator axis ID   (fixed)
@@ -170,6 +173,7 @@ double    rot_vel     = ROT_VEL;     // Rotator velocity [degree/sec]
 double    rot_stp     = ROT_STP16;   // Rotator increment [degrees]
 int       rot_revs    = ROT_REVS;    // Rotator revolutions
 double    rot_final;                 // Rotator final position
+double    rot_last;                  // Rotator position of last trigger
 char     *rot_usb     = ROT_USB;     // Rotator USB device
 int       rot_sign    = ROT_CW;      // Rotator direction 1=CW, 0=static, -1=CCW
                                      
@@ -185,10 +189,19 @@ wchar_t  *cam_enc     = CAM_ENC_16;  // Pixel encoding, bits/packed
 wchar_t  *cam_trg     = CAM_TRG_EDGE;// Camera trigger mode
 wchar_t  *cam_rd      = CAM_RD_OISIM;// Camera read direction
 wchar_t  *cam_bin     = CAM_BIN_2;   // Camera binning 
+double    cam_stp     = 0.0;         // [s] Stepped mode trigger schedule period. 0 = Lock-step, -ve = Auto
+int       cam_bits    = 0;           // Pick fastest cached mode with at least these bits. 0 = Off
+double    cam_noise   = 0.0;         // [e] ... and at most this read noise. 0 = Any
 
 int       img_bin     = 2;	     // Image binning - Must match camera binning (cam_bin)
 int       img_total   = IMG_TOTAL;   // Total number of images 
 int       img_cycle   = IMG_CYCLE;   // Images per revolution
+int       img_ring    = 0;           // Image buffers allocated in ring
+int       img_aoi_w   = 0;           // [px] Window width, unbinned. 0 = Full sensor
+int       img_aoi_h   = 0;           // [px] Window height
+int       img_aoi_x   =-1;           // [px] Window left offset. -ve = Centred
+int       img_aoi_y   =-1;           // [px] Window top offset.  -ve = Centred
+bool      img_stk     = false;       // Co-add all rotations at each position, write only the stacks
 AT_U8    *ImageBuffer = NULL;        // Monolithic memory allocation pointer
 AT_U8    *img_mono16  = NULL;        // Buffer containing image converted to 16-bit monochrome
 AT_64     img_mono16size = 0;        // Size of mono16 alloc'ed buffer
@@ -197,6 +210,11 @@ int       fts_ccdxbin = 2;           // X binning NOTE: Must equal img_bin
 int       fts_ccdybin = 2;           // Y binning NOTE: Must equal img_bin
 char      fts_id[]    = FTS_ID;      // Permitted list of FITS IDs (first char of filename)
 bool      fts_sync    = true;        // Write files immediately after acquisition
+bool      fts_elec    = false;       // Write float32 electrons calibrated by master dark or bias
+int       fts_bpm     = BPM_OFF;     // Bad pixel map use, BPM_OFF | BPM_DQ | BPM_FIX
+double    aex_peak    = AEX_PEAK;    // Acquisition target peak, fraction of saturation. 0 = No pre-pass
+int       foc_sweep   = 0;           // Runs in focus sweep. 0 = Not sweeping
+char     *foc_list    = NULL;        // Focus positions for sweep (used by command process)
 char      fts_pfx     = FTS_PFX_EXP; // Exposure code prefix
 char     *fts_typ     = FTS_TYP_EXP; // Exposure type  
 char      fts_obj[MAX_STR];          // Object name
@@ -205,17 +223,26 @@ char      fts_dec[MAX_STR];          // Object DEC
 char      fts_dir[MAX_STR];          // Destination for output files
 int       fts_run;                   // Run number
 
+int       shm_slots   = SHM_SLOTS;   // Shared memory frame ring slots. 0 = disabled
+int       xfr_port    = XFR_PORT;    // Frame pairing TCP port. 0 = disabled
+bool      xfr_pol     = false;       // Reduce pairs to Stokes q/u per rotation
+int       sch_prio    = 0;           // Acquisition SCHED_FIFO priority. 0 = RT profile off
+int       sch_cpu_acq = -1;          // Acquisition core. -1 = Not pinned
+int       sch_cpu_rot = -1;          // Rotator drain task core. -1 = Not pinned
+
 double    tel_foc     = TEL_UNSET;   // Telescope parameters for FITS file header
 double    tel_cas     = TEL_UNSET;
 double    tel_alt     = TEL_UNSET;
 double    tel_azm     = TEL_UNSET;   
 
 int       whl_pos     = 5;           // Default filter wheel position  
-int       whl_fd      = 0;           // Filter wheel file descriptor 
+int       whl_fd      = -1;          // Filter wheel file descriptor 
 char     *whl_dev     = WHL_DEV;     // Filter wheel device
 
 char     *ipmaster    = IPMASTER;    // Master  IP address xx.xx.xx.xx.xx.xx:port
 char     *ipslave     = IPSLAVE;     // Slave   IP address xx.xx.xx.xx.xx.xx:port  
+char     *ipslaves[CAM_MAX] = {IPSLAVE}; // Slave IP address list, camera 2 onwards
+int       mop_slaves  = 1;           // Number of slaves in ipslaves
 char     *ipcommand   = IPCOMMAND;   // Command IP address xx.xx.xx.xx.xx.xx:port  
 #else
 extern char    *at_erray[];
@@ -241,6 +268,9 @@ extern FILE    *mop_log_fp;
 extern mop_cam_t mop_cam;
 extern char    *mop_proc;
 extern bool     mop_kill; 
+extern char    *mop_seq; 
+extern bool     mop_qry; 
+extern bool     mop_abt; 
 
 extern int      rot_id;   
 extern char    *rot_axis;
@@ -249,6 +279,7 @@ extern double   rot_vel;
 extern double   rot_stp;
 extern int      rot_revs;
 extern double   rot_final;
+extern double   rot_last;
 extern char    *rot_usb;
 extern int      rot_sign;
 
@@ -264,10 +295,19 @@ extern wchar_t *cam_enc;
 extern wchar_t *cam_trg; 
 extern cam_info_t cam_info[CAM_COUNT];
 extern wchar_t *cam_bin;
+extern double   cam_stp;
+extern int      cam_bits;
+extern double   cam_noise;
 extern wchar_t *cam_rd;
 
 extern int      img_total;
 extern int      img_cycle;
+extern int      img_ring;
+extern int      img_aoi_w;
+extern int      img_aoi_h;
+extern int      img_aoi_x;
+extern int      img_aoi_y;
+extern bool     img_stk;
 extern AT_U8   *ImageBuffer;
 extern AT_U8   *img_mono16;
 extern AT_64    img_mono16size;
@@ -275,6 +315,11 @@ extern int      img_bin;
 
 extern char     fts_id[];
 extern bool     fts_sync;
+extern bool     fts_elec;
+extern int      fts_bpm;
+extern double   aex_peak;
+extern int      foc_sweep;
+extern char    *foc_list;
 extern char     fts_pfx;
 extern char    *fts_typ;
 extern char     fts_obj[MAX_STR];
@@ -285,6 +330,13 @@ extern int      fts_ccdxbin;
 extern int      fts_ccdybin;
 extern int      fts_run;
 
+extern int      shm_slots;
+extern int      xfr_port;
+extern bool     xfr_pol;
+extern int      sch_prio;
+extern int      sch_cpu_acq;
+extern int      sch_cpu_rot;
+
 extern double   tel_foc;
 extern double   tel_cas;
 extern double   tel_alt;
@@ -292,9 +344,11 @@ extern double   tel_azm;
 
 extern int      whl_pos; 
 extern char    *whl_dev;
-extern char     whl_fd;
+extern int      whl_fd;
 
 extern char    *ipmaster;
 extern char    *ipslave; 
+extern char    *ipslaves[CAM_MAX]; 
+extern int      mop_slaves;
 extern char    *ipcommand;  
 #endif
@@ -0,0 +1,234 @@
+/** @file   mop_foc.c
+  *
+  * @brief MOPTOP focus sweep
+  *
+  *        mopcmd -J<f1,f2,...> sends a sequence with one run per telescope focus position, each marked -H<n>.
+  *        Sources are found in every frame the master writes during the sweep and the frame's focus metric
+  *        is the median FWHM of its brightest sources. Each run gives one point, the median over its frames.
+  *        When the last run ends a parabola is fitted to FWHM against focus and the best focus is sent to
+  *        mopcmd, which waits for it after the images.
+  *
+  *        Nothing here moves the focus. At the start of each sweep run the master asks mopcmd to move it and
+  *        mopcmd runs the external mover named by FOC_ENV. Acquisition waits for mopcmd's confirmation. A run
+  *        acquired without one gives no point.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#include "mopnet.h"
+#define FAC FAC_FOC
+
+static double foc_frm[MAX_IMAGES]; // Frame metrics this run
+static int    foc_nfrm = 0;
+static double foc_pos[MSG_QUEUE];  // Focus and metric per run
+static double foc_val[MSG_QUEUE];
+static int    foc_num  = 0;
+static bool   foc_set  = false;    // Focus confirmed in position this run
+
+/** @brief      Compare doubles for qsort()
+  *
+  * @param[in]  *a = value
+  * @param[in]  *b = value
+  *
+  * @return     <0 | 0 | >0 = a < b | a == b | a > b
+  */
+static int foc_cmp( const void *a, const void *b )
+{
+    double d = *(const double *)a - *(const double *)b;
+
+    return ( d > 0.0 ) - ( d < 0.0 );
+}
+
+
+/** @brief      Median, reorders values
+  *
+  * @param[in,out] *v = values
+  * @param[in]      n = number of values, > 0
+  *
+  * @return     median
+  */
+static double foc_median( double *v, int n )
+{
+    qsort( v, n, sizeof(double), foc_cmp );
+
+    return n & 1 ? v[n/2] : 0.5 * ( v[n/2-1] + v[n/2] );
+}
+
+
+/** @brief      Add focus metric of the frame just searched. Frames without sources are skipped
+  *
+  * @param[in] *cam = pointer to camera info structure, sources of last frame
+  *
+  * @return     true | false = Added | No sources
+  */
+bool foc_add( mop_cam_t *cam )
+{
+    double w[IMG_SRC_TOP];
+    int    n = cam->SrcN < IMG_SRC_TOP ? cam->SrcN : IMG_SRC_TOP;
+
+    if ( n <= 0 || foc_nfrm >= MAX_IMAGES )
+        return false;
+
+    for ( int i = 0; i < n; i++ )
+        w[i] = cam->Src[i].fwhm;
+    foc_frm[foc_nfrm++] = foc_median( w, n );
+
+    return true;
+}
+
+
+/** @brief      Fit FWHM = a + b.d + c.d^2, d = focus offset from mean, and report the minimum
+  *
+  * @return     true | false = Minimum found | Fit failed, best measured point reported
+  */
+static bool foc_fit( void )
+{
+    char   msg[MAX_STR];
+    double m = 0.0;
+    double s[5] = {0.0};   // Sums of d^0 to d^4
+    double t[3] = {0.0};   // Sums of y.d^0 to y.d^2
+    double det, a, b, c, d, best;
+    double lo = foc_pos[0];
+    double hi = foc_pos[0];
+    int    k  = 0;
+    bool   ok;
+
+    for ( int i = 0; i < foc_num; i++ )
+    {
+        m += foc_pos[i] / foc_num;
+        lo = fmin( lo, foc_pos[i] );
+        hi = fmax( hi, foc_pos[i] );
+        if ( foc_val[i] < foc_val[k] )
+            k = i;
+    }
+
+    for ( int i = 0; i < foc_num; i++ )
+    {
+        d = foc_pos[i] - m;
+        for ( int j = 0; j < 5; j++ )
+            s[j] += pow( d, j );
+        for ( int j = 0; j < 3; j++ )
+            t[j] += foc_val[i] * pow( d, j );
+    }
+
+//  Normal equations by Cramer's rule
+    det = s[0] * ( s[2] * s[4] - s[3] * s[3] ) - s[1] * ( s[1] * s[4] - s[3] * s[2] ) + s[2] * ( s[1] * s[3] - s[2] * s[2] );
+    ok  = foc_num >= FOC_MIN && fabs( det ) > 0.0;
+    if ( ok )
+    {
+        a = ( t[0] * ( s[2] * s[4] - s[3] * s[3] ) - s[1] * ( t[1] * s[4] - s[3] * t[2] ) + s[2] * ( t[1] * s[3] - s[2] * t[2] )) / det;
+        b = ( s[0] * ( t[1] * s[4] - s[3] * t[2] ) - t[0] * ( s[1] * s[4] - s[3] * s[2] ) + s[2] * ( s[1] * t[2] - t[1] * s[2] )) / det;
+        c = ( s[0] * ( s[2] * t[2] - t[1] * s[3] ) - s[1] * ( s[1] * t[2] - t[1] * s[2] ) + t[0] * ( s[1] * s[3] - s[2] * s[2] )) / det;
+        best = m - b / ( 2.0 * c );
+        ok   = c > 0.0 && best >= lo && best <= hi;
+    }
+
+    if ( ok )
+    {
+        d = best - m;
+        snprintf( msg, sizeof(msg), MSG_FOC" %.4f FWHM=%.3f N=%i", best, a + b * d + c * d * d, foc_num );
+    }
+    else
+    {
+        snprintf( msg, sizeof(msg), MSG_FOC" %.4f FWHM=%.3f N=%i NOFIT", foc_pos[k], foc_val[k], foc_num );
+    }
+    msg_send( 0, msg, ipcommand, NULL, 0 );
+
+    return mop_log( ok, ok ? LOG_INF : LOG_WRN, FAC, "%s", msg );
+}
+
+
+/** @brief      Ask the command process to move the telescope focus for this sweep run. Master only
+  *
+  * @return     true
+  */
+bool foc_move( void )
+{
+    char msg[MAX_STR];
+
+    foc_set = false;
+    if ( !foc_sweep )
+        return true;
+
+    snprintf( msg, sizeof(msg), MSG_FMV" %.4f", tel_foc );
+    msg_send( 0, msg, ipcommand, NULL, 0 );
+
+    return mop_log( true, LOG_INF, FAC, "Focus move to %.4f requested", tel_foc );
+}
+
+
+/** @brief      Wait for the command process to confirm the focus move. The slaves are already committed to
+  *             the run so it goes ahead regardless, but gives no point unless confirmed.
+  *
+  * @param[in]  timeout = timeout [s]
+  *
+  * @return     true | false = In position or not sweeping | Not confirmed
+  */
+bool foc_wait( int timeout )
+{
+    char   msg[MSG_LEN];
+    int    len;
+    double pos;
+
+    if ( !foc_sweep )
+        return true;
+
+    foc_set = msg_wait( timeout, msg, sizeof(msg)-1, &len, MSG_FDN, strlen(MSG_FDN) ) &&
+              sscanf( msg, MSG_FDN" %lf", &pos ) == 1 && fabs( pos - tel_foc ) < 1.0E-4;
+
+    return mop_log( foc_set, foc_set ? LOG_INF : LOG_ERR, FAC, "Focus %.4f %s", tel_foc, foc_set ? "in position" : "not confirmed" );
+}
+
+
+/** @brief      End of a sweep run. Adds its point and on the last run fits and resets. Master only
+  *
+  * @param[in]  first = first run of sweep, discard any points left by an aborted one
+  * @param[in]  last  = last run of sweep
+  *
+  * @return     true | false = Success | No point or fit failed
+  */
+bool foc_run( bool first, bool last )
+{
+    bool ok = true;
+
+    if ( !foc_sweep )
+        return true;
+
+    if ( first )
+        foc_num = 0;
+
+    if ( !foc_set )
+    {
+        ok = mop_log( false, LOG_WRN, FAC, "Focus %.4f not confirmed. Point dropped", tel_foc );
+    }
+    else if ( foc_nfrm && foc_num < MSG_QUEUE )
+    {
+        foc_pos[foc_num] = tel_foc;
+        foc_val[foc_num] = foc_median( foc_frm, foc_nfrm );
+        mop_log( true, LOG_INF, FAC, "Focus %.4f FWHM %.3f px from %i frames. Point %i of %i",
+                 tel_foc, foc_val[foc_num], foc_nfrm, foc_num+1, foc_sweep );
+        foc_num++;
+    }
+    else
+    {
+        ok = mop_log( false, LOG_WRN, FAC, "Focus %.4f no sources. Point dropped", tel_foc );
+    }
+    foc_nfrm = 0;
+
+    if ( last )
+    {
+        if ( foc_num )
+            ok = foc_fit() && ok;
+        else
+        {
+            msg_send( 0, MSG_FOC" 0 NOFIT", ipcommand, NULL, 0 );
+            ok = mop_log( false, LOG_ERR, FAC, "Focus sweep without sources" );
+        }
+        foc_num   = 0;
+        foc_sweep = 0;
+    }
+
+    return ok;
+}
@@ -7,6 +7,7 @@
   *   YYYYMMDD = ISO format Julian date 
   *   RUN      = Run number starting at 1
   *   SEQ      = Sequence number (==rotation angle) starting at 1
+  *   The field between RUN and SEQ is the rotation number, 0 for a co-added stack 
   *
   * E.g.  d_e_20190130_4_0_8.fits
   *
@@ -60,7 +61,7 @@ int fts_compare( const struct dirent **entry1, const struct dirent **entry2 )
   * 
   * @param[in] *cam  = pointer to camera data structure
   * @param[in]  typ  = character identifying file type 
-  * @param[in]  frun = -1=first call, 0=generate next filename, >0 = force run number 
+  * @param[in]  frun = -1=first call, 0=generate next filename, -2=next stack filename, >0 = force run number 
   *
   * @return    string pointer to a generated filename held locally 
   */
@@ -68,7 +69,7 @@ char *fts_mkname( mop_cam_t *cam, char typ, int *frun )
 {
     int     i; 
     time_t  tim;          // Unix time, since 1970-01-01
-    const struct tm *now; // Broken down time
+    struct tm now;        // Broken down time
     struct dirent **fts_files;
 
 //  Data retained between calls 
@@ -100,17 +101,27 @@ char *fts_mkname( mop_cam_t *cam, char typ, int *frun )
         return filename;
     } 
 
+    // Co-added stack of all rotations at a position has rotation number 0 
+    if ( *frun == FTS_STACK )
+    {
+        sprintf( filename, "%s/%c_%c_%04i%02i%02i_%i_0_%i_0.fits",
+                 fts_dir, cam->id, typ, year, mon, day, run, 1+(cam->seq)%img_cycle );
+        cam->seq++;
+
+        return filename;
+    } 
+
 //  First call so clear flag and init. sequence number       
     cam->seq = 0;
 
 //  Get time now and convert to broken-down numeric fields    
     if ( time(&tim) == (time_t) -1 )
         mop_log( false, LOG_SYS, FAC, "time()" );
-    now = localtime(&tim);
-    day  = now->tm_mday;
-    mon  = now->tm_mon  + 1;
-    year = now->tm_year + 1900;
-    hour = now->tm_hour;
+    localtime_r( &tim, &now );
+    day  = now.tm_mday;
+    mon  = now.tm_mon  + 1;
+    year = now.tm_year + 1900;
+    hour = now.tm_hour;
 
 //  32-bit Unix time rolls-over in 2038. So has it been fixed yet?      
     if (year>2038)
@@ -145,7 +156,7 @@ char *fts_mkname( mop_cam_t *cam, char typ, int *frun )
     sprintf( fts_file_str, "_%04i%02i%02i_", year, mon, day);
 
 //  Search existing files for next available run number 
-    for ( run = 1, c = 1; c <= CAM_COUNT; c++ )
+    for ( run = 1, c = 1; c <= CAM_MAX; c++ )
     {
         sprintf( fts_file_pfx, FTS_PFX, c );
 //        i = scandir( fts_dir, &fts_files, fts_selname, versionsort );
@@ -167,6 +178,48 @@ char *fts_mkname( mop_cam_t *cam, char typ, int *frun )
 }
 
 
+/** @brief       Get Mono16 pixels for an image buffer. Layout is taken from the frame's metadata,
+  *              or from the camera settings if it has no frame info. Metadata is left in cam->Meta
+  *
+  * @param[in]  *cam = pointer to camera data structure 
+  * @param[in]   buf = index to buffer containing image
+  *
+  * return       Mono16 pixel data, contiguous rows 
+  */
+AT_U8 *fts_mono16( mop_cam_t *cam, int buf )
+{
+    cam_md_t *md = &cam->Meta;
+    size_t    row;
+
+//  Layout from the frame's own metadata, if it has frame info matching the buffer allocation 
+    if ( cam_meta( cam->ImageBuffer[buf], cam->ImageSizeBytes, md ) && md->has_info &&
+         (AT_64)md->width * md->height == img_mono16size &&
+         ( md->enc == CAM_MD_ENC_16 || md->enc == CAM_MD_ENC_12 ) &&
+         md->stride >= 2 * md->width && (size_t)md->stride * md->height <= md->bytes )
+    {
+//      16-bit words, Mono12 too. Straight from buffer if rows unpadded, else copied row by row 
+        if ( md->stride == 2 * md->width )
+            return md->pix;
+
+        row = 2 * md->width;
+        for ( size_t y = 0; y < md->height; y++ )
+            memcpy( img_mono16 + y * row, md->pix + y * md->stride, row );
+
+        return img_mono16;
+    }
+
+//  No frame info. 16-bit with unpadded rows so use data straight from buffer    
+    if ( !md->has_info && !wcscmp( cam_enc, CAM_ENC_16 ) && cam->AOIStride == 2 * cam->AOIWidth )
+        return cam->ImageBuffer[buf];
+
+//  12-bit packed, or padded window rows, so convert to contiguous 16-bit 
+    at_chk( AT_ConvertBufferUsingMetadata( cam->ImageBuffer[buf], img_mono16, cam->ImageSizeBytes, L"Mono16" ),
+            "ConvertBufferUsingMetadata", L"Mono16" );  
+
+    return img_mono16;
+}
+
+
 /** @brief       Write FITS file  
   *
   * @param[out] *filename = pointer to returned filespec + filename 
@@ -202,6 +255,13 @@ bool fts_write( char *filename, mop_cam_t *cam, int seq, int buf )
     double ccdatemp = cam->SensorTemperature + 273.15; // K 
     double mjd      = (time(NULL)/86400.0) + 40587;
 
+//  Window offsets. LTVn map image to unbinned physical pixels 
+    int    wmode    = cam->AOIWidth * img_bin < cam->SensorWidth || cam->AOIHeight * img_bin < cam->SensorHeight;
+    long   wxoff    = cam->AOILeft - 1;
+    long   wyoff    = cam->AOITop  - 1;
+    double ltv1     = -(double)wxoff / img_bin;
+    double ltv2     = -(double)wyoff / img_bin;
+
 //  For converting wide char strings to ASCII. +1 ensures space for \nul 
     char det_model[STR_LEN + 1];
     char det_serno[STR_LEN + 1];
@@ -215,8 +275,17 @@ bool fts_write( char *filename, mop_cam_t *cam, int seq, int buf )
     static char  text[80]; // FITS status text
 
     fitsfile *fp;
-
-    const struct tm *tim; 
+    AT_U8    *pix;         // Mono16 pixel data
+    AT_U8    *fix;         // Bad pixels interpolated
+    float    *ele = NULL;  // Calibrated electrons
+    char      ref[MAX_STR];// Master used
+    uint8_t  *bad = NULL;  // Bad pixel map
+    int       nbad = 0;    // Pixels flagged
+    char     *mode = "DQ"; // Map use
+    char      bpm[MAX_STR];// Map used
+    static char *md_enc[] = { "Mono12", "Mono12Packed", "Mono16" }; // Metadata encodings 
+
+    struct tm tim; 
 
 //  Convert those cursed wide-chars into proper ASCII 
     wcstombs( det_model, cam->Model, STR_LEN );
@@ -227,6 +296,36 @@ bool fts_write( char *filename, mop_cam_t *cam, int seq, int buf )
     wcstombs( trigger,   cam_trg, STR_LEN );
     wcstombs( det_rd,    cam_rd,  STR_LEN );
 
+    pix = fts_mono16( cam, buf );
+    if ( cam->Meta.has_info && cam->Meta.enc <= CAM_MD_ENC_16 )
+        strcpy( det_encod, md_enc[cam->Meta.enc] );
+
+//  Publish to local consumers and pass to master for pairing before the slower file write
+    shm_put( cam, seq, filename, pix, 2 * img_mono16size );
+    xfr_put( cam, seq, filename, pix, 2 * img_mono16size );
+
+//  Statistics of raw frame for header and notification. Acquisition frames are searched for sources
+    img_stats( cam, pix, &cam->Sta );
+    cam->SrcN = -1;
+    if ( fts_pfx == FTS_PFX_ACQ || ( foc_sweep && mop_master ))
+        cam->SrcN = img_find( cam, pix, &cam->Sta, cam->Src );
+    if ( foc_sweep && mop_master )
+        foc_add( cam );
+
+//  Raw frames build any master. Bad pixels of others are optionally interpolated before calibration
+    lib_add( pix );
+    if ( fts_bpm && ( bad = bpm_get( cam, &nbad, bpm )) && fts_bpm == BPM_FIX )
+    {
+        mode = "RAW";
+        if ( fts_pfx != FTS_PFX_BIAS && fts_pfx != FTS_PFX_DARK && ( fix = bpm_fix( cam, pix, bad )))
+        {
+            pix  = fix;
+            mode = "INTERP";
+        }
+    }
+    if ( fts_elec && ( ele = lib_apply( cam, pix, ref )))
+        bitpix = -32;
+
 //  Create file and image
     fits_create_file( &fp, filename, &stat);
     if (stat)
@@ -235,7 +334,7 @@ bool fts_write( char *filename, mop_cam_t *cam, int seq, int buf )
         mop_log( false, LOG_ERR, FAC, "fits_create_file(%s) status=%i=%s", filename, stat, text );
     }
 
-    fits_create_img(fp, USHORT_IMG, IMG_DIMENSIONS, cam->Dimension, &stat);
+    fits_create_img(fp, ele ? FLOAT_IMG : USHORT_IMG, IMG_DIMENSIONS, cam->Dimension, &stat);
     if (stat)
     {
         fits_get_errstatus(stat, text);
@@ -243,9 +342,9 @@ bool fts_write( char *filename, mop_cam_t *cam, int seq, int buf )
     }
 
 //  Generate start date/time strings    
-    tim=localtime(&cam->ObsStart.tv_sec);
-    len=strftime( t, sizeof(t)-1, "%H:%M:%S", tim); // Time
-    strftime( d, sizeof( d)-1, "%Y-%m-%d",    tim); // Date
+    localtime_r(&cam->ObsStart.tv_sec, &tim);
+    len=strftime( t, sizeof(t)-1, "%H:%M:%S", &tim); // Time
+    strftime( d, sizeof( d)-1, "%Y-%m-%d",    &tim); // Date
     snprintf( dt,sizeof(dt)-1, "%sT%s", d, t );     // Date & time in ISO format (but no fractional seconds)
     snprintf( s, sizeof( s)-1, "%.3f", cam->ObsStart.tv_usec/TIM_MICROSECOND ); // Get fractional sec
     strncat( &dt[len], &s[1], sizeof(dt)-1 - len);  // Append fraction omitting decimal point
@@ -295,9 +394,9 @@ bool fts_write( char *filename, mop_cam_t *cam, int seq, int buf )
     fits_write_key(fp, TSTRING ,"UTSTART ",t              ,"[UTC] Start time of obs.",&stat);
 
 //  Generate end date/time strings    
-    tim=localtime(&cam->ObsEnd.tv_sec);
-    len=strftime( t, sizeof(t)-1, "%H:%M:%S", tim); // Time
-    strftime( d, sizeof( d)-1, "%Y-%m-%d",    tim); // Date
+    localtime_r(&cam->ObsEnd.tv_sec, &tim);
+    len=strftime( t, sizeof(t)-1, "%H:%M:%S", &tim); // Time
+    strftime( d, sizeof( d)-1, "%Y-%m-%d",    &tim); // Date
     snprintf( dt,sizeof(dt)-1, "%sT%s", d, t );     // Date & time in ISO format (no fractional seconds)
     snprintf( s, sizeof( s)-1, "%.3f", cam->ObsEnd.tv_usec/TIM_MICROSECOND ); // Get fractional sec 
     strncat( &dt[len], &s[1], sizeof(dt)-1 -len);   // Append fraction omitting decimal point
@@ -325,6 +424,13 @@ bool fts_write( char *filename, mop_cam_t *cam, int seq, int buf )
     fits_write_key(fp, TDOUBLE,"GAIN    ",&cam->Gain       ,"[e/ADU] Detector gain"     ,&stat);
     fits_write_key(fp, TINT   ,"CCDXBIN ",&fts_ccdxbin     ,"X binning"                 ,&stat);
     fits_write_key(fp, TINT   ,"CCDYBIN ",&fts_ccdybin     ,"Y binning"                 ,&stat);
+    fits_write_key(fp, TLOGICAL,"CCDWMODE",&wmode          ,"Using a window"            ,&stat);
+    fits_write_key(fp, TLONG  ,"CCDWXOFF",&wxoff           ,"[px] Window X offset, unbinned",&stat);
+    fits_write_key(fp, TLONG  ,"CCDWYOFF",&wyoff           ,"[px] Window Y offset, unbinned",&stat);
+    fits_write_key(fp, TLONG  ,"CCDWXSIZ",&cam->Dimension[IMG_WIDTH] ,"[px] Window width, binned" ,&stat);
+    fits_write_key(fp, TLONG  ,"CCDWYSIZ",&cam->Dimension[IMG_HEIGHT],"[px] Window height, binned",&stat);
+    fits_write_key(fp, TDOUBLE,"LTV1    ",&ltv1            ,"Image to physical X offset",&stat);
+    fits_write_key(fp, TDOUBLE,"LTV2    ",&ltv2            ,"Image to physical Y offset",&stat);
     fits_write_key(fp, TDOUBLE,"CCDATEMP",&ccdatemp        ,"[K] Detector temperature"  ,&stat);
     fits_write_key(fp, TSTRING,"CCDTYPE ","sCMOS"          ,"Detector type"             ,&stat);
     fits_write_key(fp, TSTRING,"CCDMODEL",det_model        ,"Detector model"            ,&stat);
@@ -332,6 +438,8 @@ bool fts_write( char *filename, mop_cam_t *cam, int seq, int buf )
     fits_write_key(fp, TSTRING,"CCDRATE ",det_rate         ,"[MHz] Detector read rate " ,&stat);
     fits_write_key(fp, TSTRING,"CCDORDER",det_rd           ,"Detector read order"       ,&stat);
     fits_write_key(fp, TSTRING,"CCDENCOD",det_encod        ,"Detector pixel encoding"   ,&stat);
+    if ( cam->Meta.has_info )
+        fits_write_key(fp, TUSHORT,"CCDSTRID",&cam->Meta.stride,"[bytes] Detector row stride, from metadata",&stat);
     fits_write_key(fp, TSTRING,"CCDAMP  ",det_amp          ,"Detector pre-amp gain mode",&stat);
     fits_write_key(fp, TINT   ,"CCDDEPTH",&cam->WellDepth  ,"[e] Detector well depth"   ,&stat);
     fits_write_key(fp, TDOUBLE,"CCDDARK ",&cam->DarkCurrent,"[e/px/s] Detector median dark current"  ,&stat);
@@ -340,20 +448,43 @@ bool fts_write( char *filename, mop_cam_t *cam, int seq, int buf )
     fits_write_key(fp, TULONG ,"CLKFREQ ",&cam->TimestampClockFrequency, "[Hz] Detector clock tick frequency",&stat);
     fits_write_key(fp, TULONG ,"CLKSTAMP",&cam->TimestampClock[seq],     "Image clock tick value", &stat);
 
+//  Raw frame statistics
+    fits_write_key(fp, TUSHORT,"IMGMIN  ",&cam->Sta.min    ,"[ADU] Minimum"             ,&stat);
+    fits_write_key(fp, TUSHORT,"IMGMAX  ",&cam->Sta.max    ,"[ADU] Maximum"             ,&stat);
+    fits_write_key(fp, TDOUBLE,"IMGMEAN ",&cam->Sta.mean   ,"[ADU] Mean"                ,&stat);
+    fits_write_key(fp, TDOUBLE,"IMGMED  ",&cam->Sta.median ,"[ADU] Median, sampled"     ,&stat);
+    fits_write_key(fp, TDOUBLE,"IMGBKG  ",&cam->Sta.bkg    ,"[ADU] Background, sampled" ,&stat);
+    fits_write_key(fp, TDOUBLE,"IMGBKSIG",&cam->Sta.sigma  ,"[ADU] Background noise, sampled",&stat);
+    fits_write_key(fp, TUSHORT,"SATLEVEL",&cam->Sta.lim    ,"[ADU] Saturation level"    ,&stat);
+    fits_write_key(fp, TUINT  ,"NSATPIX ",&cam->Sta.sat    ,"Pixels above SATLEVEL"     ,&stat);
+    if ( cam->SrcN >= 0 )
+        fits_write_key(fp, TINT   ,"NSRC    ",&cam->SrcN       ,"Sources detected"          ,&stat);
+    if ( cam->SrcN > 0 )
+    {
+        fits_write_key(fp, TDOUBLE,"SRCX    ",&cam->Src[0].x   ,"[px] Brightest source X centroid",&stat);
+        fits_write_key(fp, TDOUBLE,"SRCY    ",&cam->Src[0].y   ,"[px] Brightest source Y centroid",&stat);
+        fits_write_key(fp, TDOUBLE,"SRCFLUX ",&cam->Src[0].flux,"[ADU] Brightest source flux"     ,&stat);
+        fits_write_key(fp, TDOUBLE,"SRCFWHM ",&cam->Src[0].fwhm,"[px] Brightest source FWHM"      ,&stat);
+    }
 
-    if ( !wcscmp( cam_enc, CAM_ENC_16 ) )
+    if ( bad )
     {
-//      16-bit so write data straight from buffer    
-//        fits_write_img(fp, TUSHORT, 1, cam->ImageSizeBytes, cam->ImageBuffer[buf], &stat);
-        fits_write_img(fp, TUSHORT, 1, img_mono16size, cam->ImageBuffer[buf], &stat);
+        fits_write_key(fp, TSTRING,"BPMAP   ",bpm          ,"Bad pixel map"                        ,&stat);
+        fits_write_key(fp, TINT   ,"NBADPIX ",&nbad        ,"Pixels flagged in map"                ,&stat);
+        fits_write_key(fp, TSTRING,"BPMMODE ",mode         ,"Flagged pixels in DQ, RAW or INTERP"   ,&stat);
     }
-    else
+
+    if ( ele )
     {
-//      12-bit so convert to 16-bit depth before writing
-        at_chk( AT_ConvertBufferUsingMetadata( cam->ImageBuffer[buf], img_mono16, cam->ImageSizeBytes, L"Mono16" ),
-                "ConvertBufferUsingMetadata", L"Mono16" );  
-        fits_write_img(fp, TUSHORT, 1, img_mono16size, img_mono16, &stat);
+        fits_write_key(fp, TSTRING,"BUNIT   ","electrons"  ,"Pixel units"                          ,&stat);
+        fits_write_key(fp, TSTRING,"CALMASTR",ref          ,"Master subtracted, then scaled by GAIN",&stat);
+        fits_write_img(fp, TFLOAT , 1, img_mono16size, ele, &stat);
     }
+    else
+        fits_write_img(fp, TUSHORT, 1, img_mono16size, pix, &stat);
+
+    if ( bad && fts_bpm == BPM_DQ )
+        stat = stat ? stat : bpm_dq( fp, cam, bad );
 
     if ( stat )
     {
@@ -365,3 +496,231 @@ bool fts_write( char *filename, mop_cam_t *cam, int seq, int buf )
 
     return true;
 }
+
+
+/** @brief       Write one image HDU of a paired product 
+  *
+  * @param[in]  *fp  = open FITS file 
+  * @param[in]  *frm = frame header
+  * @param[in]  *pix = Mono16 pixel data 
+  *
+  * return      FITS status 
+  */
+static int fts_pair_hdu( fitsfile *fp, shm_frm_t *frm, AT_U8 *pix )
+{
+    int   stat = 0;
+    long  dim[IMG_DIMENSIONS];
+    char  dt[80]; 
+    char  us[16]; 
+    char *name;
+    int   cam  = frm->cam;
+    struct tm tim;
+
+    dim[IMG_WIDTH ] = frm->width;
+    dim[IMG_HEIGHT] = frm->height;
+    fits_create_img( fp, USHORT_IMG, IMG_DIMENSIONS, dim, &stat );
+
+//  ISO start time with milliseconds
+    strftime( dt, sizeof(dt)-1, "%Y-%m-%dT%H:%M:%S", localtime_r( &frm->obs_start.tv_sec, &tim ));
+    snprintf( us, sizeof(us), ".%03li", frm->obs_start.tv_usec / 1000 );
+    strncat( dt, us, sizeof(dt)-1 - strlen(dt) );
+
+//  Original file name without path
+    name = ( name = strrchr( frm->name, '/' )) ? name + 1 : frm->name;
+
+    fits_write_key( fp, TINT   , "CAMERA  ", &cam         , "MOPTOP camera number"                   , &stat );
+    fits_write_key( fp, TSTRING, "ORIGFILE", name         , "Camera FITS file"                       , &stat );
+    fits_write_key( fp, TINT   , "RUN     ", &frm->run    , "Run number"                             , &stat );
+    fits_write_key( fp, TSTRING, "DATE-OBS", dt           , "[UTC] Start of obs."                    , &stat );
+    fits_write_key( fp, TDOUBLE, "EXPTIME ", &frm->exp    , "[sec] Actual exposure"                  , &stat );
+    fits_write_key( fp, TDOUBLE, "MOPRREQ ", &frm->rot_req, "[deg] MOPTOP Rotator requested angle"   , &stat );
+    fits_write_key( fp, TDOUBLE, "MOPRBEG ", &frm->rot_ang, "[deg] MOPTOP Rotator begin angle"       , &stat );
+    fits_write_key( fp, TDOUBLE, "MOPREND ", &frm->rot_end, "[deg] MOPTOP Rotator angle"             , &stat );
+    fits_write_key( fp, TINT   , "MOPRNUM ", &frm->rot_n  , "MOPTOP Rotation number"                 , &stat );
+    fits_write_key( fp, TINT   , "MOPRPOS ", &frm->seq_n  , "MOPTOP Position number within rotation" , &stat );
+    fits_write_key( fp, TULONG , "CLKSTAMP", &frm->clock  , "Image clock tick value"                 , &stat );
+    fits_write_img( fp, TUSHORT, 1, frm->bytes / 2, pix, &stat );
+
+    return stat;
+}
+
+
+/** @brief       Write paired product, both camera images for one rotator position.
+  *              Primary HDU is this camera, extension is the other camera. 
+  *              Named after this camera's file with FTS_SFX_PAIR replacing the suffix.
+  *
+  * @param[in]  *mine     = this camera frame header 
+  * @param[in]  *mine_pix = this camera Mono16 pixel data 
+  * @param[in]  *peer     = other camera frame header 
+  * @param[in]  *peer_pix = other camera Mono16 pixel data 
+  *
+  * return      true | false = Success | Failure
+  */
+bool fts_pair( shm_frm_t *mine, AT_U8 *mine_pix, shm_frm_t *peer, AT_U8 *peer_pix )
+{
+    char      filename[MAX_STR];
+    char      text[80];
+    char     *sfx;
+    int       stat = 0;
+    fitsfile *fp;
+
+    strncpy( filename, mine->name, sizeof(filename) - sizeof(FTS_SFX_PAIR) );
+    filename[ sizeof(filename) - sizeof(FTS_SFX_PAIR) ] = '\0';
+    if (( sfx = strstr( filename, FTS_SFX )))
+        *sfx = '\0';
+    strcat( filename, FTS_SFX_PAIR );
+
+    fits_create_file( &fp, filename, &stat );
+    if ( !stat )
+    {
+        if ( !( stat = fts_pair_hdu( fp, mine, mine_pix )))
+            stat = fts_pair_hdu( fp, peer, peer_pix );
+        fits_close_file( fp, &stat );
+    }
+
+    if ( stat )
+    {
+        fits_get_errstatus( stat, text );
+        return mop_log( false, LOG_ERR, FAC, "fts_pair(%s) status=%i=%s", filename, stat, text );
+    }
+
+    return mop_log( true, LOG_IMG, FAC, "Paired %s", filename );
+}
+
+
+/** @brief       Write co-added stack of one rotator position as 32-bit unsigned 
+  *
+  * @param[in]  *filename = filespec 
+  * @param[in]  *cam      = pointer to camera data structure 
+  * @param[in]  *pos      = stack for this position
+  * @param[in]   seq      = position index, 0 based
+  *
+  * return      true | false = Success | Failure
+  */
+bool fts_stack( char *filename, mop_cam_t *cam, stk_pos_t *pos, int seq )
+{
+    int    stat = 0;
+    char   text[80];
+    char   dt[80]; 
+    char   us[16]; 
+    char   det_serno[MAX_STR];
+    struct tm tim;
+    fitsfile *fp;
+
+    int    rpos = seq + 1;
+    double n    = pos->num;
+    double ang  = fmod( pos->ang + pos->ang_sum / n + 360.0, 360.0 );
+    double end  = fmod( pos->end + pos->end_sum / n + 360.0, 360.0 );
+    double asd  = sqrt( fmax( pos->ang_sq / n - pow( pos->ang_sum / n, 2 ), 0.0 ));
+    double esd  = sqrt( fmax( pos->end_sq / n - pow( pos->end_sum / n, 2 ), 0.0 ));
+    double arc  = pos->arc_sum / n;
+    double dur  = ( pos->obs_end.tv_sec  - pos->obs_start.tv_sec  ) +
+                  ( pos->obs_end.tv_usec - pos->obs_start.tv_usec ) / TIM_MICROSECOND;
+    long   wxoff = cam->AOILeft - 1;
+    long   wyoff = cam->AOITop  - 1;
+
+    wcstombs( det_serno, cam->SerialNumber, sizeof(det_serno)-1 );
+
+//  ISO start time with milliseconds
+    strftime( dt, sizeof(dt)-1, "%Y-%m-%dT%H:%M:%S", localtime_r( &pos->obs_start.tv_sec, &tim ));
+    snprintf( us, sizeof(us), ".%03li", pos->obs_start.tv_usec / 1000 );
+    strncat( dt, us, sizeof(dt)-1 - strlen(dt) );
+
+    fits_create_file( &fp, filename, &stat );
+    fits_create_img( fp, ULONG_IMG, IMG_DIMENSIONS, cam->Dimension, &stat );
+
+    fits_write_key( fp, TSTRING, "OBSTYPE ", fts_typ         , "Type of observation"                    , &stat );
+    fits_write_key( fp, TSTRING, "INSTRUME", "MOPTOP"        , "Instrument name"                        , &stat );
+    fits_write_key( fp, TINT   , "FILTER1 ", &whl_pos        , "Filter position "                       , &stat );
+    fits_write_key( fp, TSTRING, "FILTERID", whl_colour[whl_pos], "Filter name"                         , &stat );
+    fits_write_key( fp, TSTRING, "OBJECT  ", fts_obj         , ""                                       , &stat );
+    fits_write_key( fp, TSTRING, "RA      ", fts_ra          , ""                                       , &stat );
+    fits_write_key( fp, TSTRING, "DEC     ", fts_dec         , ""                                       , &stat );
+    fits_write_key( fp, TINT   , "RUN     ", &fts_run        , "Run number"                             , &stat );
+    fits_write_key( fp, TSTRING, "DATE-OBS", dt              , "[UTC] Start of first frame"             , &stat );
+    fits_write_key( fp, TDOUBLE, "DURATION", &dur            , "[sec] First frame start to last end"    , &stat );
+    fits_write_key( fp, TINT   , "NCOADD  ", &pos->num       , "Frames co-added"                        , &stat );
+    fits_write_key( fp, TDOUBLE, "EXPTIME ", &pos->exp       , "[sec] Summed exposure"                  , &stat );
+    fits_write_key( fp, TDOUBLE, "EXPFRAME", &cam->ExpVal    , "[sec] Exposure per frame"               , &stat );
+    fits_write_key( fp, TINT   , "MOPRPOS ", &rpos           , "MOPTOP Position number within rotation" , &stat );
+    fits_write_key( fp, TDOUBLE, "MOPRREQ ", &pos->req       , "[deg] MOPTOP Rotator requested angle"   , &stat );
+    fits_write_key( fp, TDOUBLE, "MOPRBEG ", &ang            , "[deg] Mean rotator begin angle"         , &stat );
+    fits_write_key( fp, TDOUBLE, "MOPRBSD ", &asd            , "[deg] Std. dev. rotator begin angle"    , &stat );
+    fits_write_key( fp, TDOUBLE, "MOPREND ", &end            , "[deg] Mean rotator end angle"           , &stat );
+    fits_write_key( fp, TDOUBLE, "MOPRESD ", &esd            , "[deg] Std. dev. rotator end angle"      , &stat );
+    fits_write_key( fp, TDOUBLE, "MOPRARC ", &arc            , "[deg] Mean exposure arc"                , &stat );
+    fits_write_key( fp, TDOUBLE, "GAIN    ", &cam->Gain      , "[e/ADU] Detector gain"                  , &stat );
+    fits_write_key( fp, TINT   , "CCDXBIN ", &fts_ccdxbin    , "X binning"                              , &stat );
+    fits_write_key( fp, TINT   , "CCDYBIN ", &fts_ccdybin    , "Y binning"                              , &stat );
+    fits_write_key( fp, TLONG  , "CCDWXOFF", &wxoff          , "[px] Window X offset, unbinned"         , &stat );
+    fits_write_key( fp, TLONG  , "CCDWYOFF", &wyoff          , "[px] Window Y offset, unbinned"         , &stat );
+    fits_write_key( fp, TSTRING, "CCDSERNO", det_serno       , "Detector serial number"                 , &stat );
+    fits_write_img( fp, TUINT  , 1, img_mono16size, pos->sum, &stat );
+    fits_close_file( fp, &stat );
+
+    if ( stat )
+    {
+        fits_get_errstatus( stat, text );
+        return mop_log( false, LOG_ERR, FAC, "fts_stack(%s) status=%i=%s", filename, stat, text );
+    }
+
+    return mop_log( true, LOG_IMG, FAC, "Stack %s %i frames %.3fs", filename, pos->num, pos->exp );
+}
+
+
+/** @brief       Write Stokes q/u product for one rotation. Primary HDU is q, extension is u.
+  *              Named after this camera's last frame in the rotation with FTS_SFX_POL replacing 
+  *              the position number and suffix.
+  *
+  * @param[in]  *frm = header of last frame in the rotation
+  * @param[in]   num = positions used 
+  * @param[in]  *q   = normalised Stokes q image
+  * @param[in]  *u   = normalised Stokes u image
+  * @param[in]   fq  = whole frame q
+  * @param[in]   fu  = whole frame u
+  *
+  * return      true | false = Success | Failure
+  */
+bool fts_pol( shm_frm_t *frm, int num, float *q, float *u, double fq, double fu )
+{
+    char      filename[MAX_STR];
+    char      text[80];
+    char     *sfx;
+    int       stat = 0;
+    long      dim[IMG_DIMENSIONS];
+    fitsfile *fp;
+
+    strncpy( filename, frm->name, sizeof(filename) - sizeof(FTS_SFX_POL) );
+    filename[ sizeof(filename) - sizeof(FTS_SFX_POL) ] = '\0';
+    if (( sfx = strstr( filename, FTS_SFX )))
+        *sfx = '\0';
+    if (( sfx = strrchr( filename, '_' )))
+        *sfx = '\0';
+    strcat( filename, FTS_SFX_POL );
+
+    dim[IMG_WIDTH ] = frm->width;
+    dim[IMG_HEIGHT] = frm->height;
+
+    fits_create_file( &fp, filename, &stat );
+    for ( int i = 0; i < 2 && !stat; i++ )
+    {
+        fits_create_img( fp, FLOAT_IMG, IMG_DIMENSIONS, dim, &stat );
+        fits_write_key ( fp, TSTRING, "EXTNAME ", i ? "U" : "Q", "Normalised Stokes parameter"   , &stat );
+        fits_write_key ( fp, TINT   , "RUN     ", &frm->run    , "Run number"                    , &stat );
+        fits_write_key ( fp, TINT   , "MOPRNUM ", &frm->rot_n  , "MOPTOP Rotation number"        , &stat );
+        fits_write_key ( fp, TINT   , "MOPRPOS ", &num         , "Positions in rotation"         , &stat );
+        fits_write_key ( fp, TDOUBLE, "EXPTIME ", &frm->exp    , "[sec] Exposure per position"   , &stat );
+        fits_write_key ( fp, TDOUBLE, "POLFQ   ", &fq          , "Whole frame normalised q"      , &stat );
+        fits_write_key ( fp, TDOUBLE, "POLFU   ", &fu          , "Whole frame normalised u"      , &stat );
+        fits_write_img ( fp, TFLOAT , 1, dim[IMG_WIDTH] * dim[IMG_HEIGHT], i ? u : q, &stat );
+    }
+    fits_close_file( fp, &stat );
+
+    if ( stat )
+    {
+        fits_get_errstatus( stat, text );
+        return mop_log( false, LOG_ERR, FAC, "fts_pol(%s) status=%i=%s", filename, stat, text );
+    }
+
+    return mop_log( true, LOG_IMG, FAC, "Stokes %s", filename );
+}
@@ -0,0 +1,378 @@
+/** @file   mop_img.c
+  *
+  * @brief MOPTOP image statistics
+  *
+  *        Every frame written gets min, max, mean and saturated pixel count from one vectorised pass over
+  *        all pixels. Median, background and noise come from a histogram of an evenly spread sample of
+  *        about IMG_SAMPLES pixels, so the cost stays small at any frame size. Only histogram bins between
+  *        the frame min and max are walked and cleared.
+  *        Background is the mode estimate 2.5 x median - 1.5 x clipped mean, or the median if the frame
+  *        is crowded. Results go into the FITS header and the notification sent to mopcmd.
+  *        Acquisition frames are also searched for sources in one raster pass. Pixels above background plus
+  *        IMG_SRC_NSIG sigma are joined into 8-connected components with union-find over two label rows,
+  *        accumulating flux weighted moments as they go, so nothing but the frame is read twice.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#include "mopnet.h"
+#define FAC FAC_IMG
+
+/// Connected component being built. Moments relative to frame origin
+typedef struct img_blob_s
+{
+    int      root;             //!< Union-find parent, itself if root
+    uint32_t n;                //!< Pixels 
+    uint16_t peak;             //!< Brightest pixel
+    double   f;                //!< Sum of flux above background 
+    double   fx, fy;           //!< First moments
+    double   fxx, fyy;         //!< Second moments
+} img_blob_t;
+
+static uint32_t   img_hist[IMG_HIST];    // Sample histogram, zero between uses
+static img_blob_t img_blob[IMG_SRC_MAX]; // Components. 0 = Background
+static int32_t   *img_lab = NULL;        // Labels for previous and current row
+static size_t     img_cap = 0;           // Label allocation [columns]
+
+/** @brief      Min, max, sum and count above a level in one pass.
+  *
+  * @param[in]  *pix = Mono16 pixels, 16 byte aligned
+  * @param[in]   n   = pixel count
+  * @param[in]   lim = saturation level
+  * @param[out] *min = minimum
+  * @param[out] *max = maximum
+  * @param[out] *sum = sum
+  * @param[out] *sat = pixels above lim
+  */
+static void img_scan( const uint16_t *restrict pix, size_t n, uint16_t lim,
+                      uint16_t *min, uint16_t *max, uint64_t *sum, uint32_t *sat )
+{
+    const uint16_t *p  = __builtin_assume_aligned( pix, 16 );
+    uint16_t        lo = UINT16_MAX;
+    uint16_t        hi = 0;
+    uint64_t        s  = 0;
+    uint32_t        c  = 0;
+
+    for ( size_t i = 0; i < n; i++ )
+    {
+        lo  = p[i] < lo ? p[i] : lo;
+        hi  = p[i] > hi ? p[i] : hi;
+        s  += p[i];
+        c  += p[i] > lim;
+    }
+    *min = lo;
+    *max = hi;
+    *sum = s;
+    *sat = c;
+}
+
+
+/** @brief      Histogram bin holding a cumulative count
+  *
+  * @param[in]  lo  = first occupied bin
+  * @param[in]  hi  = last occupied bin
+  * @param[in]  cnt = cumulative count wanted
+  *
+  * @return     bin
+  */
+static int img_quant( int lo, int hi, double cnt )
+{
+    double c = 0.0;
+
+    for ( int b = lo; b <= hi; b++ )
+        if (( c += img_hist[b] ) >= cnt )
+            return b;
+
+    return hi;
+}
+
+
+/** @brief      Statistics of a Mono16 frame. Saturation level is the lower of the
+  *             amplifier ADU limit and well depth, times IMG_SAT
+  *
+  * @param[in]  *cam = pointer to camera info structure, configured
+  * @param[in]  *pix = Mono16 pixels, img_mono16size of them
+  * @param[out] *sta = statistics
+  *
+  * @return      true | false = Success | No pixels
+  */
+bool img_stats( mop_cam_t *cam, AT_U8 *pix, img_sta_t *sta )
+{
+    const uint16_t *p = (uint16_t *)pix;
+    size_t   n    = img_mono16size;
+    size_t   step = n / IMG_SAMPLES | 1;  // Odd so sampling does not follow columns
+    double   adu  = wcscmp( cam_amp, CAM_AMP_16L ) ? 4095.0 : UINT16_MAX;
+    double   num  = 0.0;
+    double   sum  = 0.0;
+    double   lo, hi;
+    uint64_t tot;
+    int      q1, q3;
+
+    memset( sta, 0, sizeof(img_sta_t) );
+    if ( !n )
+        return false;
+
+    if ( cam->Gain > 0.0 && cam->WellDepth / cam->Gain < adu )
+        adu = cam->WellDepth / cam->Gain;
+    sta->lim = IMG_SAT * adu;
+
+    img_scan( p, n, sta->lim, &sta->min, &sta->max, &tot, &sta->sat );
+    sta->mean = (double)tot / n;
+
+    for ( size_t i = 0; i < n; i += step )
+        img_hist[p[i]]++;
+    num = ( n + step - 1 ) / step;
+
+    q1          = img_quant( sta->min, sta->max, 0.25 * num );
+    sta->median = img_quant( sta->min, sta->max, 0.50 * num );
+    q3          = img_quant( sta->min, sta->max, 0.75 * num );
+    sta->sigma  = ( q3 - q1 ) / 1.349;
+
+//  Mean within 3 sigma of median, then mode estimate unless skewed by sources
+    lo  = sta->median - 3.0 * sta->sigma;
+    hi  = sta->median + 3.0 * sta->sigma;
+    num = 0.0;
+    for ( int b = lo > sta->min ? lo : sta->min; b <= hi && b <= sta->max; b++ )
+    {
+        num += img_hist[b];
+        sum += (double)img_hist[b] * b;
+    }
+    sta->bkg = sta->median;
+    if ( num > 0.0 && sta->sigma > 0.0 && fabs( sum / num - sta->median ) < 0.3 * sta->sigma )
+        sta->bkg = 2.5 * sta->median - 1.5 * sum / num;
+
+    memset( &img_hist[sta->min], 0, ( sta->max - sta->min + 1 ) * sizeof(uint32_t) );
+
+    return true;
+}
+
+
+/** @brief      Root of a component, halving the path on the way
+  *
+  * @param[in]  l = label
+  *
+  * @return     root label
+  */
+static int img_root( int l )
+{
+    while ( img_blob[l].root != l )
+        l = img_blob[l].root = img_blob[img_blob[l].root].root;
+
+    return l;
+}
+
+
+/** @brief      Join two components, the later root is folded into the earlier
+  *
+  * @param[in]  a = label
+  * @param[in]  b = label
+  *
+  * @return     root label of joined component
+  */
+static int img_join( int a, int b )
+{
+    img_blob_t *p, *q;
+
+    a = img_root( a );
+    b = img_root( b );
+    if ( a == b )
+        return a;
+    if ( b < a )
+    {
+        int t = a;
+        a = b;
+        b = t;
+    }
+
+    p = &img_blob[a];
+    q = &img_blob[b];
+    p->n   += q->n;
+    p->f   += q->f;
+    p->fx  += q->fx;
+    p->fy  += q->fy;
+    p->fxx += q->fxx;
+    p->fyy += q->fyy;
+    p->peak = q->peak > p->peak ? q->peak : p->peak;
+    q->root = a;
+
+    return a;
+}
+
+
+/** @brief      Find sources, brightest first. Threshold from the frame statistics
+  *
+  * @param[in]  *cam = pointer to camera info structure, configured
+  * @param[in]  *pix = Mono16 pixels
+  * @param[in]  *sta = statistics of this frame
+  * @param[out] *src = brightest sources, up to IMG_SRC_TOP
+  *
+  * @return      sources found
+  */
+int img_find( mop_cam_t *cam, AT_U8 *pix, img_sta_t *sta, img_src_t *src )
+{
+    const uint16_t *p;
+    size_t   w   = cam->Dimension[IMG_WIDTH];
+    size_t   h   = cam->Dimension[IMG_HEIGHT];
+    double   thr = sta->bkg + IMG_SRC_NSIG * fmax( sta->sigma, 1.0 );
+    uint16_t lim = thr < UINT16_MAX ? thr : UINT16_MAX;
+    int32_t *up, *row, *t;
+    int      num  = 1;
+    int      top  = 0;
+    int      lost = 0;
+    int      found = 0;
+    struct timespec beg;
+    struct timespec end;
+
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    if ( w + 2 > img_cap )
+    {
+        free( img_lab );
+        img_cap = 0;
+        if ( !( img_lab = calloc( 2 * ( w + 2 ), sizeof(int32_t) )))
+        {
+            mop_log( false, LOG_SYS, FAC, "calloc() %s. No sources", strerror(errno) );
+            return 0;
+        }
+        img_cap = w + 2;
+    }
+
+//  Rows padded by a column either side so neighbours never need a bounds check
+    up  = img_lab + 1;
+    row = img_lab + img_cap + 1;
+    memset( img_lab, 0, 2 * img_cap * sizeof(int32_t) );
+
+    for ( size_t y = 0; y < h; y++ )
+    {
+        uint16_t any = 0;
+
+        p = (uint16_t *)pix + y * w;
+        for ( size_t x = 0; x < w; x++ )
+            any |= p[x] > lim;
+
+        if ( !any )
+        {
+            memset( row, 0, w * sizeof(int32_t) );
+        }
+        else for ( size_t x = 0; x < w; x++ )
+        {
+            int    l = 0;
+            double f;
+
+            row[x] = 0;
+            if ( p[x] <= lim )
+                continue;
+
+            for ( int n = 0; n < 4; n++ )
+            {
+                int k = n ? up[x+n-2] : row[x-1]; // Left, then up-left, up and up-right
+                if ( k )
+                    l = l ? img_join( l, k ) : img_root( k );
+            }
+
+            if ( !l )
+            {
+                if ( num >= IMG_SRC_MAX )
+                {
+                    lost++;
+                    continue;
+                }
+                l = num++;
+                memset( &img_blob[l], 0, sizeof(img_blob_t) );
+                img_blob[l].root = l;
+            }
+
+            f = p[x] - sta->bkg;
+            img_blob[l].n++;
+            img_blob[l].f   += f;
+            img_blob[l].fx  += f * x;
+            img_blob[l].fy  += f * y;
+            img_blob[l].fxx += f * x * x;
+            img_blob[l].fyy += f * y * y;
+            if ( p[x] > img_blob[l].peak )
+                img_blob[l].peak = p[x];
+            row[x] = l;
+        }
+
+        t   = up;
+        up  = row;
+        row = t;
+    }
+
+//  Keep brightest, in flux order
+    for ( int l = 1; l < num; l++ )
+    {
+        img_blob_t *b = &img_blob[l];
+        img_src_t   s;
+        double      v;
+        int         i;
+
+        if ( b->root != l || b->n < IMG_SRC_NPIX || b->f <= 0.0 )
+            continue;
+
+        found++;
+        s.x    = b->fx / b->f;
+        s.y    = b->fy / b->f;
+        v      = 0.5 * ( b->fxx / b->f - s.x * s.x + b->fyy / b->f - s.y * s.y );
+        s.fwhm = 2.3548 * sqrt( fmax( v, 0.0 ));
+        s.flux = b->f;
+        s.npix = b->n;
+        s.peak = b->peak;
+        s.x   += 1.0;
+        s.y   += 1.0;
+
+        if ( top < IMG_SRC_TOP )
+            top++;
+        else if ( s.flux <= src[top-1].flux )
+            continue;
+        for ( i = top-1; i > 0 && src[i-1].flux < s.flux; i-- )
+            src[i] = src[i-1];
+        src[i] = s;
+    }
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    if ( lost )
+        mop_log( false, LOG_WRN, FAC, "Over %i components. %i pixels above %u ADU ignored", IMG_SRC_MAX, lost, lim );
+
+    mop_log( true, LOG_DBG, FAC, "%i sources above %u ADU in %.1fms", found, lim, 1000.0 * utl_ts_dif( &end, &beg ));
+
+    return found;
+}
+
+
+/** @brief      Frame notification for mopcmd. File name first so existing readers are unaffected.
+  *             Frames searched for sources add the brightest as SRC=x,y,flux,fwhm.
+  *             After a missed frame the run's gap count is added as GAPS=n
+  *
+  * @param[out] *buf  = message
+  * @param[in]   len  = message buffer size
+  * @param[in]  *name = FITS file name
+  * @param[in]  *cam  = pointer to camera info structure, statistics and sources of last frame
+  *
+  * @return      message length
+  */
+int img_note( char *buf, size_t len, char *name, mop_cam_t *cam )
+{
+    img_sta_t *sta = &cam->Sta;
+    int        n;
+
+    n = snprintf( buf, len, "%s MIN=%u MAX=%u MEAN=%.1f MED=%.0f BKG=%.1f SIG=%.1f SAT=%u",
+                  name, sta->min, sta->max, sta->mean, sta->median, sta->bkg, sta->sigma, sta->sat );
+
+    if ( cam->GapN > 0 )
+        n += snprintf( buf + n, len - n, " GAPS=%i", cam->GapN );
+
+    if ( !cam->Anchored )
+        n += snprintf( buf + n, len - n, " UNANCHORED" );
+
+    if ( cam->SrcN >= 0 )
+    {
+        n += snprintf( buf + n, len - n, " NSRC=%i", cam->SrcN );
+        for ( int i = 0; i < cam->SrcN && i < IMG_SRC_TOP; i++ )
+            n += snprintf( buf + n, len - n, " SRC=%.2f,%.2f,%.0f,%.2f",
+                           cam->Src[i].x, cam->Src[i].y, cam->Src[i].flux, cam->Src[i].fwhm );
+    }
+
+    return n;
+}
@@ -0,0 +1,366 @@
+/** @file   mop_lib.c
+  *
+  * @brief MOPTOP master bias and dark library
+  *
+  *        Bias (-xb) and dark (-xd) runs are combined into master frames as they are acquired.
+  *        Frames are spread over LIB_GRP group means, and at the end of the run each pixel is the median
+  *        of those means. This rejects cosmic rays without holding every frame in memory.
+  *        Masters are cached in memory and on disk, keyed by camera serial number, binning, window,
+  *        encoding, amplifier, read rate and target temperature, plus exposure for darks.
+  *        With -B1, other frames are written as float32 electrons. A dark matching the exposure is
+  *        subtracted if one exists, otherwise a bias. Each dark includes its bias.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#include "mopnet.h"
+#define FAC FAC_LIB
+
+/// Cached master frame
+typedef struct lib_ent_s
+{
+    char     key[MAX_STR];     //!< Configuration key, also the file name body
+    float   *pix;              //!< Master pixels [ADU]. NULL = Not available
+    size_t   num;              //!< Pixel count
+    uint64_t used;             //!< Last use, least recently used is replaced
+} lib_ent_t;
+
+static lib_ent_t lib_ent[LIB_MAX];
+static uint64_t  lib_use = 0;
+
+static float    *lib_grp[LIB_GRP]; // Group sums while building
+static size_t    lib_cap = 0;      // Group allocation [pixels]
+static int       lib_n   = 0;      // Frames added
+static char      lib_typ = 0;      // Type being built. 0 = Not building
+static float    *lib_out = NULL;   // Calibrated output
+static size_t    lib_max = 0;      // Output allocation [pixels]
+static char      lib_miss[MAX_STR];// Last key reported missing
+
+/** @brief      Add Mono16 pixels to a float accumulator
+  *
+  * @param[out] *acc = accumulator
+  * @param[in]  *pix = Mono16 pixels
+  * @param[in]   n   = pixel count
+  */
+static void lib_sum16( float *restrict acc, const uint16_t *restrict pix, size_t n )
+{
+    float          *a = __builtin_assume_aligned( acc, 16 );
+    const uint16_t *p = __builtin_assume_aligned( pix, 16 );
+
+    for ( size_t i = 0; i < n; i++ )
+        a[i] += p[i];
+}
+
+
+/** @brief      Subtract master and convert to electrons
+  *
+  * @param[out] *out  = electrons
+  * @param[in]  *pix  = Mono16 pixels
+  * @param[in]  *ref  = master [ADU]
+  * @param[in]   n    = pixel count
+  * @param[in]   gain = [e/ADU]
+  */
+static void lib_elec( float *restrict out, const uint16_t *restrict pix, const float *restrict ref, size_t n, float gain )
+{
+    float          *o = __builtin_assume_aligned( out, 16 );
+    const uint16_t *p = __builtin_assume_aligned( pix, 16 );
+    const float    *r = __builtin_assume_aligned( ref, 16 );
+
+    for ( size_t i = 0; i < n; i++ )
+        o[i] = ( p[i] - r[i] ) * gain;
+}
+
+
+/** @brief      Sort arrays element-wise with an odd-even transposition network.
+  *             Each compare-exchange is a min/max over whole arrays so vectorises.
+  *
+  * @param[in,out] **v = arrays
+  * @param[in]       g = number of arrays
+  * @param[in]       n = elements per array
+  */
+static void lib_sort( float **v, int g, size_t n )
+{
+    for ( int pass = 0; pass < g; pass++ )
+        for ( int j = pass & 1; j + 1 < g; j += 2 )
+        {
+            float *restrict a = v[j];
+            float *restrict b = v[j+1];
+
+            for ( size_t i = 0; i < n; i++ )
+            {
+                float lo = fminf( a[i], b[i] );
+                float hi = fmaxf( a[i], b[i] );
+                a[i] = lo;
+                b[i] = hi;
+            }
+        }
+}
+
+
+/** @brief      Build library key for the current configuration. Only filename-safe characters kept
+  *
+  * @param[in]  *cam = pointer to camera info structure, configured
+  * @param[in]   typ = FTS_PFX_BIAS | FTS_PFX_DARK
+  * @param[out] *key = key
+  */
+static void lib_key( mop_cam_t *cam, char typ, char *key )
+{
+    char  raw[MAX_STR];
+    char *k = key;
+    int   len;
+
+    len = snprintf( raw, sizeof(raw), "%ls_%c_b%i_%lldx%lld+%lld+%lld_%ls_%ls_%ls_t%+.0f",
+                    cam->SerialNumber, typ, img_bin, cam->AOIWidth, cam->AOIHeight, cam->AOILeft-1, cam->AOITop-1,
+                    cam_enc, cam_amp, cam_mhz, cam_temp );
+    if ( typ == FTS_PFX_DARK )
+        snprintf( raw + len, sizeof(raw) - len, "_e%.4f", cam->ExpVal );
+
+    for ( char *r = raw; *r; r++ )
+        if ( isalnum( *r ) || strchr( "+-._", *r ))
+            *k++ = *r;
+    *k = '\0';
+}
+
+
+/** @brief      Cache entry for a key. Existing one, else the least recently used is emptied for it
+  *
+  * @param[in]  *key = configuration key
+  * @param[out] *hit = true if already cached, even as a miss
+  *
+  * @return      entry
+  */
+static lib_ent_t *lib_slot( char *key, bool *hit )
+{
+    lib_ent_t *e = &lib_ent[0];
+
+    for ( int i = 0; i < LIB_MAX; i++ )
+    {
+        if ( !strcmp( lib_ent[i].key, key ))
+        {
+            *hit = true;
+            lib_ent[i].used = ++lib_use;
+            return &lib_ent[i];
+        }
+        if ( lib_ent[i].used < e->used )
+            e = &lib_ent[i];
+    }
+
+    *hit = false;
+    free( e->pix );
+    e->pix  = NULL;
+    e->num  = img_mono16size;
+    e->used = ++lib_use;
+    strcpy( e->key, key );
+
+    return e;
+}
+
+
+/** @brief      Find a master in memory, else load from disk. Misses are cached too.
+  *
+  * @param[in] *cam = pointer to camera info structure, configured
+  * @param[in]  typ = FTS_PFX_BIAS | FTS_PFX_DARK
+  *
+  * @return     entry | NULL = No master
+  */
+static lib_ent_t *lib_get( mop_cam_t *cam, char typ )
+{
+    char       key[MAX_STR];
+    char       name[MAX_STR];
+    lib_ent_t *e;
+    long       dim[IMG_DIMENSIONS] = {0};
+    bool       hit;
+    int        stat = 0;
+    int        nul;
+    fitsfile  *fp;
+
+    lib_key( cam, typ, key );
+    e = lib_slot( key, &hit );
+    if ( hit )
+        return e->pix ? e : NULL;
+
+    snprintf( name, sizeof(name), LIB_FILE, key );
+    if ( fits_open_file( &fp, name, READONLY, &stat ))
+    {
+        mop_log( false, LOG_DBG, FAC, "No master %s", name );
+        return NULL;
+    }
+
+    fits_get_img_size( fp, IMG_DIMENSIONS, dim, &stat );
+    if ( !stat && dim[IMG_WIDTH] * dim[IMG_HEIGHT] == e->num && ( e->pix = aligned_alloc( 16, e->num * sizeof(float) )))
+        fits_read_img( fp, TFLOAT, 1, e->num, NULL, e->pix, &nul, &stat );
+    fits_close_file( fp, &stat );
+
+    if ( stat || !e->pix )
+    {
+        free( e->pix );
+        e->pix = NULL;
+        mop_log( false, LOG_WRN, FAC, "Master %s unreadable or wrong size", name );
+        return NULL;
+    }
+
+    mop_log( true, LOG_INF, FAC, "Loaded master %s", name );
+    return e;
+}
+
+
+/** @brief      Start building a master if this is a bias or dark run. Allocation only grows
+  *
+  * @param[in] *cam = pointer to camera info structure, configured
+  *
+  * @return     true | false = Success | Failure
+  */
+bool lib_init( mop_cam_t *cam )
+{
+    lib_typ = 0;
+    lib_n   = 0;
+    if ( fts_pfx != FTS_PFX_BIAS && fts_pfx != FTS_PFX_DARK )
+        return true;
+
+    if ( img_mono16size > lib_cap )
+    {
+        lib_cap = 0;
+        for ( int g = 0; g < LIB_GRP; g++ )
+        {
+            free( lib_grp[g] );
+            lib_grp[g] = NULL;
+        }
+        for ( int g = 0; g < LIB_GRP; g++ )
+            if ( !( lib_grp[g] = aligned_alloc( 16, img_mono16size * sizeof(float) )))
+                return mop_log( false, LOG_SYS, FAC, "aligned_alloc() %s. Master not built", strerror(errno) );
+        lib_cap = img_mono16size;
+    }
+
+    for ( int g = 0; g < LIB_GRP; g++ )
+        memset( lib_grp[g], 0, img_mono16size * sizeof(float) );
+    lib_typ = fts_pfx;
+
+    return true;
+}
+
+
+/** @brief      Add a bias or dark frame to the master being built
+  *
+  * @param[in] *pix = Mono16 pixels
+  *
+  * @return     true
+  */
+bool lib_add( AT_U8 *pix )
+{
+    if ( lib_typ )
+        lib_sum16( lib_grp[ lib_n++ % LIB_GRP ], (uint16_t *)pix, img_mono16size );
+
+    return true;
+}
+
+
+/** @brief      Combine, cache and save the master at the end of a bias or dark run
+  *
+  * @param[in] *cam = pointer to camera info structure
+  *
+  * @return     true | false = Success | Failure
+  */
+bool lib_done( mop_cam_t *cam )
+{
+    char       name[MAX_STR];
+    char       text[80];
+    lib_ent_t *e;
+    int        g = lib_n < LIB_GRP ? lib_n : LIB_GRP;
+    int        stat = 0;
+    int        typ  = lib_typ;
+    bool       hit;
+    fitsfile  *fp;
+
+    if ( !lib_typ )
+        return true;
+    lib_typ = 0;
+    if ( !lib_n )
+        return mop_log( false, LOG_WRN, FAC, "No frames. Master not built" );
+
+//  Group means, then median of means per pixel
+    for ( int j = 0; j < g; j++ )
+    {
+        float k = 1.0f / ( lib_n / LIB_GRP + ( j < lib_n % LIB_GRP ));
+        for ( size_t i = 0; i < img_mono16size; i++ )
+            lib_grp[j][i] *= k;
+    }
+    lib_sort( lib_grp, g, img_mono16size );
+    if ( !( g & 1 ))
+        for ( size_t i = 0; i < img_mono16size; i++ )
+            lib_grp[g/2][i] = 0.5f * ( lib_grp[g/2-1][i] + lib_grp[g/2][i] );
+
+//  Cache, replacing any older master for this key 
+    lib_key( cam, typ, name );
+    e = lib_slot( name, &hit );
+    free( e->pix );
+    if ( !( e->pix = aligned_alloc( 16, img_mono16size * sizeof(float) )))
+        return mop_log( false, LOG_SYS, FAC, "aligned_alloc() %s", strerror(errno) );
+    memcpy( e->pix, lib_grp[g/2], img_mono16size * sizeof(float) );
+    e->num = img_mono16size;
+    if ( typ == FTS_PFX_DARK )
+        bpm_make( cam, e->pix );
+
+//  Save, overwriting any older master
+    snprintf( name, sizeof(name), "!"LIB_FILE, e->key );
+    fits_create_file( &fp, name, &stat );
+    fits_create_img ( fp, FLOAT_IMG, IMG_DIMENSIONS, cam->Dimension, &stat );
+    fits_write_key  ( fp, TSTRING, "OBSTYPE ", typ == FTS_PFX_BIAS ? "MASTER-BIAS" : "MASTER-DARK", "", &stat );
+    fits_write_key  ( fp, TINT   , "NCOMBINE", &lib_n       , "Frames combined"                   , &stat );
+    fits_write_key  ( fp, TINT   , "NGROUPS ", &g           , "Median of this many group means"   , &stat );
+    fits_write_key  ( fp, TINT   , "RUN     ", &fts_run     , "Source run number"                 , &stat );
+    fits_write_key  ( fp, TDOUBLE, "EXPTIME ", &cam->ExpVal , "[sec] Exposure per frame"          , &stat );
+    fits_write_key  ( fp, TDOUBLE, "TEMPSET ", &cam_temp    , "[C] Target sensor temperature"     , &stat );
+    fits_write_img  ( fp, TFLOAT , 1, e->num, e->pix, &stat );
+    fits_close_file ( fp, &stat );
+    if ( stat )
+    {
+        fits_get_errstatus( stat, text );
+        return mop_log( false, LOG_ERR, FAC, "Master %s status=%i=%s. Cached in memory only", name+1, stat, text );
+    }
+
+    return mop_log( true, LOG_INF, FAC, "Master %s from %i frames", name+1, lib_n );
+}
+
+
+/** @brief      Calibrate a frame to electrons using the matching master
+  *
+  * @param[in]  *cam = pointer to camera info structure, configured
+  * @param[in]  *pix = Mono16 pixels
+  * @param[out] *ref = key of master used
+  *
+  * @return     electrons | NULL = No master or bias/dark run, write raw
+  */
+float *lib_apply( mop_cam_t *cam, AT_U8 *pix, char *ref )
+{
+    lib_ent_t *e;
+
+    if ( fts_pfx == FTS_PFX_BIAS || fts_pfx == FTS_PFX_DARK )
+        return NULL;
+
+    if ( !( e = lib_get( cam, FTS_PFX_DARK )) && !( e = lib_get( cam, FTS_PFX_BIAS )))
+    {
+        lib_key( cam, FTS_PFX_BIAS, ref );
+        if ( strcmp( ref, lib_miss ))
+            mop_log( false, LOG_WRN, FAC, "No master dark or bias for %s. Writing ADU", strcpy( lib_miss, ref ));
+        return NULL;
+    }
+
+    if ( img_mono16size > lib_max )
+    {
+        free( lib_out );
+        lib_max = 0;
+        if ( !( lib_out = aligned_alloc( 16, img_mono16size * sizeof(float) )))
+        {
+            mop_log( false, LOG_SYS, FAC, "aligned_alloc() %s. Writing ADU", strerror(errno) );
+            return NULL;
+        }
+        lib_max = img_mono16size;
+    }
+
+    lib_elec( lib_out, (uint16_t *)pix, e->pix, img_mono16size, cam->Gain );
+    strcpy( ref, e->key );
+
+    return lib_out;
+}
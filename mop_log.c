@@ -26,6 +26,7 @@ bool mop_log( bool ret, int level, int fac, char *fmt, ... )
     char    sec[16]; // Fractional seconds, 0.nnn 
 
     struct timeval t; 
+    struct tm      tim;
 
 //  Only output messages for current log level    
     if ((log_level < 0 && abs(log_level) == fac)||  // -ve == Facility
@@ -46,7 +47,7 @@ bool mop_log( bool ret, int level, int fac, char *fmt, ... )
             fprintf( log_fp, "%s", log_colour[ level ] );
 
 //      Create timestamp string
-	strftime( dtm, sizeof(dtm)-1, "%Y-%m-%dT%H:%M:%S", localtime(&t.tv_sec));
+	strftime( dtm, sizeof(dtm)-1, "%Y-%m-%dT%H:%M:%S", localtime_r( &t.tv_sec, &tim ));
         snprintf( sec, sizeof(sec)-1, "%2.3f", t.tv_usec/TIM_MICROSECOND );
 
 //      Print log line
@@ -13,6 +13,106 @@
 static int                 skt_fd;   // Local UDP socket 
 static struct sockaddr_in  skt_adr;  // Local UDP address 
 
+// Queue of RUN requests received while busy or from a sequence
+static msg_run_t msg_que[MSG_QUEUE]; 
+static msg_run_t msg_cur;          // Run most recently taken from queue
+static int  msg_que_beg = 0;       // Oldest entry
+static int  msg_que_num = 0;       // Number of entries
+static pthread_mutex_t msg_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/// ACK or NAK reply
+#define msg_rpl( msg ) ( msg_chk( msg, MSG_ACK, strlen(MSG_ACK) ) || msg_chk( msg, MSG_NAK, strlen(MSG_NAK) ) )
+
+/// Message read by a process or thread not waiting for it, held until its waiter takes it
+typedef struct msg_held_s
+{
+    char               msg[MSG_LEN]; //!< Message. Empty = Free 
+    struct sockaddr_in adr;          //!< Sender, for the waiter's ACK
+    socklen_t          len;
+    struct timespec    when;         //!< Time held, oldest is replaced when full
+} msg_held_t;
+
+static msg_held_t msg_held[MSG_HOLD];
+static pthread_mutex_t msg_hmtx = PTHREAD_MUTEX_INITIALIZER;
+
+
+/** @brief       Hold a message that is not a queue control message for a later msg_take().
+  *              Master handshake and main threads share the socket so either may read the other's message. 
+  *              Oldest held message is dropped if full. Held ACK/NAK replies are dropped after TMO_ACK,
+  *              anything else after TMO_TOK.
+  *  
+  * @param[in]  *msg = received message 
+  * @param[in]  *adr = sender address 
+  * @param[in]   len = sender address length 
+  *
+  * @return      true 
+  */
+static bool msg_hold( char *msg, struct sockaddr_in *adr, socklen_t len )
+{
+    msg_held_t *h = &msg_held[0];
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    pthread_mutex_lock( &msg_hmtx );
+    for ( int i = 0; i < MSG_HOLD; i++ )
+    {
+        if ( *msg_held[i].msg && utl_ts_dif( &now, &msg_held[i].when ) > ( msg_rpl( msg_held[i].msg ) ? TMO_ACK : TMO_TOK ))
+            *msg_held[i].msg = '\0';
+        if ( !*msg_held[i].msg || ( *h->msg && utl_ts_dif( &h->when, &msg_held[i].when ) > 0.0 ))
+            h = &msg_held[i];
+    }
+    if ( *h->msg )
+        mop_log( false, LOG_WRN, FAC, "Held messages full. Dropped %s", h->msg ); 
+
+    strncpy( h->msg, msg, MSG_LEN-1 );
+    h->adr  = *adr;
+    h->len  = len;
+    h->when = now;
+    pthread_mutex_unlock( &msg_hmtx );
+
+    return mop_log( true, LOG_DBG, FAC, "Held %s", msg ); 
+}
+
+
+/** @brief       Take the oldest held message matching an expected message, optionally from one sender
+  *  
+  * @param[in]  *exp    = expected message 
+  * @param[in]   explen = expected message length  
+  * @param[in]  *from   = sender (NULL=any) 
+  * @param[in]  *since  = only if held at or after this time, e.g. a reply to a send (NULL=any) 
+  * @param[out] *msg    = message taken 
+  * @param[in]   max    = message buffer size
+  * @param[out] *adr    = sender address 
+  * @param[out] *len    = sender address length 
+  *
+  * @return      true | false = Taken | None held 
+  */
+static bool msg_take( char *exp, int explen, struct sockaddr_in *from, struct timespec *since,
+                      char *msg, int max, struct sockaddr_in *adr, socklen_t *len )
+{
+    msg_held_t *h = NULL;
+
+    pthread_mutex_lock( &msg_hmtx );
+    for ( int i = 0; i < MSG_HOLD; i++ )
+        if ( *msg_held[i].msg && msg_chk( msg_held[i].msg, exp, explen ) &&
+             ( !from || ( from->sin_port        == msg_held[i].adr.sin_port        &&
+                          from->sin_addr.s_addr == msg_held[i].adr.sin_addr.s_addr   )) &&
+             ( !since || utl_ts_dif( &msg_held[i].when, since ) >= 0.0 ) &&
+             ( !h || utl_ts_dif( &h->when, &msg_held[i].when ) > 0.0 ))
+            h = &msg_held[i];
+
+    if ( h )
+    {
+        snprintf( msg, max, "%s", h->msg );
+        *adr = h->adr;
+        *len = h->len;
+        *h->msg = '\0';
+    }
+    pthread_mutex_unlock( &msg_hmtx );
+
+    return h && mop_log( true, LOG_INF, FAC, "Received %s (held)", msg );
+}
+
 
 /** @brief       Convert IP:port text into a socket address structure
   *  
@@ -91,14 +191,22 @@ bool msg_recv( int timeout, char *msg, int max, int *len, char *exp, int explen
     if ( setsockopt( skt_fd, SOL_SOCKET, SO_RCVTIMEO, &tmo, sizeof(tmo)) < 0 ) 
         return mop_log( false, LOG_SYS, FAC, "setsockopt() %s", strerror(errno) ); 
 
-//    *len = recvfrom( skt_fd, msg, max, MSG_WAITALL, (struct sockaddr *)&adr_rcv, &len_rcv ); 
-    *len = recvfrom( skt_fd, msg, max, 0, (struct sockaddr *)&adr_rcv, &len_rcv ); 
-    if ( *len < 0 )
-        mop_log( false, LOG_WRN, FAC, "recvfrom() timeout" ); 
+//  Expected message may already have been read and held 
+    if ( exp && msg_take( exp, explen, NULL, NULL, msg, max, &adr_rcv, &len_rcv ) )
+    {
+        *len = strlen( msg );
+    }
+    else
+    {
+//      *len = recvfrom( skt_fd, msg, max, MSG_WAITALL, (struct sockaddr *)&adr_rcv, &len_rcv ); 
+        *len = recvfrom( skt_fd, msg, max, 0, (struct sockaddr *)&adr_rcv, &len_rcv ); 
+        if ( *len < 0 )
+            return mop_log( false, LOG_WRN, FAC, "recvfrom() timeout" ); 
 
-//  Got something so nul terminate and check   
-    msg[*len] = '\0'; 
-    mop_log( true, LOG_INF, FAC, "Received %s", msg ); 
+//      Got something so nul terminate and check   
+        msg[*len] = '\0'; 
+        mop_log( true, LOG_INF, FAC, "Received %s", msg ); 
+    }
 
     if ( exp )
     {
@@ -159,6 +267,8 @@ bool msg_send( int timeout, char *send, char *dst, char *exp, int exp_len )
                 return mop_log( false, LOG_ERR, FAC, "net_send(%s)", send ); 
         }
     }
+
+    return true;
 } 
 
  
@@ -174,3 +284,446 @@ bool msg_chk( char *msg, char *exp, int explen )
 {
    return !strncmp( msg, exp, explen );
 }
+
+
+/** @brief       Add a run to the end of the RUN queue 
+  *  
+  * @param[in]  *run = RUN message for this run 
+  * @param[in]   pos = position within sequence, 1 to num. 0 = not a sequence 
+  * @param[in]   num = number of runs in sequence 
+  * @param[in]  *seq = whole SEQ message, only used when pos=1 
+  *
+  * @return      true | false = Success | Queue full  
+  */
+bool msg_push( char *run, int pos, int num, char *seq )
+{
+    msg_run_t *que;
+
+    pthread_mutex_lock( &msg_mtx );
+    if ( msg_que_num >= MSG_QUEUE )
+    {
+        pthread_mutex_unlock( &msg_mtx );
+        return mop_log( false, LOG_WRN, FAC, "RUN queue full (%i)", MSG_QUEUE ); 
+    }
+
+    que = &msg_que[ (msg_que_beg + msg_que_num++) % MSG_QUEUE ];
+    strncpy( que->run, run, MSG_LEN-1 );
+    strncpy( que->seq, pos == 1 ? seq : "", MSG_SEQ-1 );
+    que->pos = pos;
+    que->num = num;
+    pthread_mutex_unlock( &msg_mtx );
+
+    return mop_log( true, LOG_INF, FAC, "Queued %i %s", msg_que_num, run );
+}
+
+
+/** @brief       Remove the oldest run from the RUN queue 
+  *  
+  * @param[out] *run = run taken from queue 
+  *
+  * @return      true | false = Success | Queue empty  
+  */
+bool msg_pop( msg_run_t *run )
+{
+    pthread_mutex_lock( &msg_mtx );
+    if ( !msg_que_num )
+    {
+        pthread_mutex_unlock( &msg_mtx );
+        return false;
+    }
+
+    *run = msg_cur = msg_que[ msg_que_beg ];
+    msg_que_beg = ( msg_que_beg + 1 ) % MSG_QUEUE;
+    msg_que_num--;
+    pthread_mutex_unlock( &msg_mtx );
+
+    return true;
+}
+
+
+/** @brief       Number of runs waiting in the RUN queue 
+  *  
+  * @return      Queue length 
+  */
+int msg_queued( void )
+{
+    return msg_que_num;
+}
+
+
+/** @brief       Discard all queued runs  
+  *  
+  * @return      true 
+  */
+bool msg_clear( void )
+{
+    pthread_mutex_lock( &msg_mtx );
+    msg_que_num = 0;
+    pthread_mutex_unlock( &msg_mtx );
+
+    return mop_log( true, LOG_WRN, FAC, "RUN queue cleared" );
+}
+
+
+/** @brief       Split a SEQ message into runs and queue them. All or nothing. 
+  *
+  *              Format is SEQ <run 1 options>;<run 2 options>; ... 
+  *              The first run holds the whole sequence so the master can forward it to the slave.
+  *  
+  * @param[in]  *seq = SEQ message  
+  *
+  * @return      true | false = Success | Failure  
+  */
+static bool msg_seq( char *seq )
+{
+    char  cpy[MSG_SEQ]; 
+    char  nrm[MSG_SEQ]; // Normalised sequence with empty entries removed 
+    char  run[MSG_LEN]; 
+    char *opt[MSG_QUEUE]; 
+    char *ptr;
+    int   num = 0;
+    int   len = 0;
+
+//  Split into options for each run, skipping empty entries 
+    strncpy( cpy, seq + strlen(MSG_SEQ_T), sizeof(cpy)-1 );
+    for ( ptr = strtok( cpy, ";" ); ptr; ptr = strtok( NULL, ";" ) )
+    {
+        while ( isspace( *ptr ) )
+            ptr++;
+        if ( !*ptr )
+            continue;
+        if ( num >= MSG_QUEUE )
+            return mop_log( false, LOG_ERR, FAC, "Sequence too long. Max. %i runs", MSG_QUEUE );
+        opt[num++] = ptr;
+        len += snprintf( nrm + len, sizeof(nrm) - len, "%s%s", num > 1 ? ";" : MSG_SEQ_T" ", ptr );
+    }
+
+    if ( !num ) 
+        return mop_log( false, LOG_ERR, FAC, "Empty sequence" );
+    if ( MSG_QUEUE - msg_que_num < num ) 
+        return mop_log( false, LOG_ERR, FAC, "Sequence of %i runs will not fit in RUN queue", num );
+
+    for ( int i = 0; i < num; i++ )
+    {
+        snprintf( run, sizeof(run), MSG_RUN" %s", opt[i] );
+        msg_push( run, i+1, num, nrm );
+    }
+
+    return mop_log( true, LOG_INF, FAC, "Sequence of %i runs queued", num );
+}
+
+
+/** @brief       Reply to a queue query. Lists the current run and queued runs 
+  *  
+  * @param[in]  *adr = address to reply to 
+  * @param[in]   len = address length 
+  *
+  * @return      true | false = Success | Failure  
+  */
+static bool msg_qry( struct sockaddr_in *adr, socklen_t len )
+{
+    char  rep[MSG_SEQ];
+    char *ptr = rep;
+    char *end = rep + sizeof(rep) - 1;
+    msg_run_t *que;
+
+    pthread_mutex_lock( &msg_mtx );
+    ptr += snprintf( ptr, end - ptr, "%s %i queued\nRunning: %s (%i/%i)", 
+                     MSG_QRY, msg_que_num, *msg_cur.run ? msg_cur.run : "<none>", msg_cur.pos, msg_cur.num ); 
+    for ( int i = 0; i < msg_que_num && ptr < end; i++ )
+    {
+        que  = &msg_que[ (msg_que_beg + i) % MSG_QUEUE ];
+        ptr += snprintf( ptr, end - ptr, "\n%2i: %s (%i/%i)", i+1, que->run, que->pos, que->num );
+    }
+    pthread_mutex_unlock( &msg_mtx );
+
+    if ( sendto( skt_fd, rep, strlen(rep), MSG_CONFIRM, (const struct sockaddr *)adr, len ) < 0) 
+        return mop_log( false, LOG_ERR, FAC, "sendto(%s) %s", MSG_QRY, strerror(errno)); 
+
+    return true;
+}
+
+
+/** @brief       Act on a consumed queue control message and reply to sender.
+  *
+  *              RUN and SEQ requests are ACKed and queued, QRY is answered and ABT clears the queue.
+  *              Anything else, e.g. a TOK arriving before the handshake waits for it or a reply read by the
+  *              other master thread, is held unanswered for its waiter, see msg_take(). Never answer a reply.
+  *  
+  * @param[in]  *msg = received message 
+  * @param[in]  *adr = sender address 
+  * @param[in]   len = sender address length 
+  *
+  * @return      true | false = Success | Failure 
+  */
+static bool msg_ctl( char *msg, struct sockaddr_in *adr, socklen_t len )
+{
+    char *ack;
+    struct sockaddr_in adr_slv; 
+
+    mop_log( true, LOG_INF, FAC, "Received %s", msg ); 
+    if ( msg_chk( msg, MSG_QRY, strlen(MSG_QRY) ) )
+    {
+        return msg_qry( adr, len );
+    }
+    else if ( msg_chk( msg, MSG_RUN, strlen(MSG_RUN) ) )
+    {
+        ack = msg_push( msg, 0, 0, NULL ) ? MSG_ACK : MSG_NAK;
+    }
+    else if ( msg_chk( msg, MSG_SEQ_T, strlen(MSG_SEQ_T) ) )
+    {
+        ack = msg_seq( msg ) ? MSG_ACK : MSG_NAK;
+    }
+    else if ( msg_chk( msg, MSG_ABT, strlen(MSG_ABT) ) )
+    {
+        msg_clear();
+        ack = MSG_ACK;
+
+//      Master passes abort onto slaves so they discard any sequence held   
+        for ( int i = 0; mop_master && !one_cam && i < mop_slaves; i++ )
+        {
+            adr_slv = msg_str2adr( ipslaves[i] );
+            sendto( skt_fd, MSG_ABT, strlen(MSG_ABT), MSG_DONTWAIT, (const struct sockaddr *)&adr_slv, sizeof(adr_slv) );
+        }
+    }
+    else
+    {
+        return msg_hold( msg, adr, len );
+    }
+
+    if ( sendto( skt_fd, ack, strlen(ack), MSG_CONFIRM, (const struct sockaddr *)adr, len ) < 0) 
+        return mop_log( false, LOG_ERR, FAC, "sendto(%s) %s", ack, strerror(errno)); 
+
+    return true;
+}
+
+
+/** @brief       Non-blocking handling of waiting queue control messages, see msg_ctl().
+  *
+  *              The expected message is left for a following msg_recv(). 
+  *  
+  * @param[in]  *exp    = expected message (NULL=none)
+  * @param[in]   explen = expected message length
+  *
+  * @return      true | false = Expected message is waiting | Not waiting 
+  */
+bool msg_poll( char *exp, int explen )
+{
+    char  msg[MSG_SEQ];
+    int   len;
+    struct sockaddr_in adr_rcv; 
+    socklen_t len_rcv; 
+
+    for(;;)
+    {
+//      Peek so that an expected message is not consumed
+        len_rcv = sizeof( adr_rcv ); 
+        if ( (len = recvfrom( skt_fd, msg, sizeof(msg)-1, MSG_DONTWAIT|MSG_PEEK, (struct sockaddr *)&adr_rcv, &len_rcv )) < 0 )
+            return false; 
+
+        msg[len] = '\0'; 
+        if ( exp && msg_chk( msg, exp, explen ) )
+            return true; 
+
+//      Consume and act on it 
+        recvfrom( skt_fd, msg, sizeof(msg)-1, MSG_DONTWAIT, (struct sockaddr *)&adr_rcv, &len_rcv ); 
+        if ( !msg_ctl( msg, &adr_rcv, len_rcv ) )
+            return false;
+    }
+}
+
+
+/** @brief       Fan a message out to a list of peers then collect one reply from each concurrently.
+  *
+  *              All sends go out before any reply is awaited so peers see the message together.
+  *              Replies are matched to peers by source address in whatever order they arrive. 
+  *              With no message to send, requests from the peers (e.g. TOK) are collected and ACKed,
+  *              including any that arrived early and were held by msg_ctl().
+  *              The socket is polled in MSG_SLICE steps to pick up messages held by another thread.
+  *              Queue control messages arriving meanwhile are handled as msg_poll().
+  *  
+  * @param[in]   timeout = timeout for all replies [sec], 0=Forever 
+  * @param[in]  *send    = message to send (NULL=collect only) 
+  * @param[in] **dst     = peer IP:port list 
+  * @param[in]   num     = number of peers 
+  * @param[in]  *exp     = reply expected 
+  * @param[in]   explen  = expected reply length  
+  * @param[out]  rep     = reply from each peer (NULL=not wanted) 
+  * @param[out] *lat     = latency of each peer's reply [sec], negative if none (NULL=not wanted) 
+  *
+  * @return      true | false = All peers replied as expected | Failure or timeout 
+  */
+bool msg_fan( int timeout, char *send, char **dst, int num, char *exp, int explen, char rep[][MSG_LEN], double *lat )
+{
+    char   msg[MSG_SEQ];
+    char  *ack;
+    int    len;
+    int    ms;
+    int    pend = num; // Peers yet to reply
+    bool   ret  = true;
+    bool   rpl;        // Message is a reply
+    bool   got[CAM_MAX] = {false};
+    struct sockaddr_in adr[CAM_MAX]; 
+    struct sockaddr_in adr_rcv; 
+    socklen_t          len_rcv; 
+    struct pollfd      pfd = { .fd = skt_fd, .events = POLLIN };
+    struct timespec    beg;
+    struct timespec    now;
+    int    i;
+    bool   held;       // Message was held by msg_ctl() 
+
+    if ( num > CAM_MAX )
+        return mop_log( false, LOG_ERR, FAC, "msg_fan() %i peers > %i", num, CAM_MAX ); 
+
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    for ( i = 0; i < num; i++ )
+    {
+        adr[i] = msg_str2adr( dst[i] );
+        if ( lat ) 
+            lat[i] = -1.0;
+        if ( send && sendto( skt_fd, send, strlen(send), MSG_DONTWAIT, (const struct sockaddr *)&adr[i], sizeof(adr[i]) ) < 0 )
+            ret = mop_log( false, LOG_ERR, FAC, "sendto(%s,%s) %s", dst[i], send, strerror(errno)); 
+    }
+
+    while ( pend )
+    {
+//      Take any reply to this send, or request if collecting, already held for a pending peer 
+        len_rcv = sizeof( adr_rcv ); 
+        for ( held = false, i = 0; !held && i < num; i++ )
+            held = !got[i] && ( send ? msg_take( MSG_ACK, strlen(MSG_ACK), &adr[i], &beg, msg, sizeof(msg), &adr_rcv, &len_rcv ) ||
+                                       msg_take( MSG_NAK, strlen(MSG_NAK), &adr[i], &beg, msg, sizeof(msg), &adr_rcv, &len_rcv )
+                                     : msg_take( exp,     explen,          &adr[i], NULL, msg, sizeof(msg), &adr_rcv, &len_rcv ));
+
+        if ( !held )
+        {
+            clock_gettime( CLOCK_MONOTONIC, &now );
+            ms = timeout ? TIM_TICK * timeout - TIM_MILLISECOND * utl_ts_dif( &now, &beg ) : MSG_SLICE;
+            if ( timeout && ms <= 0 )
+                break;
+            if ( poll( &pfd, 1, ms < MSG_SLICE ? ms : MSG_SLICE ) <= 0 )
+                continue;
+
+            if ( (len = recvfrom( skt_fd, msg, sizeof(msg)-1, MSG_DONTWAIT, (struct sockaddr *)&adr_rcv, &len_rcv )) < 0 )
+                continue; 
+            msg[len] = '\0'; 
+        }
+
+//      Find which peer this is from
+        for ( i = 0; i < num; i++ )
+            if ( !got[i] &&
+                 adr[i].sin_port        == adr_rcv.sin_port       &&
+                 adr[i].sin_addr.s_addr == adr_rcv.sin_addr.s_addr  )
+                break;
+
+//      Sending wants ACK/NAK replies, collecting wants requests. Anything else is a control message
+        rpl = msg_rpl( msg );
+        if ( i == num || rpl != ( send != NULL ) )
+        {
+            msg_ctl( msg, &adr_rcv, len_rcv );
+            continue;
+        }
+
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        got[i] = true;
+        pend--;
+        if ( lat )
+            lat[i] = utl_ts_dif( &now, &beg );
+        if ( rep )
+            strncpy( rep[i], msg, MSG_LEN-1 );
+
+        if ( !msg_chk( msg, exp, explen ) )
+            ret = mop_log( false, LOG_ERR, FAC, "%s replied %s. Expected %s", dst[i], msg, exp ); 
+        else
+            mop_log( true, LOG_INF, FAC, "Received %s from %s", msg, dst[i] ); 
+
+//      Collecting requests so acknowledge them
+        if ( !send )
+        {
+            ack = msg_chk( msg, exp, explen ) ? MSG_ACK : MSG_NAK;
+            sendto( skt_fd, ack, strlen(ack), MSG_CONFIRM, (const struct sockaddr *)&adr_rcv, len_rcv );
+        }
+    }
+
+    for ( i = 0; i < num; i++ )
+        if ( !got[i] )
+            ret = mop_log( false, LOG_WRN, FAC, "msg_fan(%s) no %s from %s", send ? send : "", exp, dst[i] ); 
+
+    return ret;
+}
+
+
+/** @brief       Block until a message arrives then handle queue control messages, see msg_poll() 
+  *  
+  * @param[in]   timeout = timeout [sec], 0=Forever
+  *
+  * @return      true | false = Message handled | Timeout 
+  */
+bool msg_idle( int timeout )
+{
+    struct pollfd pfd = { .fd = skt_fd, .events = POLLIN };
+
+    if ( poll( &pfd, 1, timeout ? TIM_TICK * timeout : -1 ) <= 0 )
+        return false;
+
+    msg_poll( NULL, 0 );
+
+    return true;
+}
+
+
+/** @brief       Receive an expected message while still handling queue control messages. 
+  *              Replaces msg_recv() where RUN, SEQ, QRY or ABT could arrive first.
+  *              The expected message is taken as read, not peeked, so another thread cannot consume it
+  *              in between. One already held by another thread is taken from msg_take() instead.
+  *  
+  * @param[in]   timeout = receive timeout [sec], 0=Forever 
+  * @param[in]  *msg     = buffer to hold received message 
+  * @param[in]   max     = maximum receive length  
+  * @param[in]  *len     = variable to hold actual length
+  * @param[in]  *exp     = expected message 
+  * @param[in]   explen  = expected message length  
+  *
+  * @return      true | false = Success | Failure  
+  */
+bool msg_wait( int timeout, char *msg, int max, int *len, char *exp, int explen )
+{
+    char   buf[MSG_SEQ];
+    int    ms;
+    struct sockaddr_in adr_rcv; 
+    socklen_t          len_rcv; 
+    struct pollfd      pfd = { .fd = skt_fd, .events = POLLIN };
+    struct timespec    beg;
+    struct timespec    now;
+
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    for(;;)
+    {
+        len_rcv = sizeof( adr_rcv ); 
+        if ( msg_take( exp, explen, NULL, NULL, buf, sizeof(buf), &adr_rcv, &len_rcv ) )
+            break;
+
+        if ( ( *len = recvfrom( skt_fd, buf, sizeof(buf)-1, MSG_DONTWAIT, (struct sockaddr *)&adr_rcv, &len_rcv )) >= 0 )
+        {
+            buf[*len] = '\0'; 
+            if ( msg_chk( buf, exp, explen ) )
+            {
+                mop_log( true, LOG_INF, FAC, "Received %s", buf ); 
+                break;
+            }
+            msg_ctl( buf, &adr_rcv, len_rcv );
+            continue;
+        }
+
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        ms = timeout ? TIM_TICK * timeout - TIM_MILLISECOND * utl_ts_dif( &now, &beg ) : MSG_SLICE;
+        if ( timeout && ms <= 0 )
+            return mop_log( false, LOG_WRN, FAC, "msg_wait(%s) timeout", exp ); 
+        poll( &pfd, 1, ms < MSG_SLICE ? ms : MSG_SLICE );
+    }
+
+    *len = snprintf( msg, max, "%s", buf );
+    if ( sendto( skt_fd, MSG_ACK, strlen(MSG_ACK), MSG_CONFIRM, (const struct sockaddr *)&adr_rcv, len_rcv ) < 0) 
+        return mop_log( false, LOG_ERR, FAC, "sendto(%s) %s", MSG_ACK, strerror(errno)); 
+
+    return true;
+}
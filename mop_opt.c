@@ -10,6 +10,8 @@
 #include "mopnet.h"
 #define FAC FAC_OPT
 
+static char opt_slaves[MAX_STR]; // Copy of -S list. ipslaves[] point into it
+
 /** @brief     Graceful exit 
   *
   * @param[in] code = exit code to be returned by process to shell 
@@ -19,6 +21,7 @@
 void mop_exit( int code  )
 {
     cam_close( &mop_cam ); // Tidy-up camera settings
+    shm_exit();            // Remove frame ring
     exit( code );
 }
 
@@ -56,6 +59,7 @@ bool mop_init( void )
         rot_final = img_total * rot_stp - ROT_TOLERANCE; // Avoid trigger overrun by stopping short 
     else if ( rot_sign == ROT_CCW )
         rot_final = img_total * rot_stp + ROT_TOLERANCE; // Avoid trigger overrun by stopping short 
+    rot_last = rot_zero + ROT_TRG_OFF + ( img_total - 1 ) * rot_stp;
 
 //  Approx. guess, more accurate later after reading camera data
 //  cam_exp = fabs((rot_stp / rot_vel));
@@ -81,20 +85,33 @@ void prn_opt( void )
         printf("  -e  Exposure time                 [% 6.3f sec     ]\n",cam_exp );
     printf("  -x  eXosure type   <b,d,e,f,q,s>  [     %c         ]\n" , fts_pfx  );
     printf("  -b  Binning        <1,2,3,4,8>    [   %ls         ]\n"  , cam_bin  );
+    if ( img_aoi_w )
+        printf("  -g  window WxH[+X+Y], 0=Full      [ %ix%i%s ]\n"         , img_aoi_w, img_aoi_h, img_aoi_x < 0 ? " centred" : "" );
+    else
+        printf("  -g  window WxH[+X+Y], 0=Full      [     0         ]\n"                               );
     printf("  -f  read Freq.     <100,270>      [   %ls     ]\n"      , cam_mhz  );
     printf("  -m  Mode amp. gain <12H,12L,16L>  [   %ls ]\n"          , cam_amp  );
     printf("  -p  Pixel encoding <12,12PACK,16> [   %ls      ]\n"     , cam_enc  );
-    printf("  -n  Images per rev <8,16>         [% 6i         ]\n"    , img_cycle);
+    printf("  -Y  fastest cached mode <12,16[,noise e]> 0=Off [ %i ]\n", cam_bits );
+    printf("  -n  Images per rev <8,16,32,...>  [% 6i         ]\n"    , img_cycle);
+    printf("  -z  co-add revs per position <0,1>[ %5.5s         ]\n"  , btoa(img_stk));
+    printf("  -B  calibrated electrons <0,1>    [ %5.5s         ]\n"  , btoa(fts_elec));
+    printf("  -I  bad pixels <0=raw,1=DQ,2=fix> [     %i         ]\n"  , fts_bpm  );
+    printf("  -T  -xq auto-exp. peak, 0=off     [ %5.2f         ]\n"  , aex_peak);
+    printf("  -J  focus sweep <f1,f2,...>       [ %-13.13s ]\n"  , foc_list ? foc_list : "None" );
     printf("  -o  read Order   <BUSEQ, BUSIM,   [   %ls ]\n"          , cam_rd   );
     printf("      COSIM, OISIM, TDSEQ, TDSIM>\n"                                 );
     printf("  -r  rotator Revolutions           [% 6i         ]\n"    , rot_revs );
     printf("  -v  rotator Velocity <+ve,0,-ve>  [% 6.1f deg/sec ]\n"  , rot_vel  );
+    printf("  -y  step period, -v0 <0=lock-step,-1=auto> [% 2.3f s ]\n", cam_stp  );
     printf("  -u  rotator USB device            [ %s  ]\n"            , rot_usb  );
     printf("  -t  target Temperature            [ <% 2.1f C       ]\n", cam_temp );
     printf("  -q  Quick start <0=false,1=true>  [ %5.5s         ]\n"  , btoa(cam_quick));
-    printf("  -c  Camera <1=Master, 2=Slave>    [     %i         ]\n" , cam_num+1);
+    printf("  -c  Camera <1=Master, 2-%i=Slave>  [     %i         ]\n" , CAM_MAX, cam_num+1);
     printf("  -M  Master IP:port                [ %s ]\n"             , ipmaster );
-    printf("  -S  Slave  IP:port                [ %s ]\n"             , ipslave  );
+    printf("  -S  Slave  IP:port[,IP:port...]   [ %s ]\n"             , ipslave  );
+    for ( int i = 1; i < mop_slaves; i++ )
+        printf("                                    [ %s ]\n"             , ipslaves[i] );
     printf("  -W  Write destination             [    %s/         ]\n" , fts_dir  );
     printf("  -w  filter Wheel position <1-5>   [    %i          ]\n" , whl_pos  );
     printf("     <1=%s, 2=%s, 3=%s, 4=%s, 5=%s>\n",
@@ -111,16 +128,24 @@ void prn_opt( void )
     puts("Dbg:");
     printf("  -d  Debug  +ve=Level, -ve=Module  [     %i         ]\n" 
            "     < %i=CRIT %i=SYS  %i=ERR  %i=WRN  %i=IMG  %i=INF  %i=MSG  %i=DBG>  %i=NONE\n"
-           "      -%i=MOP -%i=LOG -%i=UTL -%i=OPT -%i=CAM -%i=ROT -%i=FTS -%i=MSG> -%i=WHL >\n",
+           "      -%i=MOP -%i=LOG -%i=UTL -%i=OPT -%i=CAM -%i=ROT -%i=FTS -%i=MSG> -%i=WHL -%i=SHM -%i=XFR -%i=CAL -%i=STK -%i=POL -%i=LIB -%i=IMG -%i=AEX -%i=FOC -%i=BPM -%i=TRG -%i=SCH >\n",
                 log_level,
                 LOG_CRIT, LOG_SYS, LOG_ERR, LOG_WRN, LOG_IMG, LOG_INF, LOG_MSG, LOG_DBG, LOG_NONE,
-                FAC_MOP , FAC_LOG, FAC_UTL, FAC_OPT, FAC_CAM, FAC_ROT, FAC_FTS, FAC_MSG, FAC_WHL );
+                FAC_MOP , FAC_LOG, FAC_UTL, FAC_OPT, FAC_CAM, FAC_ROT, FAC_FTS, FAC_MSG, FAC_WHL, FAC_SHM, FAC_XFR, FAC_CAL, FAC_STK, FAC_POL, FAC_LIB, FAC_IMG, FAC_AEX, FAC_FOC, FAC_BPM, FAC_TRG, FAC_SCH );
     printf("  -i  Andor camera ID <1, 2>        [     %i         ]\n" , cam_idx+1 );
     printf("  -s  Force single master camera    [ %5.5s         ]\n"  , btoa(one_cam));
+    printf("  -j  shared memory ring slots      [ %5i         ]\n"    , shm_slots);
+    printf("  -G  pair frames on master, TCP port [ %5i         ]\n"  , xfr_port );
+    printf("  -V  q/u per rotation from pairs   [ %5.5s         ]\n"  , btoa(xfr_pol));
+    printf("  -@  RT profile <prio[,acq cpu[,rot cpu]]> 0=off [ %i,%i,%i ]\n", sch_prio, sch_cpu_acq, sch_cpu_rot );
+    printf("  -K  calibrate readout modes, write cache %s\n"         , CAL_FILE );
     printf("  -a  static fixed Angle            [  % 2.1f deg     ]\n", rot_zero );
     printf("  -l  Log file                      [ %8.8s      ]\n"     , log_file ? log_file:"<none>");
     printf("  -L  Log prefix                    [ %8.8s      ]\n"     , log_pfx  );
     printf("  -k  Kill process\n");
+    printf("  -P  run sequence file. One line of options per run\n");
+    printf("  -Q  Query run queue\n");
+    printf("  -X  abort (X) queued runs\n");
     printf("  -U  suggest rUn starting number (may be overriden if too low) \n");
     printf("  -E  Enumerate options for <feature>\n");
 }
@@ -182,6 +207,17 @@ bool mop_opts(int argc, char *argv[], char *valid, char *check )
             case 'q': // Don't wait for temp. to stabilise
                 cam_quick = atoi(optarg) ? true : false;
 		break;
+            case 'K': // Calibrate readout modes and write cache 
+                mop_log( true, LOG_WRN, FAC, "DEBUG ONLY: -%c must be last option.",c); 
+                mop_init();
+                mop_exit( cal_run( &mop_cam ) ? EXIT_SUCCESS : EXIT_FAILURE );
+                break;
+            case 'Y': // Use fastest calibrated mode with <bits>[,<max. noise e>]. 0 = Off
+                cam_noise = 0.0;
+                if ( sscanf( optarg, "%d,%lf", &i, &cam_noise ) < 1 || ( i && i != 12 && i != 16 ))
+                    return mop_log( false, LOG_ERR, FAC, "Invalid mode requirement %s. Use 12 or 16[,<max. noise>]", optarg); 
+                cam_bits = i;
+                break;
             case 'E': // Display a detector enumerated feature
                 mop_log( true, LOG_WRN, FAC, "DEBUG ONLY: -%c must be last option.",c); 
 		mbstowcs( Feature, optarg, MAX_STR-1 );
@@ -192,21 +228,12 @@ bool mop_opts(int argc, char *argv[], char *valid, char *check )
 		cam_feature( &mop_cam, Feature );
                 mop_exit( EXIT_SUCCESS );
 		break;
-	    case 'n': // Set number of steps in a rotation
-                switch ( atoi(optarg) )
-                {  
-                    case 8:
-                        rot_stp   = ROT_STP8;
-                        img_cycle = 8;
-                        break;
-                    case 16:
-                        rot_stp   = ROT_STP16;
-                        img_cycle = 16;
-                        break;
-                    default:
-                        return mop_log( false, LOG_ERR, FAC, "%s images per rev. unsupported. Use 8 or 16", optarg); 
-                        break;
-                }
+	    case 'n': // Set number of steps in a rotation. Any that divide a revolution into whole rotator steps 
+                i = atoi(optarg);
+                if ( i < 1 || i > MAX_CYCLE || ( 360 * ROT_STP_RES ) % i )
+                    return mop_log( false, LOG_ERR, FAC, "%s images per rev. unsupported. Use 8, 16, 32 or another divisor of 360 deg up to %i", optarg, MAX_CYCLE); 
+                rot_stp   = 360.0 / i;
+                img_cycle = i;
                 break;
             case 'u': // RUNTIME ONLY: Set the rotator USB device
                 rot_usb = optarg;
@@ -263,8 +290,8 @@ bool mop_opts(int argc, char *argv[], char *valid, char *check )
                 break;
             case 'c': // Camera number  
                 i = atoi(optarg) - 1;
-                if ( i < 0 || i > CAM_COUNT )
-                    return mop_log( false, LOG_ERR, FAC, "Camera -c%s unsupported. Use 1 or %i", optarg, CAM_COUNT); 
+                if ( i < 0 || i >= CAM_MAX )
+                    return mop_log( false, LOG_ERR, FAC, "Camera -c%s unsupported. Use 1 to %i", optarg, CAM_MAX); 
                 cam_num = i; 
                 if ( cam_num == 0 )
                     mop_master = true;
@@ -312,6 +339,9 @@ bool mop_opts(int argc, char *argv[], char *valid, char *check )
                 else 
                     return mop_log( false, LOG_ERR, FAC, "Unsupported gain mode %s. Use 12H, 12L or 16L", optarg); 
                 break;
+            case 'y': // Software trigger step period. 0 = Lock-step with a trigger message per frame, -ve = Auto
+                cam_stp = atof(optarg);
+                break;
             case 'a': // Fixed angle   
                 f = atof(optarg);
                 if ( f < -360.0  || f > 360.0 )
@@ -362,6 +392,76 @@ bool mop_opts(int argc, char *argv[], char *valid, char *check )
                         break;
                 }               
                 break;
+            case 'B': // Calibrated float32 electrons output 
+                fts_elec = atoi( optarg ) ? true : false;
+                break;
+            case 'I': // Bad pixel map. Raw, DQ extension or interpolated 
+                i = atoi( optarg );
+                if ( i < BPM_OFF || i > BPM_FIX )
+                    return mop_log( false, LOG_ERR, FAC, "Bad pixel mode %s invalid. Use 0=Raw, 1=DQ or 2=Interpolate", optarg );
+                fts_bpm = i;
+                break;
+            case 'T': // Acquisition auto-exposure target peak 
+                f = atof( optarg );
+                if ( f < 0.0 || f > 1.0 )
+                    return mop_log( false, LOG_ERR, FAC, "Target peak %s out-of-range. Use 0 to 1", optarg );
+                aex_peak = f;
+                break;
+            case 'H': // Run is part of a focus sweep of this many runs. Set by mopcmd -J 
+                i = atoi( optarg );
+                if ( i < 0 || i > MSG_QUEUE )
+                    return mop_log( false, LOG_ERR, FAC, "Focus sweep of %s runs out-of-range. Use 0 to %i", optarg, MSG_QUEUE );
+                foc_sweep = i;
+                break;
+            case 'J': // Focus sweep positions (command process only)
+                foc_list = optarg;
+                break;
+            case 'z': // Co-add rotations, one stack per position 
+                img_stk = atoi( optarg ) ? true : false;
+                break;
+            case 'g': // Window WxH[+X+Y] in unbinned sensor pixels, centred if no offset. 0 = Full sensor 
+                img_aoi_x = img_aoi_y = -1;
+                if ( !strcmp( optarg, "0" ))
+                {
+                    img_aoi_w = img_aoi_h = 0;
+                    break;
+                }
+                i = sscanf( optarg, "%dx%d+%d+%d", &img_aoi_w, &img_aoi_h, &img_aoi_x, &img_aoi_y );
+                if (( i != 2 && i != 4 ) || img_aoi_w <= 0 || img_aoi_h <= 0 || ( i == 4 && ( img_aoi_x < 0 || img_aoi_y < 0 )))
+                {
+                    img_aoi_w = img_aoi_h = 0;
+                    img_aoi_x = img_aoi_y = -1;
+                    return mop_log( false, LOG_ERR, FAC, "Invalid window %s. Use WxH or WxH+X+Y, 0 = Full sensor", optarg); 
+                }
+                break;
+            case 'j': // RUNTIME ONLY: Shared memory frame ring slots, 0 = disabled
+                i = atoi(optarg);
+                if ( i < 0 || i > MAX_IMAGES )
+                    return mop_log( false, LOG_ERR, FAC, "Ring slots %s out-of-range. Use 0 to %i", optarg, MAX_IMAGES);
+                shm_slots = i;
+                break;
+            case 'G': // RUNTIME ONLY: Slave streams frames to master for pairing, TCP port. 0 = disabled
+                i = atoi(optarg);
+                if ( i < 0 || i > 65535 )
+                    return mop_log( false, LOG_ERR, FAC, "Pairing port %s out-of-range. Use 0 to 65535", optarg);
+                xfr_port = i;
+                break;
+            case 'V': // RUNTIME ONLY: Reduce paired frames to Stokes q/u per rotation. Needs -G 
+                xfr_pol = atoi(optarg) ? true : false;
+                break;
+            case '@': // RUNTIME ONLY: Real-time profile. Acquisition SCHED_FIFO priority, 0 = off, and cores, -1 = not pinned 
+                sch_cpu_acq = sch_cpu_rot = -1;
+                if ( sscanf( optarg, "%d,%d,%d", &sch_prio, &sch_cpu_acq, &sch_cpu_rot ) < 1 ||
+                     sch_prio < 0 || sch_prio > sched_get_priority_max( SCHED_FIFO ) ||
+                     sch_cpu_acq < -1 || sch_cpu_acq >= sysconf( _SC_NPROCESSORS_CONF ) ||
+                     sch_cpu_rot < -1 || sch_cpu_rot >= sysconf( _SC_NPROCESSORS_CONF ) ||
+                     ( sch_cpu_acq >= 0 && sch_cpu_acq == sch_cpu_rot ))
+                {
+                    sch_prio = 0;
+                    return mop_log( false, LOG_ERR, FAC, "Invalid RT profile %s. Use <prio 1-%i>[,<acq cpu>[,<rot cpu>]], 0 = Off", 
+                                    optarg, sched_get_priority_max( SCHED_FIFO ));
+                }
+                break;
             case 's': // DEBUG ONLY: Force single camera as master
                 mop_master = true;                
                 one_cam    = true;
@@ -426,11 +526,19 @@ bool mop_opts(int argc, char *argv[], char *valid, char *check )
                  else
                      mop_log( false, LOG_WRN, FAC, "Invalid MasterIP %s", optarg); 
                 break; 
-            case 'S': // RUNTIME ONLY: Slave IP address
-                if ( utl_chk_ip( optarg ) )
-                     mop_log( true,  LOG_INF, FAC, "SlaveIP = %s", ipslave=optarg); 
-                else
-                     mop_log( false, LOG_WRN, FAC, "Invalid SlaveIP %s", optarg); 
+            case 'S': // RUNTIME ONLY: Slave IP address list. Camera 2 is first, 3 next, ...
+                strncpy( opt_slaves, optarg, sizeof(opt_slaves)-1 );
+                for ( i = 0, ptr = strtok( opt_slaves, "," ); ptr && i < CAM_MAX-1; ptr = strtok( NULL, "," ))
+                    if ( utl_chk_ip( ptr ) )
+                        mop_log( true,  LOG_INF, FAC, "SlaveIP = %s", ipslaves[i++]=ptr); 
+                    else
+                        mop_log( false, LOG_WRN, FAC, "Invalid SlaveIP %s", ptr); 
+                if ( i )
+                {
+                    ipslave    = ipslaves[0];
+                    mop_slaves = i;
+                    mop_cams   = i + 1;
+                }
                 break; 
             case 'O': // Set object name 
                 strncpy( fts_obj, optarg, MAX_STR-1 );
@@ -482,6 +590,15 @@ bool mop_opts(int argc, char *argv[], char *valid, char *check )
                 if ( !strcmp( mop_proc, MOP_PROC )) // Only if mopcam
                     mop_exit( EXIT_SUCCESS );
                 break;
+            case 'P': // Sequence file (command process only)
+                mop_seq = optarg; 
+                break;
+            case 'Q': // Query run queue (command process only)
+                mop_qry = true; 
+                break;
+            case 'X': // Abort queued runs (command process only)
+                mop_abt = true; 
+                break;
             case '?': // Catch argument errors
                 if ( strchr( check, optopt ) )
                     mop_log( false, LOG_WRN, FAC, "Option -%c missing argument", optopt); 
@@ -0,0 +1,216 @@
+/** @file   mop_pol.c
+  *
+  * @brief MOPTOP online dual-beam polarimetry reduction
+  *
+  *        Each camera pair from mop_xfr.c gives the normalised beam difference s = (I0 - I90) / (I0 + I90)
+  *        at one rotator arc. For a rotating half-wave plate s = q.cos4t + u.sin4t, averaged over the arc
+  *        swept during the exposure. The arc averages of cos4t and sin4t are the basis for each frame, so
+  *        continuous and stepped rotation, and any number of positions, are reduced the same way.
+  *        Per pixel sums of s times each basis are accumulated as pairs arrive. When a rotation is complete
+  *        the 2x2 least squares system, common to all pixels, is solved and q/u images are written.
+  *        Frames are assumed registered pixel for pixel between the cameras.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#include "mopnet.h"
+#define FAC FAC_POL
+
+static float   *pol_q   = NULL;  // Per pixel sum of s.cos4t, becomes q
+static float   *pol_u   = NULL;  // Per pixel sum of s.sin4t, becomes u
+static size_t   pol_max = 0;     // Max. pixels
+static double   pol_sgn = 1.0;   // +1 if this camera sees the 0 deg beam, -1 if 90 deg
+static int      pol_run = -1;    // Run and rotation being accumulated
+static int      pol_rot = -1;
+static int      pol_num = 0;     // Positions added
+static double   pol_cc, pol_cs, pol_ss; // Design matrix sums
+static double   pol_fq, pol_fu;         // Whole frame sums of s.cos4t and s.sin4t
+static pthread_mutex_t pol_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/** @brief      Accumulate normalised difference of two Mono16 images against the basis
+  *
+  * @param[in,out] *q  = sum of s.c
+  * @param[in,out] *u  = sum of s.s
+  * @param[in]     *a  = 0 deg beam pixels
+  * @param[in]     *b  = 90 deg beam pixels
+  * @param[in]      n  = pixel count
+  * @param[in]      c  = basis, arc average of cos4t
+  * @param[in]      s  = basis, arc average of sin4t
+  * @param[out]   *sa  = sum of a
+  * @param[out]   *sb  = sum of b
+  */
+static void pol_kernel( float *restrict q, float *restrict u, const uint16_t *restrict a, const uint16_t *restrict b,
+                        size_t n, float c, float s, uint64_t *sa, uint64_t *sb )
+{
+    float          *qq = __builtin_assume_aligned( q, 16 );
+    float          *uu = __builtin_assume_aligned( u, 16 );
+    const uint16_t *aa = __builtin_assume_aligned( a, 16 );
+    const uint16_t *bb = __builtin_assume_aligned( b, 16 );
+    uint64_t        ta = 0;
+    uint64_t        tb = 0;
+
+    for ( size_t i = 0; i < n; i++ )
+    {
+        float fa = aa[i];
+        float fb = bb[i];
+        float ft = fa + fb;
+        float d  = ( fa - fb ) / ( ft > 0.0f ? ft : 1.0f );
+
+        qq[i] += d * c;
+        uu[i] += d * s;
+        ta    += aa[i];
+        tb    += bb[i];
+    }
+    *sa = ta;
+    *sb = tb;
+}
+
+
+/** @brief      Allocate accumulators. Master only, called once pairing is running.
+  *             Failure is not fatal, rotations are just not reduced.
+  *
+  * @param[in] *cam = pointer to camera info structure, sensor size and polarisation angle known
+  *
+  * @return     true
+  */
+bool pol_init( mop_cam_t *cam )
+{
+    if ( !xfr_pol || pol_max )
+        return true;
+
+    pol_max = cam->SensorWidth * cam->SensorHeight;
+    if (!( pol_q = aligned_alloc( 16, pol_max * sizeof(float) )) ||
+        !( pol_u = aligned_alloc( 16, pol_max * sizeof(float) ))  )
+    {
+        free( pol_q );
+        pol_q = NULL;
+        pol_max = 0;
+        return mop_log( true, LOG_WRN, FAC, "aligned_alloc() %s. Polarimetry disabled", strerror(errno) );
+    }
+
+//  Orthogonal beams so only whether this camera is the 0 or 90 deg beam matters
+    pol_sgn = cos( 2.0 * cam->PolAngle * M_PI / 180.0 ) >= 0.0 ? 1.0 : -1.0;
+
+    return mop_log( true, LOG_INF, FAC, "Stokes q/u per rotation. Camera %i is the %s deg beam", cam_num+1, pol_sgn > 0.0 ? "0" : "90" );
+}
+
+
+/** @brief      Solve for q/u, write product and restart. Call locked.
+  *
+  * @param[in] *frm = header of last frame in this rotation
+  *
+  * @return     true | false = Success | Failure
+  */
+static bool pol_done( shm_frm_t *frm )
+{
+    size_t n   = (size_t)frm->width * frm->height;
+    double det = pol_cc * pol_ss - pol_cs * pol_cs;
+    double icc, ics, iss;
+    double fq, fu;
+    float  a, b;
+    bool   ok;
+
+    pol_num = 0;
+    pol_rot = -1;
+    if ( det < POL_MIN_DET )
+        return mop_log( false, LOG_ERR, FAC, "Run %i rotation %i. Positions do not separate q and u, det = %g", frm->run, frm->rot_n, det );
+
+//  Inverse of symmetric design matrix [ cc cs ; cs ss ]
+    icc =  pol_ss / det;
+    ics = -pol_cs / det;
+    iss =  pol_cc / det;
+    fq  = icc * pol_fq + ics * pol_fu;
+    fu  = ics * pol_fq + iss * pol_fu;
+
+    for ( size_t i = 0; i < n; i++ )
+    {
+        a = pol_q[i];
+        b = pol_u[i];
+        pol_q[i] = icc * a + ics * b;
+        pol_u[i] = ics * a + iss * b;
+    }
+
+    ok = fts_pol( frm, frm->seq_n, pol_q, pol_u, fq, fu );
+
+    return mop_log( ok, LOG_INF, FAC, "Run %i rotation %i. Frame q = %+.5f u = %+.5f p = %.5f angle = %.2f deg",
+                    frm->run, frm->rot_n, fq, fu, hypot( fq, fu ), 0.5 * atan2( fu, fq ) * 180.0 / M_PI );
+}
+
+
+/** @brief      Add a camera pair. Called by the thread completing the pair, either side.
+  *
+  * @param[in] *mine     = this (master) camera frame header
+  * @param[in] *mine_pix = this camera Mono16 pixel data
+  * @param[in] *peer     = other camera frame header
+  * @param[in] *peer_pix = other camera Mono16 pixel data
+  *
+  * @return     true | false = Success | Failure
+  */
+bool pol_add( shm_frm_t *mine, AT_U8 *mine_pix, shm_frm_t *peer, AT_U8 *peer_pix )
+{
+    size_t   n = (size_t)mine->width * mine->height;
+    double   t0, t1;  // [rad] 4 x arc start and end
+    double   c, s;    // Basis
+    double   f;
+    uint64_t sa, sb;
+    bool     ok = true;
+
+    if ( !pol_max )
+        return true;
+
+    if ( mine->width != peer->width || mine->height != peer->height || n > pol_max )
+        return mop_log( false, LOG_ERR, FAC, "Run %i rotation %i position %i. Camera images %ix%i and %ix%i differ",
+                        mine->run, mine->rot_n, mine->seq_n, mine->width, mine->height, peer->width, peer->height );
+
+//  Only the master has the real rotator angles
+    t0 = 4.0 * mine->rot_ang * M_PI / 180.0;
+    t1 = 4.0 * ( mine->rot_ang + mine->rot_dif ) * M_PI / 180.0;
+    if ( fabs( t1 - t0 ) > 1.0E-6 )
+    {
+        c = ( sin( t1 ) - sin( t0 )) / ( t1 - t0 );
+        s = ( cos( t0 ) - cos( t1 )) / ( t1 - t0 );
+    }
+    else
+    {
+        c = cos( t0 );
+        s = sin( t0 );
+    }
+
+    pthread_mutex_lock( &pol_mtx );
+
+//  New rotation. Anything left over is incomplete
+    if ( mine->run != pol_run || mine->rot_n != pol_rot )
+    {
+        if ( pol_num )
+            ok = mop_log( false, LOG_WRN, FAC, "Run %i rotation %i has %i of %i positions. Discarded", pol_run, pol_rot, pol_num, img_cycle );
+
+        pol_run = mine->run;
+        pol_rot = mine->rot_n;
+        pol_num = 0;
+        pol_cc  = pol_cs = pol_ss = 0.0;
+        pol_fq  = pol_fu = 0.0;
+        memset( pol_q, 0, n * sizeof(float) );
+        memset( pol_u, 0, n * sizeof(float) );
+    }
+
+    if ( pol_sgn > 0.0 )
+        pol_kernel( pol_q, pol_u, (uint16_t *)mine_pix, (uint16_t *)peer_pix, n, c, s, &sa, &sb );
+    else
+        pol_kernel( pol_q, pol_u, (uint16_t *)peer_pix, (uint16_t *)mine_pix, n, c, s, &sa, &sb );
+
+    f = sa + sb ? ( (double)sa - (double)sb ) / ( (double)sa + (double)sb ) : 0.0;
+    pol_fq += f * c;
+    pol_fu += f * s;
+    pol_cc += c * c;
+    pol_cs += c * s;
+    pol_ss += s * s;
+
+    if ( ++pol_num == img_cycle )
+        ok = pol_done( mine ) && ok;
+
+    pthread_mutex_unlock( &pol_mtx );
+
+    return ok;
+}
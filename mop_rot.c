@@ -10,6 +10,62 @@
 #include "mopnet.h"
 #define FAC FAC_ROT
 
+// Serialise PI library calls as rotator may be accessed by more than one thread
+static pthread_mutex_t rot_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/** @brief       Locked PI_qPOS(). Read rotator position 
+  *  
+  * @param[out] *angle = Rotator position angle [degrees]
+  *
+  * @return      true | false = Success | Failure
+  */
+static bool rot_pi_pos( double *angle )
+{
+    BOOL ret;
+
+    pthread_mutex_lock( &rot_mtx );
+    ret = PI_qPOS( rot_id, rot_axis, angle );
+    pthread_mutex_unlock( &rot_mtx );
+
+    return ret;
+}
+
+
+/** @brief       Locked PI_MOV(). Start move to position 
+  *  
+  * @param[in]   angle = Rotator position angle [degrees]
+  *
+  * @return      true | false = Success | Failure
+  */
+static bool rot_pi_mov( double angle )
+{
+    BOOL ret;
+
+    pthread_mutex_lock( &rot_mtx );
+    ret = PI_MOV( rot_id, rot_axis, &angle );
+    pthread_mutex_unlock( &rot_mtx );
+
+    return ret;
+}
+
+
+/** @brief       Locked PI_qONT(). Read on target state 
+  *  
+  * @param[out] *in_pos = On target state
+  *
+  * @return      true | false = Success | Failure
+  */
+static bool rot_pi_ont( BOOL *in_pos )
+{
+    BOOL ret;
+
+    pthread_mutex_lock( &rot_mtx );
+    ret = PI_qONT( rot_id, rot_axis, in_pos );
+    pthread_mutex_unlock( &rot_mtx );
+
+    return ret;
+}
+
 
 /** @brief      DEBUG ONLY: Get and log rotator position 
   *  
@@ -23,7 +79,7 @@ double rot_dbg( char *dbg )
 
     if ( mop_master )
     {
-        if ( PI_qPOS( rot_id, rot_axis, &angle ))
+        if ( rot_pi_pos( &angle ))
             mop_log( true,  LOG_DBG, FAC, "angle=%8.3f DBG=%s", angle, dbg );
         else 
             mop_log( false, LOG_ERR, FAC, "PI_qPOS() fail" );
@@ -41,7 +97,7 @@ double rot_dbg( char *dbg )
   */
 bool rot_get( double *angle )
 {
-    return PI_qPOS( rot_id, rot_axis, angle );
+    return rot_pi_pos( angle );
 }
 
 
@@ -57,8 +113,8 @@ bool rot_set( double angle, int timeout )
     double now;
 
     mop_log( true, LOG_DBG, FAC, "rot_set(%f)", angle );
-    PI_qPOS( rot_id, rot_axis, &now );
-    PI_MOV(  rot_id, rot_axis, &angle );
+    rot_pi_pos( &now );
+    rot_pi_mov( angle );
     return rot_wait( angle, timeout, (angle > now) );  
 }
 
@@ -72,7 +128,7 @@ bool rot_set( double angle, int timeout )
 bool rot_move( double angle )
 {
     mop_log( true, LOG_DBG, FAC, "rot_move(%f)", angle );
-    return PI_MOV( rot_id, rot_axis, &angle );
+    return rot_pi_mov( angle );
 }
 
 
@@ -92,15 +148,15 @@ bool rot_goto( double angle, int timeout, double *actual )
     int count = TIM_MICROSECOND * timeout / tick;  // Timer count [ms] 
 
     mop_log( true, LOG_DBG, FAC, "rot_goto(%f)", angle );
-    PI_MOV( rot_id, rot_axis, &angle );
+    rot_pi_mov( angle );
     do
     { 
-        PI_qONT( rot_id, rot_axis, &in_pos );
+        rot_pi_ont( &in_pos );
         if ( in_pos )
         {
             if ( actual )
             {
-                PI_qPOS( rot_id, rot_axis, actual );
+                rot_pi_pos( actual );
                 return mop_log( true, LOG_DBG, FAC, "Goto angle=%f, actual=%f", angle, *actual );
             }
             else
@@ -133,7 +189,8 @@ bool rot_wait( double angle, int timeout, bool cw )
 
     do
     { 
-        PI_qPOS( rot_id, rot_axis, &now );
+        rot_pi_pos( &now );
+        sch_mark( SCH_ROT );
         dif = now - angle;
         if ( (  fabs( dif ) <= ROT_TOLERANCE )||  // Position is already within tolerance
              (  cw && dif   >= ROT_TOLERANCE )||  // Moving clockwise and past point
@@ -157,7 +214,13 @@ bool rot_wait( double angle, int timeout, bool cw )
   */
 bool rot_cmd( char *cmd, char *log )
 {
-    if ( PI_GcsCommandset( rot_id, cmd ) != 1 )
+    BOOL ret;
+
+    pthread_mutex_lock( &rot_mtx );
+    ret = PI_GcsCommandset( rot_id, cmd );
+    pthread_mutex_unlock( &rot_mtx );
+
+    if ( ret != 1 )
         return mop_log( false, LOG_ERR, FAC, "cmd='%s' %s", cmd, log );
     else
         return mop_log( true,  LOG_DBG, FAC, "cmd='%s'", cmd );
@@ -231,6 +294,22 @@ bool rot_init( char *usb, int baud, int timeout, char *rot_trg_lvl )
 }
 
 
+/** @brief       Park rotator at the initial position ready for the next run. No completion check. 
+  *              Called once the last trigger of a run has fired. 
+  *
+  * @return      true | false = Success | Failure
+  */
+bool rot_park( void )
+{
+    if ( rot_trg_ena( false                            )&&
+         rot_cmd    ( ROT_INI_VEL, "Set init. velocity")&&
+         rot_move   ( rot_sign * ROT_INI_ANGLE * -1.0  )  )
+        return true;
+    else
+        return mop_log( false, LOG_ERR, FAC, "rot_park()" );
+}
+
+
 /** @brief       Enable/disable rotator hardware trigger output 
   *
   * @param[in]   enable       = true | false 
@@ -270,7 +349,7 @@ bool rot_ont( int timeout )
     int count = TIM_MICROSECOND * timeout / tick; // Timer count [ms] 
     do
     { 
-        PI_qONT( rot_id, rot_axis, &in_pos );
+        rot_pi_ont( &in_pos );
         if ( in_pos )
 	    return true;
 
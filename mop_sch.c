@@ -0,0 +1,230 @@
+/** @file   mop_sch.c
+  *
+  * @brief MOPTOP real-time scheduling profile
+  *
+  *        With -@<prio>[,<acq cpu>[,<rot cpu>]] the acquisition loop runs SCHED_FIFO at <prio> on its own core
+  *        while acquiring, the rotator drain task has a core of its own and every other thread, e.g. the pairing
+  *        receiver, the run setup tasks and the main thread between acquisitions, runs at normal priority on the
+  *        remaining cores. Memory is locked when the process may lock all of it. Without the privileges each step
+  *        warns once and the process carries on at normal priority and affinity.
+  *
+  *        The acquisition, rotator and pairing threads are timed from /proc/thread-self/schedstat. The run queue
+  *        delay, time spent runnable but not running, is sampled at each frame or rotator wait and the total,
+  *        mean and worst interval of each thread are logged after each run, with the profile on or off.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#define _GNU_SOURCE // CPU_SET(), pthread_setaffinity_np()
+#include "mopnet.h"
+#define FAC FAC_SCH
+
+/// Scheduling latency of one thread
+typedef struct sch_lat_s
+{
+    int       fd;              //!< schedstat of thread. -1 = Not tracked
+    pthread_t tid;             //!< Thread holding the role
+    uint64_t  last;            //!< [ns] Run queue delay at last sample
+    uint64_t  sum;             //!< [ns] Delay this run
+    uint64_t  max;             //!< [ns] Worst delay between samples
+    int       num;             //!< Samples this run
+} sch_lat_t;
+
+static const char *sch_role[SCH_ROLES] = { "ACQ", "ROT", "XFR", "OTH" };
+static sch_lat_t   sch_lat [SCH_ROLES] = { [SCH_ACQ] = { .fd = -1 }, [SCH_ROT] = { .fd = -1 },
+                                           [SCH_XFR] = { .fd = -1 }, [SCH_OTH] = { .fd = -1 } };
+static cpu_set_t   sch_oth;            // Cores for all other threads
+static bool        sch_on = false;     // Profile applied
+static bool        sch_rt = false;     // SCHED_FIFO permitted
+static pthread_mutex_t sch_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/** @brief      Read run queue delay of thread
+  *
+  * @param[in]   fd = open /proc/thread-self/schedstat
+  * @param[out] *ns = [ns] delay since thread start
+  *
+  * @return      true | false = Success | Failure
+  */
+static bool sch_read( int fd, uint64_t *ns )
+{
+    char    buf[96];
+    ssize_t len;
+
+    if (( len = pread( fd, buf, sizeof(buf)-1, 0 )) <= 0 )
+        return false;
+    buf[len] = '\0';
+
+//  Fields: on-cpu time, run queue delay, timeslices
+    return sscanf( buf, "%*u %lu", ns ) == 1;
+}
+
+
+/** @brief      Check the profile, lock memory and set the cores left for other threads.
+  *             Call once, before any thread is started, so they inherit the normal profile.
+  *
+  * @return     true | false = Profile applied or off | Applied in part
+  */
+bool sch_init( void )
+{
+    struct rlimit lim;
+    cpu_set_t     all;
+    bool          ok = true;
+
+    if ( !sch_prio )
+        return true;
+
+    if ( sched_getaffinity( 0, sizeof(all), &all ))
+        return mop_log( false, LOG_SYS, FAC, "sched_getaffinity() %s. Profile off", strerror(errno) );
+
+//  Reserved cores must be available. Other threads keep the rest, or share if nothing is left
+    if ( sch_cpu_acq >= 0 && !CPU_ISSET( sch_cpu_acq, &all ))
+    {
+        ok = mop_log( false, LOG_WRN, FAC, "Acquisition core %i not available. Not pinned", sch_cpu_acq );
+        sch_cpu_acq = -1;
+    }
+    if ( sch_cpu_rot >= 0 && !CPU_ISSET( sch_cpu_rot, &all ))
+    {
+        ok = mop_log( false, LOG_WRN, FAC, "Rotator core %i not available. Not pinned", sch_cpu_rot );
+        sch_cpu_rot = -1;
+    }
+    sch_oth = all;
+    if ( sch_cpu_acq >= 0 )
+        CPU_CLR( sch_cpu_acq, &sch_oth );
+    if ( sch_cpu_rot >= 0 )
+        CPU_CLR( sch_cpu_rot, &sch_oth );
+    if ( !CPU_COUNT( &sch_oth ))
+    {
+        ok = mop_log( false, LOG_WRN, FAC, "No core left for other threads. Sharing all %i", CPU_COUNT( &all ));
+        sch_oth = all;
+    }
+
+//  Locking future mappings too is only safe with no limit. Otherwise image arena locks itself
+    if ( !getrlimit( RLIMIT_MEMLOCK, &lim ) && lim.rlim_cur == RLIM_INFINITY )
+    {
+        if ( mlockall( MCL_CURRENT | MCL_FUTURE ))
+            ok = mop_log( false, LOG_WRN, FAC, "mlockall() %s. Memory not locked", strerror(errno) );
+    }
+    else
+    {
+        mop_log( true, LOG_INF, FAC, "RLIMIT_MEMLOCK limited. Only image arena locked" );
+    }
+
+    sch_on = true;
+    sch_rt = true;
+    ok = sch_set( SCH_OTH ) && ok;
+
+    return mop_log( ok, ok ? LOG_INF : LOG_WRN, FAC, "RT profile. ACQ FIFO %i core %i. ROT core %i. Others %i cores",
+                    sch_prio, sch_cpu_acq, sch_cpu_rot, CPU_COUNT( &sch_oth ));
+}
+
+
+/** @brief      Apply a role of the profile to the calling thread. The acquisition, rotator and pairing roles
+  *             also start its latency samples, with or without the profile. SCHED_FIFO refused once is not tried again.
+  *
+  * @param[in]  role = SCH_ACQ | SCH_ROT | SCH_XFR | SCH_OTH
+  *
+  * @return     true | false = Applied or profile off | Applied in part
+  */
+bool sch_set( int role )
+{
+    struct sched_param par = {0};
+    cpu_set_t set;
+    sch_lat_t *lat = &sch_lat[role];
+    int       cpu  = role == SCH_ACQ ? sch_cpu_acq : role == SCH_ROT ? sch_cpu_rot : -1;
+    int       pol  = SCHED_OTHER;
+    int       err;
+    bool      ok   = true;
+
+//  Cores and priority for the role
+    if ( sch_on )
+    {
+        if ( cpu >= 0 )
+        {
+            CPU_ZERO( &set );
+            CPU_SET( cpu, &set );
+        }
+        else
+        {
+            set = sch_oth;
+        }
+        if (( err = pthread_setaffinity_np( pthread_self(), sizeof(set), &set )))
+            ok = mop_log( false, LOG_WRN, FAC, "%s pthread_setaffinity_np() %s", sch_role[role], strerror(err) );
+
+//      Needs CAP_SYS_NICE or RLIMIT_RTPRIO at least the priority
+        if ( role == SCH_ACQ && sch_rt )
+        {
+            pol = SCHED_FIFO;
+            par.sched_priority = sch_prio;
+        }
+        if (( err = pthread_setschedparam( pthread_self(), pol, &par )))
+        {
+            sch_rt = sch_rt && pol != SCHED_FIFO;
+            ok = mop_log( false, LOG_WRN, FAC, "%s pthread_setschedparam(%s %i) %s. Normal priority",
+                          sch_role[role], pol == SCHED_FIFO ? "FIFO" : "OTHER", par.sched_priority, strerror(err) );
+        }
+    }
+
+    if ( role == SCH_OTH )
+        return ok;
+
+//  Latency is sampled with the profile off too, for comparison
+    pthread_mutex_lock( &sch_mtx );
+    lat->tid = pthread_self();
+    if ( lat->fd >= 0 )
+        close( lat->fd );
+    if (( lat->fd = open( "/proc/thread-self/schedstat", O_RDONLY )) >= 0 && !sch_read( lat->fd, &lat->last ))
+    {
+        close( lat->fd );
+        lat->fd = -1;
+    }
+    pthread_mutex_unlock( &sch_mtx );
+
+    return ok;
+}
+
+
+/** @brief      Latency sample, once per frame or wait. Ignored unless called by the thread holding the role
+  *
+  * @param[in]  role = SCH_ACQ | SCH_ROT | SCH_XFR
+  */
+void sch_mark( int role )
+{
+    sch_lat_t *lat = &sch_lat[role];
+    uint64_t   now;
+
+    if ( lat->fd < 0 || !pthread_equal( lat->tid, pthread_self() ) || !sch_read( lat->fd, &now ))
+        return;
+
+    pthread_mutex_lock( &sch_mtx );
+    lat->sum += now - lat->last;
+    lat->max  = MAX( lat->max, now - lat->last );
+    lat->num++;
+    lat->last = now;
+    pthread_mutex_unlock( &sch_mtx );
+}
+
+
+/** @brief      Log each tracked thread's latency this run and start again
+  *
+  * @return     true
+  */
+bool sch_done( void )
+{
+    pthread_mutex_lock( &sch_mtx );
+    for ( int i = 0; i < SCH_OTH; i++ )
+    {
+        sch_lat_t *lat = &sch_lat[i];
+
+        if ( lat->fd < 0 || !lat->num )
+            continue;
+        mop_log( true, LOG_INF, FAC, "%s %i samples. Run queue delay %.3fms, mean %.1fus, max %.1fus",
+                 sch_role[i], lat->num, lat->sum / 1.0E6, lat->sum / 1.0E3 / lat->num, lat->max / 1.0E3 );
+        lat->sum = lat->max = 0;
+        lat->num = 0;
+    }
+    pthread_mutex_unlock( &sch_mtx );
+
+    return true;
+}
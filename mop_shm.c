@@ -0,0 +1,330 @@
+/** @file   mop_shm.c
+  *
+  * @brief MOPTOP shared memory frame ring
+  *
+  *        Each acquired frame is published into a named POSIX shared memory ring for local consumers.
+  *        A slot holds a header, copied from mop_cam_t, followed by the Mono16 pixel data.
+  *        Slots are protected by a sequence lock so readers map the ring read-only, use frames in-place
+  *        and check afterwards that the slot was not overwritten. The writer never waits for a reader.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#include "mopnet.h"
+#define FAC FAC_SHM
+
+static shm_ring_t *shm_ring = NULL;  // Writer's mapping. NULL = not publishing
+static char        shm_name[MAX_STR];// Writer's ring name
+static int         shm_fd   = -1;    // Writer's ring descriptor. Kept for sendfile() 
+
+/** @brief      Pointer to slot for a frame number
+  *
+  * @param[in] *ring  = mapped ring
+  * @param[in]  frame = frame number
+  *
+  * @return     slot header pointer
+  */
+static shm_frm_t *shm_slot( shm_ring_t *ring, uint64_t frame )
+{
+    return (shm_frm_t *)((char *)ring + ring->data + ( frame % ring->slots ) * ring->slot_size );
+}
+
+
+/** @brief      Create the frame ring. Failure is not fatal, frames are just not published
+  *
+  * @param[in] *cam   = pointer to camera info structure, buffers already allocated
+  * @param[in]  slots = number of frame slots. 0 = disabled
+  *
+  * @return     true
+  */
+bool shm_init( mop_cam_t *cam, int slots )
+{
+    int    fd;
+    size_t max;  // Max. frame size [bytes]
+    size_t slot; // Slot size [bytes]
+    size_t data; // Offset to first slot
+    size_t size; // Total size
+
+    if ( shm_ring || !slots )
+        return true;
+
+//  Largest frame is unbinned Mono16. Slots page aligned
+    max  = 2 * cam->SensorWidth * cam->SensorHeight;
+    slot = ( sizeof(shm_frm_t) + max       + SHM_ALIGN - 1 ) / SHM_ALIGN * SHM_ALIGN;
+    data = ( sizeof(shm_ring_t)            + SHM_ALIGN - 1 ) / SHM_ALIGN * SHM_ALIGN;
+    size = data + slots * slot;
+
+    snprintf( shm_name, sizeof(shm_name), SHM_NAME, cam_num+1 );
+    if (( fd = shm_open( shm_name, O_CREAT | O_RDWR, 0644 )) < 0 )
+        return mop_log( true, LOG_WRN, FAC, "shm_open(%s) %s. Frame ring disabled", shm_name, strerror(errno) );
+
+    if ( ftruncate( fd, size ) < 0 )
+    {
+        close( fd );
+        return mop_log( true, LOG_WRN, FAC, "ftruncate(%s) %s. Frame ring disabled", shm_name, strerror(errno) );
+    }
+
+    shm_ring = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if ( shm_ring == MAP_FAILED )
+    {
+        close( fd );
+        shm_ring = NULL;
+        return mop_log( true, LOG_WRN, FAC, "mmap(%s) %s. Frame ring disabled", shm_name, strerror(errno) );
+    }
+
+//  Zero everything so readers see empty slots, then mark ring valid last
+    memset( shm_ring, 0, data );
+    for ( int i = 0; i < slots; i++ )
+        memset( (char *)shm_ring + data + i * slot, 0, sizeof(shm_frm_t) );
+
+    shm_ring->version   = SHM_VERSION;
+    shm_ring->slots     = slots;
+    shm_ring->slot_size = slot;
+    shm_ring->frame_max = max;
+    shm_ring->data      = data;
+    shm_ring->size      = size;
+    __atomic_store_n( &shm_ring->magic, SHM_MAGIC, __ATOMIC_RELEASE );
+    shm_fd = fd;
+
+    return mop_log( true, LOG_INF, FAC, "Frame ring %s %i x %.1f MB", shm_name, slots, slot / TIM_MICROSECOND );
+}
+
+
+/** @brief      Remove the frame ring. Readers keep their mapping until they detach.
+  *
+  * @return     true
+  */
+bool shm_exit( void )
+{
+    if ( !shm_ring )
+        return true;
+
+    shm_ring->magic = 0;
+    munmap( shm_ring, shm_ring->size );
+    close( shm_fd );
+    shm_unlink( shm_name );
+    shm_ring = NULL;
+    shm_fd   = -1;
+
+    return true;
+}
+
+
+/** @brief      Publish a frame. Never blocks, the oldest slot is always overwritten
+  *
+  * @param[in] *cam   = pointer to camera info structure
+  * @param[in]  seq   = image sequence number within run
+  * @param[in] *name  = FITS file name for this frame
+  * @param[in] *pix   = Mono16 pixel data
+  * @param[in]  bytes = pixel data size
+  *
+  * @return     true | false = Success | Frame too large
+  */
+bool shm_put( mop_cam_t *cam, int seq, char *name, void *pix, size_t bytes )
+{
+    shm_frm_t *frm;
+    uint64_t   head;
+    uint64_t   lock;
+
+    if ( !shm_ring )
+        return true;
+
+    if ( bytes > shm_ring->frame_max )
+        return mop_log( false, LOG_ERR, FAC, "Frame %lu bytes > slot %lu", bytes, shm_ring->frame_max );
+
+    head = shm_ring->head; // Only this thread writes head
+    frm  = shm_slot( shm_ring, head );
+
+//  Odd lock = slot being written
+    lock = frm->lock;
+    __atomic_store_n( &frm->lock, lock + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+
+    frm->frame     = head;
+    shm_meta( frm, cam, seq, name, bytes );
+    memcpy( frm + 1, pix, bytes );
+
+//  Even lock = slot stable, then make frame visible
+    __atomic_store_n( &frm->lock, lock + 2, __ATOMIC_RELEASE );
+    __atomic_store_n( &shm_ring->head, head + 1, __ATOMIC_RELEASE );
+
+    return true;
+}
+
+
+/** @brief      Writer: Location of the most recently published slot, header and pixels, for sendfile().
+  *             The slot may be overwritten later so check the lock with shm_done() before relying on it.
+  *
+  * @param[in]  *name = FITS file name of frame wanted 
+  * @param[out] *fd   = ring descriptor
+  * @param[out] *off  = slot offset
+  * @param[out] *lock = slot lock value to pass to shm_done()
+  *
+  * @return      slot | NULL = Ring disabled or frame not last published 
+  */
+shm_frm_t *shm_last( char *name, int *fd, off_t *off, uint64_t *lock )
+{
+    shm_frm_t *frm;
+
+    if ( !shm_ring || !shm_ring->head )
+        return NULL;
+
+    frm  = shm_slot( shm_ring, shm_ring->head - 1 );
+    if ( strcmp( frm->name, name ) )
+        return NULL;
+
+    *fd   = shm_fd;
+    *off  = (char *)frm - (char *)shm_ring;
+    *lock = __atomic_load_n( &frm->lock, __ATOMIC_ACQUIRE );
+
+    return frm;
+}
+
+
+/** @brief      Fill a frame header from the camera structure 
+  *
+  * @param[out] *frm   = frame header 
+  * @param[in]  *cam   = pointer to camera info structure
+  * @param[in]   seq   = image sequence number within run
+  * @param[in]  *name  = FITS file name for this frame
+  * @param[in]   bytes = pixel data size
+  *
+  * @return      true 
+  */
+bool shm_meta( shm_frm_t *frm, mop_cam_t *cam, int seq, char *name, size_t bytes )
+{
+    frm->run       = fts_run;
+    frm->cam       = cam_num + 1;
+    frm->pfx       = fts_pfx;
+    frm->rot_n     = cam->RotN[seq];
+    frm->seq_n     = cam->SeqN[seq];
+    frm->width     = cam->Dimension[IMG_WIDTH];
+    frm->height    = cam->Dimension[IMG_HEIGHT];
+    frm->exp       = cam->ExpVal;
+    frm->rot_req   = cam->RotReq[seq];
+    frm->rot_ang   = cam->RotAng[seq];
+    frm->rot_end   = cam->RotEnd[seq];
+    frm->rot_dif   = cam->RotDif[seq];
+    frm->temp      = cam->SensorTemperature;
+    frm->clock     = cam->TimestampClock[seq];
+    frm->clock_frq = cam->TimestampClockFrequency;
+    frm->obs_start = cam->ObsStart;
+    frm->obs_end   = cam->ObsEnd;
+    frm->bytes     = bytes;
+    strncpy( frm->name, name ? name : "", sizeof(frm->name)-1 );
+
+    return true;
+}
+
+
+/** @brief      Reader: Map a frame ring read-only
+  *
+  * @param[in] *name = ring name, e.g. /mopnet1
+  *
+  * @return     mapped ring | NULL = Not available
+  */
+shm_ring_t *shm_attach( char *name )
+{
+    int    fd;
+    struct stat st;
+    shm_ring_t *ring;
+
+    if (( fd = shm_open( name, O_RDONLY, 0 )) < 0 )
+        return NULL;
+
+    if ( fstat( fd, &st ) < 0 || st.st_size < sizeof(shm_ring_t) )
+    {
+        close( fd );
+        return NULL;
+    }
+
+    ring = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if ( ring == MAP_FAILED )
+        return NULL;
+
+    if ( __atomic_load_n( &ring->magic, __ATOMIC_ACQUIRE ) != SHM_MAGIC ||
+         ring->version != SHM_VERSION || ring->size > st.st_size )
+    {
+        munmap( ring, st.st_size );
+        return NULL;
+    }
+
+    return ring;
+}
+
+
+/** @brief      Reader: Unmap a frame ring
+  *
+  * @param[in] *ring = mapped ring
+  *
+  * @return     true
+  */
+bool shm_detach( shm_ring_t *ring )
+{
+    munmap( ring, ring->size );
+
+    return true;
+}
+
+
+/** @brief      Reader: Get the next frame without copying. Frames lost to a slow reader are skipped.
+  *             Once finished with the frame call shm_done() to check it was not overwritten meanwhile.
+  *
+  * @param[in]     *ring   = mapped ring
+  * @param[in,out] *next   = next frame number wanted. Start at 0, advanced on return
+  * @param[out]    *lock   = slot lock value to pass to shm_done()
+  * @param[in,out] *missed = running count of frames skipped
+  *
+  * @return     frame | NULL = No new frame
+  */
+shm_frm_t *shm_next( shm_ring_t *ring, uint64_t *next, uint64_t *lock, uint64_t *missed )
+{
+    shm_frm_t *frm;
+    uint64_t   head;
+    uint64_t   oldest;
+
+    for(;;)
+    {
+        head = __atomic_load_n( &ring->head, __ATOMIC_ACQUIRE );
+        if ( *next >= head )
+            return NULL;
+
+//      Slot after head is next to be overwritten so skip any older frames
+        oldest = head > ring->slots ? head - ring->slots + 1 : 0;
+        if ( *next < oldest )
+        {
+            *missed += oldest - *next;
+            *next    = oldest;
+        }
+
+        frm   = shm_slot( ring, *next );
+        *lock = __atomic_load_n( &frm->lock, __ATOMIC_ACQUIRE );
+        if ( !( *lock & 1 ) && frm->frame == *next )
+        {
+            (*next)++;
+            return frm;
+        }
+
+//      Overwritten while looking, go round again
+        (*missed)++;
+        (*next)++;
+    }
+}
+
+
+/** @brief      Reader: Check a frame from shm_next() is still intact
+  *
+  * @param[in] *frm  = frame
+  * @param[in]  lock = lock value from shm_next()
+  *
+  * @return     true | false = Frame valid | Overwritten during use, discard results
+  */
+bool shm_done( shm_frm_t *frm, uint64_t lock )
+{
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+
+    return __atomic_load_n( &frm->lock, __ATOMIC_RELAXED ) == lock;
+}
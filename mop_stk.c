@@ -0,0 +1,190 @@
+/** @file   mop_stk.c
+  *
+  * @brief MOPTOP co-added stacks
+  *
+  *        Optional mode where frames taken at the same rotator position in every rotation are summed in memory.
+  *        There is one 32-bit accumulator per position. Only the img_cycle stacks are written, once the run ends,
+  *        so disk I/O drops by a factor of rot_revs. Each stack records its frame count, summed exposure and
+  *        the spread of rotator angles. Frames are still published to the shared memory ring as they arrive.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#include "mopnet.h"
+#define FAC FAC_STK
+
+static stk_pos_t  stk_pos[MAX_CYCLE];
+static uint32_t  *stk_acc = NULL;  // Accumulators for all positions
+static size_t     stk_cap = 0;     // Accumulator allocation [bytes]
+static bool       stk_on  = false; // Stacking this run
+
+/** @brief      Add Mono16 pixels to a 32-bit accumulator.
+  *             Plain loop on aligned, non-aliased data so the compiler vectorises it for the build target
+  *
+  * @param[out] *acc = accumulator, STK_ALIGN aligned
+  * @param[in]  *pix = Mono16 pixels, 16 byte aligned
+  * @param[in]   n   = pixel count
+  */
+static void stk_sum16( uint32_t *restrict acc, const uint16_t *restrict pix, size_t n )
+{
+    uint32_t       *a = __builtin_assume_aligned( acc, STK_ALIGN );
+    const uint16_t *p = __builtin_assume_aligned( pix, 16 );
+
+    for ( size_t i = 0; i < n; i++ )
+        a[i] += p[i];
+}
+
+
+/** @brief      Allocate and clear accumulators for this run. Allocation only grows.
+  *             Failure is not fatal, frames are written individually instead.
+  *
+  * @param[in] *cam = pointer to camera info structure, configured
+  *
+  * @return     true
+  */
+bool stk_init( mop_cam_t *cam )
+{
+    size_t num;  // Accumulator elements per position, padded to alignment
+    size_t size; // Total [bytes]
+
+    stk_on = false;
+    if ( !img_stk )
+        return true;
+
+    if ( rot_revs > UINT32_MAX / UINT16_MAX )
+        return mop_log( true, LOG_WRN, FAC, "%i rotations may overflow stacks. Writing frames", rot_revs );
+
+    num  = ( img_mono16size * sizeof(uint32_t) + STK_ALIGN - 1 ) / STK_ALIGN * STK_ALIGN / sizeof(uint32_t);
+    size = num * img_cycle * sizeof(uint32_t);
+    if ( size > stk_cap )
+    {
+        free( stk_acc );
+        stk_cap = 0;
+        if ( !( stk_acc = aligned_alloc( STK_ALIGN, size )))
+            return mop_log( true, LOG_WRN, FAC, "aligned_alloc(%.1f MB) %s. Writing frames", size / TIM_MICROSECOND, strerror(errno) );
+        stk_cap = size;
+    }
+
+    memset( stk_acc, 0, size );
+    memset( stk_pos, 0, sizeof(stk_pos) );
+    for ( int i = 0; i < img_cycle; i++ )
+        stk_pos[i].sum = stk_acc + i * num;
+
+    stk_on = true;
+    return mop_log( true, LOG_INF, FAC, "Stacking %i positions x %i rotations. %.1f MB", img_cycle, rot_revs, size / TIM_MICROSECOND );
+}
+
+
+/** @brief      Add an acquired frame to the stack for its position
+  *
+  * @param[in] *cam = pointer to camera info structure
+  * @param[in]  seq = image sequence number within run
+  * @param[in]  buf = index to buffer containing image
+  *
+  * @return     true | false = Added | Not stacking, write the frame instead
+  */
+bool stk_add( mop_cam_t *cam, int seq, int buf )
+{
+    stk_pos_t *p;
+    AT_U8     *pix;
+    double     d;
+
+    if ( !stk_on )
+        return false;
+
+    pix = fts_mono16( cam, buf );
+    shm_put( cam, seq, "", pix, 2 * img_mono16size );
+    lib_add( pix );
+
+    p = &stk_pos[ cam->SeqN[seq] - 1 ];
+    stk_sum16( p->sum, (uint16_t *)pix, img_mono16size );
+
+//  Angles as offsets from first frame so statistics survive wrapping through 0
+    if ( !p->num )
+    {
+        p->req       = fmod( cam->RotReq[seq], 360.0 );
+        p->ang       = cam->RotAng[seq];
+        p->end       = cam->RotEnd[seq];
+        p->obs_start = cam->ObsStart;
+    }
+    d = remainder( cam->RotAng[seq] - p->ang, 360.0 );
+    p->ang_sum += d;
+    p->ang_sq  += d * d;
+    d = remainder( cam->RotEnd[seq] - p->end, 360.0 );
+    p->end_sum += d;
+    p->end_sq  += d * d;
+    p->arc_sum += cam->RotDif[seq];
+    p->exp     += cam->ExpVal;
+    p->obs_end  = cam->ObsEnd;
+    p->num++;
+
+    return true;
+}
+
+
+/** @brief      Note a frame missed by the acquisition. Its position's stack just has one frame fewer
+  *
+  * @return     true | false = Stacking | Not stacking, report the gap as the frame would have been
+  */
+bool stk_gap( void )
+{
+    return stk_on;
+}
+
+
+/** @brief      Write one file per position and pass each name on as individual frames would be.
+  *             An empty position writes no file but is still passed on, as img_note() with zero
+  *             statistics and EMPTY, so mopcmd gets one note per position.
+  *
+  * @param[in] *cam = pointer to camera info structure
+  *
+  * @return     true | false = Success | Failure
+  */
+bool stk_write( mop_cam_t *cam )
+{
+    char *name;
+    char  note[MSG_LEN];
+    int   next   = FTS_STACK;
+    int   frames = 0;
+    int   empty  = 0;
+    bool  ok     = true;
+    int   len;
+    int   src    = cam->SrcN;
+    img_sta_t sta = cam->Sta;   // Last frame's, restored after each empty note
+    struct timespec beg;
+    struct timespec end;
+
+    if ( !stk_on )
+        return true;
+
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    cam->seq = 0;
+    for ( int i = 0; i < img_cycle; i++ )
+    {
+        name = fts_mkname( cam, fts_pfx, &next );
+        if ( !stk_pos[i].num )
+        {
+            ok = mop_log( false, LOG_WRN, FAC, "Position %i empty. Not written", i+1 );
+            memset( &cam->Sta, 0, sizeof(cam->Sta) );
+            cam->SrcN = -1;
+            len = img_note( note, sizeof(note), name, cam );
+            snprintf( note + len, sizeof(note) - len, " EMPTY" );
+            cam->Sta  = sta;
+            cam->SrcN = src;
+            msg_send( 0, note, ipcommand, NULL, 0 );
+            empty++;
+            continue;
+        }
+        ok = fts_stack( name, cam, &stk_pos[i], i ) && ok;
+        msg_send( 0, name, ipcommand, NULL, 0 );
+        frames += stk_pos[i].num;
+    }
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    stk_on = false;
+
+    return mop_log( ok, LOG_INF, FAC, "Stacked %i frames into %i files, %i positions empty, in %.3fs. %.1f MB written, not %.1f MB",
+                    frames, img_cycle - empty, empty, utl_ts_dif( &end, &beg ),
+                    ( img_cycle - empty ) * 4.0 * img_mono16size / MEM_MB, frames * 2.0 * img_mono16size / MEM_MB );
+}
@@ -0,0 +1,288 @@
+/** @file   mop_trg.c
+  *
+  * @brief MOPTOP trigger timing diagnostics
+  *
+  *        Each camera keeps the detector timestamp of every frame of a run, counted from cam_clk_rst().
+  *        At the end of the run the frame periods give the nominal period, the jitter at each rotator position
+  *        and any missed triggers, seen as a period of about twice nominal or more. When the master pairs frames
+  *        (-G) the slave's timestamps arrive with its frames. Slave time is fitted against master time, which
+  *        absorbs the clock reset offset and any clock rate difference, and the residuals are the inter-camera
+  *        skew. A pair more than half a period apart is a trigger seen by only one camera. The summary is logged
+  *        and the full report written to TRG_FILE in the data directory.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#include "mopnet.h"
+#define FAC FAC_TRG
+
+static double trg_t  [MAX_IMAGES]; // [s] Frame timestamps this run
+static int    trg_pos[MAX_IMAGES]; // Rotator position of frame
+static bool   trg_got[MAX_IMAGES]; // Frame acquired
+static int    trg_n   = 0;         // Frames, highest index + 1
+static int    trg_run = -1;        // Run of frames and pairs. -1 = Not started
+
+static double trg_mst[MAX_IMAGES]; // [s] Master timestamp of pair
+static double trg_slv[MAX_IMAGES]; // [s] Slave timestamp of pair
+static int    trg_ppos[MAX_IMAGES];// Position of pair
+static int    trg_np  = 0;         // Pairs
+static pthread_mutex_t trg_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/** @brief      Compare doubles for qsort()
+  *
+  * @param[in]  *a = value
+  * @param[in]  *b = value
+  *
+  * @return     <0 | 0 | >0 = a < b | a == b | a > b
+  */
+static int trg_cmp( const void *a, const void *b )
+{
+    double d = *(const double *)a - *(const double *)b;
+
+    return ( d > 0.0 ) - ( d < 0.0 );
+}
+
+
+/** @brief      Fit slave = a + b x master, both times relative to the first master timestamp.
+  *             Call locked.
+  *
+  * @param[in]      np  = pairs
+  * @param[in]      lim = [s] use only pairs with residual from a and b within this. -ve = Use all
+  * @param[in,out] *a   = [s] offset
+  * @param[in,out] *b   = rate
+  */
+static void trg_fit( int np, double lim, double *a, double *b )
+{
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0, x, y, d;
+    int    n  = 0;
+
+    for ( int i = 0; i < np; i++ )
+    {
+        x = trg_mst[i] - trg_mst[0];
+        y = trg_slv[i] - trg_mst[0];
+        if ( lim >= 0.0 && fabs( y - *a - *b * x ) > lim )
+            continue;
+        sx  += x;
+        sy  += y;
+        sxx += x * x;
+        sxy += x * y;
+        n++;
+    }
+    if ( !n )
+        return;
+
+    d  = n * sxx - sx * sx;
+    *b = d > 0.0 ? ( n * sxy - sx * sy ) / d : 1.0;
+    *a = ( sy - *b * sx ) / n;
+}
+
+
+/** @brief      Start collecting for a run. Call after the run is set up
+  *
+  * @return     true
+  */
+bool trg_init( void )
+{
+    pthread_mutex_lock( &trg_mtx );
+    memset( trg_got, 0, sizeof(trg_got) );
+    trg_n   = 0;
+    trg_np  = 0;
+    trg_run = -1;
+    pthread_mutex_unlock( &trg_mtx );
+
+    return true;
+}
+
+
+/** @brief      Record timestamp of an acquired frame
+  *
+  * @param[in] *cam = pointer to camera info structure
+  * @param[in]  seq = image sequence number within run
+  */
+void trg_add( mop_cam_t *cam, int seq )
+{
+    if ( seq < 0 || seq >= MAX_IMAGES || !cam->TimestampClockFrequency )
+        return;
+
+    if ( trg_run < 0 )
+    {
+        pthread_mutex_lock( &trg_mtx );
+        trg_run = fts_run;
+        pthread_mutex_unlock( &trg_mtx );
+    }
+
+    trg_t  [seq] = (double)cam->TimestampClock[seq] / cam->TimestampClockFrequency;
+    trg_pos[seq] = cam->SeqN[seq];
+    trg_got[seq] = true;
+    if ( seq >= trg_n )
+        trg_n = seq + 1;
+}
+
+
+/** @brief      Record timestamps of a master and slave frame pair. Called from either pairing side
+  *
+  * @param[in] *mst = master frame header
+  * @param[in] *slv = slave frame header
+  */
+void trg_pair( shm_frm_t *mst, shm_frm_t *slv )
+{
+    if ( !mst->clock_frq || !slv->clock_frq )
+        return;
+
+    pthread_mutex_lock( &trg_mtx );
+    if ( mst->run == trg_run && trg_np < MAX_IMAGES )
+    {
+        trg_mst [trg_np] = (double)mst->clock / mst->clock_frq;
+        trg_slv [trg_np] = (double)slv->clock / slv->clock_frq;
+        trg_ppos[trg_np] = mst->seq_n;
+        trg_np++;
+    }
+    pthread_mutex_unlock( &trg_mtx );
+}
+
+
+/** @brief      Summarise the run's timing, log it and write the report
+  *
+  * @param[in] *cam = pointer to camera info structure
+  *
+  * @return     true | false = Clean | Missed triggers, lost frames, skew outliers or failure
+  */
+bool trg_done( mop_cam_t *cam )
+{
+    static double per[MAX_IMAGES];  // Periods, sorted
+    static double abs_res[MAX_IMAGES]; // Skew residuals, sorted
+    char   name[MAX_STR];
+    FILE  *fp;
+    double dev_sum[MAX_CYCLE+1] = {0.0};
+    double dev_sq [MAX_CYCLE+1] = {0.0};
+    double dev_max[MAX_CYCLE+1] = {0.0};
+    int    dev_num[MAX_CYCLE+1] = {0};
+    double skw_sum[MAX_CYCLE+1] = {0.0};
+    double skw_sq [MAX_CYCLE+1] = {0.0};
+    int    skw_num[MAX_CYCLE+1] = {0};
+    double nom, d, jit = 0.0;
+    double mean = 0.0, p99 = 0.0, max = 0.0;
+    double a = 0.0, b = 1.0;
+    int    np, nd = 0, nj = 0, got = 0, miss = 0, lost = 0, odd = 0;
+    int    p, k;
+    bool   ok;
+
+    if ( trg_run < 0 || !trg_n )
+        return true;
+
+//  Nominal period is the median of consecutive frame periods
+    for ( int i = 0; i < trg_n; i++ )
+    {
+        got += trg_got[i];
+        if ( i && trg_got[i] && trg_got[i-1] )
+            per[nd++] = trg_t[i] - trg_t[i-1];
+    }
+    lost = img_total - got;
+    if ( !nd )
+        return mop_log( true, LOG_INF, FAC, "Run %i. %i frame. No periods", trg_run, got );
+    qsort( per, nd, sizeof(double), trg_cmp );
+    nom = per[nd/2];
+
+//  Deviation from nominal by position. A period of 2 or more nominal hides missed triggers
+    for ( int i = 1; i < trg_n; i++ )
+    {
+        if ( !trg_got[i] || !trg_got[i-1] )
+            continue;
+        d = trg_t[i] - trg_t[i-1];
+        if ( nom > 0.0 && ( k = lround( d / nom ) - 1 ) > 0 )
+        {
+            miss += k;
+            mop_log( false, LOG_WRN, FAC, "Run %i frame %i. Period %.6fs = %i missed trigger%s",
+                     trg_run, i+1, d, k, k > 1 ? "s" : "" );
+            continue;
+        }
+        d -= nom;
+        p  = trg_pos[i] <= MAX_CYCLE ? trg_pos[i] : 0;
+        dev_sum[p] += d;
+        dev_sq [p] += d * d;
+        dev_max[p]  = fmax( dev_max[p], fabs( d ));
+        dev_num[p]++;
+        jit += d * d;
+        nj++;
+    }
+    jit = nj ? sqrt( jit / nj ) : 0.0;
+
+//  Slave against master clock fitted by least squares, residuals are the skew.
+//  Refitted without pairs far off the first fit so a few bad pairs do not bias the rest
+    pthread_mutex_lock( &trg_mtx );
+    np = trg_np;
+    if ( np >= 2 )
+    {
+        trg_fit( np, -1.0, &a, &b );
+        for ( int i = 0; i < np; i++ )
+            abs_res[i] = fabs( trg_slv[i] - trg_mst[0] - a - b * ( trg_mst[i] - trg_mst[0] ));
+        qsort( abs_res, np, sizeof(double), trg_cmp );
+        trg_fit( np, fmax( TRG_CLIP * abs_res[np/2], TRG_CLIP_MIN ), &a, &b );
+
+        for ( int i = 0; i < np; i++ )
+        {
+            d          = trg_slv[i] - trg_mst[0] - a - b * ( trg_mst[i] - trg_mst[0] );
+            abs_res[i] = fabs( d );
+            mean      += abs_res[i] / np;
+            odd       += abs_res[i] > 0.5 * nom;
+            p = trg_ppos[i] <= MAX_CYCLE ? trg_ppos[i] : 0;
+            skw_sum[p] += d;
+            skw_sq [p] += d * d;
+            skw_num[p]++;
+        }
+        qsort( abs_res, np, sizeof(double), trg_cmp );
+        p99 = abs_res[ (int)ceil( 0.99 * np ) - 1 ];
+        max = abs_res[ np - 1 ];
+    }
+    pthread_mutex_unlock( &trg_mtx );
+
+    ok = !miss && !lost && !odd;
+    if ( np >= 2 )
+        mop_log( ok, ok ? LOG_INF : LOG_WRN, FAC, "Run %i. %i/%i frames. Period %.6fs jitter %.1fus. %i missed. "
+                 "Skew %i pairs mean %.1fus p99 %.1fus max %.1fus. %i apart",
+                 trg_run, got, img_total, nom, jit * TIM_MICROSECOND, miss,
+                 np, mean * TIM_MICROSECOND, p99 * TIM_MICROSECOND, max * TIM_MICROSECOND, odd );
+    else
+        mop_log( ok, ok ? LOG_INF : LOG_WRN, FAC, "Run %i. %i/%i frames. Period %.6fs jitter %.1fus. %i missed",
+                 trg_run, got, img_total, nom, jit * TIM_MICROSECOND, miss );
+
+//  Report
+    snprintf( name, sizeof(name), TRG_FILE, fts_dir, cam->id, fts_pfx, trg_run );
+    if ( !( fp = fopen( name, "w" )))
+        return mop_log( false, LOG_SYS, FAC, "fopen(%s) %s", name, strerror(errno) );
+
+    fprintf( fp, "# MOPTOP trigger timing %s. Camera %i serial %ls run %i\n", MOP_VERSION, cam_num+1, cam->SerialNumber, trg_run );
+    fprintf( fp, "frames %i of %i, lost %i\n", got, img_total, lost );
+    fprintf( fp, "period %.9f s, jitter rms %.3f us, missed triggers %i\n", nom, jit * TIM_MICROSECOND, miss );
+    if ( np >= 2 )
+    {
+        fprintf( fp, "pairs %i, slave = %.9f s + %.9f x master, from first master timestamp\n", np, a, b );
+        fprintf( fp, "skew mean %.3f us, p99 %.3f us, max %.3f us, over half a period %i\n",
+                 mean * TIM_MICROSECOND, p99 * TIM_MICROSECOND, max * TIM_MICROSECOND, odd );
+    }
+    fprintf( fp, "# Pos Periods Mean[us] Rms[us] Max[us] Pairs Skew[us] SkewRms[us]\n" );
+    for ( p = 1; p <= MAX_CYCLE; p++ )
+    {
+        if ( !dev_num[p] && !skw_num[p] )
+            continue;
+        fprintf( fp, "%4i %7i %8.3f %7.3f %7.3f %5i %8.3f %11.3f\n", p, dev_num[p],
+                 dev_num[p] ? dev_sum[p] / dev_num[p] * TIM_MICROSECOND : 0.0,
+                 dev_num[p] ? sqrt( dev_sq[p] / dev_num[p] ) * TIM_MICROSECOND : 0.0,
+                 dev_max[p] * TIM_MICROSECOND, skw_num[p],
+                 skw_num[p] ? skw_sum[p] / skw_num[p] * TIM_MICROSECOND : 0.0,
+                 skw_num[p] ? sqrt( skw_sq[p] / skw_num[p] ) * TIM_MICROSECOND : 0.0 );
+    }
+    if ( lost )
+    {
+        fprintf( fp, "# Gap Rot Pos\n" );
+        for ( int i = 0; i < img_total && i < MAX_IMAGES; i++ )
+            if ( !trg_got[i] )
+                fprintf( fp, "%5i %3i %3i\n", i+1, 1 + i / img_cycle, 1 + i % img_cycle );
+    }
+    fclose( fp );
+
+    trg_run = -1;
+    return ok;
+}
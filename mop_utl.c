@@ -8,6 +8,7 @@
   */
 
 #include "mopnet.h"
+#define FAC FAC_UTL
 
 /** @brief     Convert a decimal time [sec] to timespec
   *
@@ -200,3 +201,114 @@ bool utl_chk_ip( char *ip )
     return ((5==sscanf(ip,"%u.%u.%u.%u:%u%c",&h[0],&h[1],&h[2],&h[3],&p,&c))&&  // Must be 5 fields
             (h[0] <256 && h[1] <256 && h[2] <256 && h[3] <256 && p <65535  )  );// Within limits
 }
+
+
+/** @brief     Thread wrapper for utl_task_run(). Calls task function and timestamps completion
+  *
+  * @param[in] *arg = pointer to task structure 
+  *
+  * @return    NULL 
+  */
+static void *utl_task_thread( void *arg )
+{
+    mop_task_t *task = arg;
+
+    task->ok = task->fn();
+    clock_gettime( CLOCK_MONOTONIC, &task->end );
+
+    return NULL;
+}
+
+
+/** @brief     Start a function running concurrently as a task
+  *
+  * @param[in] *task = pointer to task structure 
+  * @param[in] *name = task name used for logging
+  * @param[in] *fn   = task function returning true | false
+  *
+  * @return    true | false = Success | Failure 
+  */
+bool utl_task_run( mop_task_t *task, char *name, bool (*fn)(void) )
+{
+    task->name = name;
+    task->fn   = fn;
+    task->ok   = false;
+    clock_gettime( CLOCK_MONOTONIC, &task->beg );
+
+    if ( pthread_create( &task->thread, NULL, utl_task_thread, task ) )
+    {
+//      Could not start thread so run in-line instead
+        mop_log( false, LOG_WRN, FAC, "pthread_create(%s) %s. Running in-line", name, strerror(errno) );
+        utl_task_thread( task );
+        task->busy = false;
+    }
+    else
+    {
+        task->busy = true;
+    }
+
+    return true;
+}
+
+
+/** @brief     Wait for a task to complete. Safe to call more than once. 
+  *
+  * @param[in] *task = pointer to task structure 
+  *
+  * @return    true | false = Task function result  
+  */
+bool utl_task_wait( mop_task_t *task )
+{
+    if ( task->busy )
+    {
+        pthread_join( task->thread, NULL );
+        task->busy = false;
+        mop_log( task->ok, LOG_DBG, FAC, "Task %s done in %.3fs", task->name, utl_task_dur( task ) ); 
+    }
+
+    return task->ok;
+}
+
+
+/** @brief     Get task run time. Only valid after utl_task_wait()
+  *
+  * @param[in] *task = pointer to task structure 
+  *
+  * @return    Run time [sec]
+  */
+double utl_task_dur( mop_task_t *task )
+{
+    return utl_ts_dif( &task->end, &task->beg );
+}
+
+
+/** @brief     Difference between two timespec values t1 - t2 as decimal seconds. 
+  *            Unlike utl_ts_sub() a negative difference is allowed.
+  *
+  * @param[in] *t1 = time 1
+  * @param[in] *t2 = time 2
+  *
+  * @return    t1 - t2 [sec]
+  */
+double utl_ts_dif( struct timespec *t1, struct timespec *t2 )
+{
+    return (t1->tv_sec - t2->tv_sec) + (t1->tv_nsec - t2->tv_nsec) / (double)TIM_NANOSECOND;
+}
+
+
+/** @brief     Sleep until an absolute time. 
+  *            CLOCK_REALTIME so that NTP synchronised hosts agree on the time.
+  *
+  * @param[in] *t = wake-up time
+  *
+  * @return    Lateness [sec]. Negative = Woke early (interrupted) 
+  */
+double utl_ts_sleep( struct timespec *t )
+{
+    struct timespec now;
+
+    while ( clock_nanosleep( CLOCK_REALTIME, TIMER_ABSTIME, t, NULL ) == EINTR );
+    clock_gettime( CLOCK_REALTIME, &now );
+
+    return utl_ts_dif( &now, t );
+}
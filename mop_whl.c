@@ -10,7 +10,16 @@
 #include "mopnet.h"
 #define FAC FAC_WHL
 
+// Filter wheel move state. Position 0 = unknown
+static int whl_now = 0;          //!< Last position confirmed by filter wheel
+static int whl_req = 0;          //!< Requested position of move in progress
+static bool whl_out = false;     //!< Request posted by whl_move() not yet confirmed
+static struct timespec whl_beg;  //!< Time move was requested
+
 /** @brief     Init. filter wheel interface  
+  *
+  *            A pty is accepted as a stand-in wheel for timing tests, put in raw mode so requests and 
+  *            replies pass unchanged. Any other device that is not hidraw is rejected.
   *
   * @param[in] pos     = position to move to 
   * @param[in] timeout = timeout [ms] 
@@ -20,22 +29,34 @@
 bool whl_init( int pos, int timeout )
 {
     char buf[256];
+    struct termios tio;
 
-    whl_fd = open( whl_dev, O_RDWR|O_NONBLOCK );
+    whl_now = 0;
+    if ( (whl_fd = open( whl_dev, O_RDWR|O_NONBLOCK|O_NOCTTY )) < 0 )
+        return mop_log( false, LOG_ERR, FAC, "open(%s) %s", whl_dev, strerror(errno) );
 
-    if ( ioctl( whl_fd, HIDIOCGRAWNAME(256), buf ) < 0 )
+    if ( ioctl( whl_fd, HIDIOCGRAWNAME(256), buf ) >= 0 )
     {
-        return mop_log( false, LOG_ERR, FAC, "whl_init()" );
+        mop_log( true,  LOG_DBG, FAC, "Filter wheel name = %s", buf );
     }
-    else
+    else if ( !tcgetattr( whl_fd, &tio ) )
     {
-        mop_log( true,  LOG_DBG, FAC, "Filter wheel name = %s", buf );
-        return whl_conf( pos, timeout );
+        cfmakeraw( &tio );
+        tcsetattr( whl_fd, TCSANOW, &tio );
+        mop_log( true, LOG_WRN, FAC, "%s is a pty not hidraw. Using as stand-in filter wheel", whl_dev );
     }
+    else 
+    {
+        close( whl_fd );
+        whl_fd = -1;
+        return mop_log( false, LOG_ERR, FAC, "whl_init() %s is not a filter wheel", whl_dev );
+    }
+
+    return whl_conf( pos, timeout );
 }
 
 
-/** @brief     Set filter wheel position  
+/** @brief     Set filter wheel position and wait for completion
   *
   * @param[in] pos     = position to move to 
   * @param[in] timeout = timeout [ms] 
@@ -43,32 +64,96 @@ bool whl_init( int pos, int timeout )
   * @return    true | false = Success | Failure 
   */
 bool whl_conf( int pos, int timeout )
+{
+    return whl_move( pos ) && whl_wait( timeout );
+}
+
+
+/** @brief     Request filter wheel position. Does not wait for completion, see whl_wait() 
+  *
+  * @param[in] pos = position to move to 
+  *
+  * @return    true | false = Success | Failure 
+  */
+bool whl_move( int pos )
 {
     char wbuf[2] = {pos,0}; // Write buffer contains request position
-    char rbuf[2] = {0,  0}; // Read buffer indicates actual pos. or moving=0
+    char rbuf[2];
+
+    whl_req = pos;
+    whl_out = false;
+    clock_gettime( CLOCK_MONOTONIC, &whl_beg );
+
+//  No wheel, e.g. darkroom
+    if ( whl_fd < 0 )
+        return mop_log( false, LOG_WRN, FAC, "No filter wheel. whl_move(pos=%i) not posted", pos );
+
+//  Already in position so nothing to do
+    if ( whl_now == pos )
+        return mop_log( true, LOG_DBG, FAC, "Filter wheel already = %i", pos );
+
+//  Discard any stale replies before posting request 
+    while ( read( whl_fd, rbuf, sizeof(rbuf) ) > 0 );
+
+    whl_now = 0;
+    if ( 2 != write( whl_fd, wbuf, 2 ) )
+        return mop_log( false, LOG_ERR, FAC, "whl_move(pos=%i)", pos );
+
+    whl_out = true;
+    return true;
+}
+
+
+/** @brief     Wait for a filter wheel move started by whl_move() to complete.   
+  *            Replies are awaited using poll() and the position re-requested while moving.
+  *            Returns at once if there is no wheel or no request outstanding.
+  *
+  * @param[in] timeout = timeout [ms] 
+  *
+  * @return    true | false = Success | Failure 
+  */
+bool whl_wait( int timeout )
+{
+    char wbuf[2] = {whl_req,0}; // Write buffer contains request position
+    char rbuf[2] = {0,  0};     // Read buffer indicates actual pos. or moving=0
+    int  tick    = 10;          // [ms] Minimum time between requests as response is slow
     int  res;
+    int  ms;                    // [ms] Time since move requested 
 
-    int tick  = 10000;      // 10ms tick. Longer than usual as response is slow
-    int count = TIM_MICROSECOND * timeout / tick; // Timer count
+    struct pollfd   pfd = { .fd = whl_fd, .events = POLLIN };
+    struct timespec now;
     
-    do 
+    if ( !whl_out )
+        return whl_fd >= 0 && whl_now && whl_now == whl_req;
+    whl_out = false;
+
+    do
     {
-//      Post a request to get position
-        if ( 2 != write( whl_fd, wbuf, 2 ) )
-            return mop_log( false, LOG_ERR, FAC, "whl_set(pos=%i)", pos );
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        ms = TIM_MILLISECOND * utl_ts_dif( &now, &whl_beg );
 
-//      Wait at least 2ms before checking response 
-        usleep(tick);
+//      Wait for a reply 
+        res = poll( &pfd, 1, MAX( 0, timeout - ms ) );
+        if ( res < 0 && errno != EINTR )
+            return mop_log( false, LOG_SYS, FAC, "poll() %s", strerror(errno) );
+        else if ( res <= 0 )
+            continue;
 
 //      Read position in rbuf[0], 0=moving
-        res = read( whl_fd, rbuf, 2 );
-        if (( 2   ==  res    )&&  // Read completed
-            ( pos == rbuf[0] )  ) // Reached position
+        if (( 2 == read( whl_fd, rbuf, 2 ) )&&  // Read completed
+            ( whl_req == rbuf[0]           )  ) // Reached position
         {
-            return mop_log( true, LOG_DBG, FAC, "Filter wheel = %i", pos );
+            whl_now = whl_req;
+            clock_gettime( CLOCK_MONOTONIC, &now );
+            return mop_log( true, LOG_DBG, FAC, "Filter wheel = %i in %.3fs", whl_now, utl_ts_dif( &now, &whl_beg ));
         } 
+
+//      Still moving so post another request
+        usleep( tick * TIM_TICK );
+        if ( 2 != write( whl_fd, wbuf, 2 ) )
+            return mop_log( false, LOG_ERR, FAC, "whl_wait(pos=%i)", whl_req );
     }
-    while ( count-- );
+    while ( ms < timeout );
          
-    return mop_log( false, LOG_ERR, FAC, "TIMEOUT: whl_set(pos=%i timout=%i)", pos, timeout );
+    return mop_log( false, LOG_ERR, FAC, "TIMEOUT: whl_wait(pos=%i timout=%i)", whl_req, timeout );
 }
@@ -0,0 +1,515 @@
+/** @file   mop_xfr.c
+  *
+  * @brief MOPTOP frame transfer and pairing
+  *
+  *        Optional mode where the slave streams each frame, header and Mono16 pixels, to the master over TCP.
+  *        The master matches slave frames with its own by run, rotation and position number and writes a
+  *        paired product holding both images. Slave frames are queued to a sender thread, so acquisition 
+  *        never waits on the network, and dropped if the queue is full. The sender sends straight from the 
+  *        shared memory frame ring with sendfile() when the ring is enabled, otherwise from a copy of the frame.
+  *        Completed pairs are queued to a writer thread so neither acquisition nor the receive thread waits
+  *        on the disk.
+  *
+  * @author asp
+  *
+  * @date   2026-10-18
+  */
+
+#include "mopnet.h"
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+#define FAC FAC_XFR
+
+#define XFR_MINE   0 // Pending frame from this (master) camera
+#define XFR_PEER   1 // Pending frame from slave camera
+
+#define XFR_FREE   0 // Pending slot states
+#define XFR_FILL   1
+#define XFR_FULL   2
+#define XFR_BUSY   3
+
+/// Frame waiting for its pair
+typedef struct xfr_pend_s
+{
+    shm_frm_t hdr;             //!< Frame header
+    AT_U8    *pix;             //!< Mono16 pixel data
+    int       state;           //!< XFR_FREE, FILL, FULL or BUSY
+    uint64_t  age;             //!< Arrival order, oldest evicted first
+    shm_frm_t *frm;            //!< Slave: ring slot to send from. NULL = send hdr and pix 
+    int       fd;              //!< Slave: ring descriptor
+    off_t     off;             //!< Slave: ring slot offset
+    uint64_t  lock;            //!< Slave: ring slot lock when queued
+} xfr_pend_t;
+
+static xfr_pend_t xfr_pend[2][XFR_PEND];
+static uint64_t   xfr_age = 0;
+static size_t     xfr_max = 0;    // Max. pixel data [bytes]
+static int        xfr_fd  = -1;   // Slave: connection to master. Master: listening socket
+static pthread_t  xfr_thread;
+static pthread_t  xfr_writer;   // Master: pair writer. Slave: frame sender
+static pthread_mutex_t xfr_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  xfr_cnd = PTHREAD_COND_INITIALIZER;
+
+// Completed pairs awaiting the writer. Each holds a busy XFR_MINE slot so cannot overflow.
+// Slave frames awaiting the sender use the XFR_PEER side 
+static xfr_pend_t *xfr_que[XFR_PEND][2];
+static int         xfr_head = 0;
+static int         xfr_num  = 0;
+
+/** @brief      Get a pending slot to fill. Evicts oldest unpaired frame if none free. Call locked.
+  *
+  * @param[in]  side = XFR_MINE | XFR_PEER
+  *
+  * @return     slot | NULL = All slots busy
+  */
+static xfr_pend_t *xfr_slot( int side )
+{
+    xfr_pend_t *old = NULL;
+    xfr_pend_t *p;
+
+    for ( int i = 0; i < XFR_PEND; i++ )
+    {
+        p = &xfr_pend[side][i];
+        if ( p->state == XFR_FREE )
+            return p;
+        if ( p->state == XFR_FULL && ( !old || p->age < old->age ))
+            old = p;
+    }
+
+    if ( old )
+        mop_log( false, LOG_WRN, FAC, "Unpaired camera %i frame run %i rot %i pos %i dropped",
+                 old->hdr.cam, old->hdr.run, old->hdr.rot_n, old->hdr.seq_n );
+
+    return old;
+}
+
+
+/** @brief      Frame now complete. If its pair is waiting queue both for the writer thread.
+  *
+  * @param[in] *p    = completed slot
+  * @param[in]  side = XFR_MINE | XFR_PEER
+  */
+static void xfr_done( xfr_pend_t *p, int side )
+{
+    xfr_pend_t *q = NULL;
+    int         n;
+
+    pthread_mutex_lock( &xfr_mtx );
+    p->state = XFR_FULL;
+    p->age   = xfr_age++;
+    for ( int i = 0; i < XFR_PEND && !q; i++ )
+    {
+        q = &xfr_pend[!side][i];
+        if ( q->state != XFR_FULL        ||
+             q->hdr.run   != p->hdr.run   ||
+             q->hdr.rot_n != p->hdr.rot_n ||
+             q->hdr.seq_n != p->hdr.seq_n   )
+            q = NULL;
+    }
+
+    if ( q )
+    {
+        p->state = q->state = XFR_BUSY;
+        n = ( xfr_head + xfr_num++ ) % XFR_PEND;
+        xfr_que[n][ side] = p;
+        xfr_que[n][!side] = q;
+        pthread_cond_signal( &xfr_cnd );
+    }
+    pthread_mutex_unlock( &xfr_mtx );
+}
+
+
+/** @brief      Master writer thread. Writes each queued pair as a paired product, adds it to the 
+  *             polarimetry accumulators and frees both slots
+  *
+  * @param[in] *arg = unused
+  *
+  * @return     NULL
+  */
+static void *xfr_write( void *arg )
+{
+    xfr_pend_t *mine;
+    xfr_pend_t *peer;
+
+    for(;;)
+    {
+        pthread_mutex_lock( &xfr_mtx );
+        while ( !xfr_num )
+            pthread_cond_wait( &xfr_cnd, &xfr_mtx );
+        mine = xfr_que[xfr_head][XFR_MINE];
+        peer = xfr_que[xfr_head][XFR_PEER];
+        xfr_head = ( xfr_head + 1 ) % XFR_PEND;
+        xfr_num--;
+        pthread_mutex_unlock( &xfr_mtx );
+
+        trg_pair( &mine->hdr, &peer->hdr );
+        fts_pair( &mine->hdr, mine->pix, &peer->hdr, peer->pix );
+        pol_add ( &mine->hdr, mine->pix, &peer->hdr, peer->pix );
+
+        pthread_mutex_lock( &xfr_mtx );
+        mine->state = peer->state = XFR_FREE;
+        pthread_mutex_unlock( &xfr_mtx );
+    }
+
+    return NULL;
+}
+
+
+/** @brief      Read exactly len bytes from a socket
+  *
+  * @param[in]  fd  = socket
+  * @param[out] buf = buffer
+  * @param[in]  len = bytes to read
+  *
+  * @return     true | false = Success | Connection closed or error
+  */
+static bool xfr_read( int fd, void *buf, size_t len )
+{
+    ssize_t n;
+
+    for ( char *ptr = buf; len; ptr += n, len -= n )
+        if (( n = recv( fd, ptr, len, MSG_WAITALL )) <= 0 )
+            return false;
+
+    return true;
+}
+
+
+/** @brief      Master receive thread. Accepts a slave connection and reads frames until it closes
+  *
+  * @param[in] *arg = unused
+  *
+  * @return     NULL
+  */
+static void *xfr_recv( void *arg )
+{
+    int         fd;
+    shm_frm_t   hdr;
+    xfr_pend_t *p;
+    uint64_t    frames;
+
+    sch_set( SCH_XFR );
+    for(;;)
+    {
+        if (( fd = accept( xfr_fd, NULL, NULL )) < 0 )
+        {
+            mop_log( false, LOG_SYS, FAC, "accept() %s", strerror(errno) );
+            sleep( 1 );
+            continue;
+        }
+        mop_log( true, LOG_INF, FAC, "Slave frame stream connected" );
+
+        for ( frames = 0; xfr_read( fd, &hdr, sizeof(hdr) ); frames++ )
+        {
+            sch_mark( SCH_XFR );
+            if ( hdr.bytes > xfr_max )
+            {
+                mop_log( false, LOG_ERR, FAC, "Slave frame %lu bytes > %lu. Dropping connection", hdr.bytes, xfr_max );
+                break;
+            }
+
+            pthread_mutex_lock( &xfr_mtx );
+            if (( p = xfr_slot( XFR_PEER )))
+                p->state = XFR_FILL;
+            pthread_mutex_unlock( &xfr_mtx );
+
+//          Should never happen but keep the stream in step if it does
+            if ( !p )
+            {
+                mop_log( false, LOG_ERR, FAC, "No free slot. Dropping connection" );
+                break;
+            }
+
+            p->hdr = hdr;
+            if ( !xfr_read( fd, p->pix, hdr.bytes ) )
+            {
+                p->state = XFR_FREE;
+                break;
+            }
+            xfr_done( p, XFR_PEER );
+        }
+
+        close( fd );
+        mop_log( true, LOG_INF, FAC, "Slave frame stream closed after %lu frames", frames );
+    }
+
+    return NULL;
+}
+
+
+/** @brief      Slave sender thread: Connect to master frame port
+  *
+  * @return     true | false = Connected | Failure
+  */
+static bool xfr_connect( void )
+{
+    struct sockaddr_in adr = msg_str2adr( ipmaster );
+    struct timeval     tmo = { XFR_TMO, 0 };
+    int                one = 1;
+
+    adr.sin_port = htons( xfr_port );
+    if (( xfr_fd = socket( AF_INET, SOCK_STREAM, 0 )) < 0 )
+        return mop_log( false, LOG_SYS, FAC, "socket() %s", strerror(errno) );
+
+//  Timeouts so a stalled or absent master only holds up the sender, whose queue then drops frames 
+    setsockopt( xfr_fd, SOL_SOCKET,  SO_SNDTIMEO, &tmo, sizeof(tmo) );
+    setsockopt( xfr_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one) );
+
+    if ( connect( xfr_fd, (struct sockaddr *)&adr, sizeof(adr) ) < 0 )
+    {
+        close( xfr_fd );
+        xfr_fd = -1;
+        return mop_log( false, LOG_WRN, FAC, "connect(%s port %i) %s", ipmaster, xfr_port, strerror(errno) );
+    }
+
+    return mop_log( true, LOG_INF, FAC, "Frame stream to master port %i", xfr_port );
+}
+
+
+/** @brief      Slave sender thread: Send one frame, (re)connecting if needed. Sends from the ring slot if
+  *             queued from there. The last byte is held back until the slot lock shows it was not overwritten
+  *             meanwhile, otherwise the connection is dropped so the master discards the short frame.
+  *
+  * @param[in] *p = queued frame
+  *
+  * @return     true | false = Sent | Dropped
+  */
+static bool xfr_send1( xfr_pend_t *p )
+{
+    struct iovec iov[2];
+    off_t   off = p->off;
+    size_t  len;
+    ssize_t n   = 0;
+    char    end;
+
+    if ( xfr_fd < 0 && !xfr_connect() )
+        return false;
+
+    if ( p->frm )
+    {
+        len = sizeof(shm_frm_t) + p->hdr.bytes - 1;
+        for ( ; len && ( n = sendfile( xfr_fd, p->fd, &off, len )) > 0; len -= n );
+        end = ((char *)p->frm)[ sizeof(shm_frm_t) + p->hdr.bytes - 1 ];
+        if ( n >= 0 && !len && !shm_done( p->frm, p->lock ) )
+        {
+            errno = ESTALE;
+            n     = -1;
+        }
+        if ( n >= 0 && !len )
+            len = ( n = send( xfr_fd, &end, 1, 0 )) == 1 ? 0 : 1;
+    }
+    else
+    {
+        iov[0].iov_base = &p->hdr;
+        iov[0].iov_len  = sizeof(p->hdr);
+        iov[1].iov_base = p->pix;
+        iov[1].iov_len  = p->hdr.bytes;
+        len = sizeof(p->hdr) + p->hdr.bytes;
+        n   = writev( xfr_fd, iov, 2 );
+        len = n < 0 ? len : len - n;
+    }
+
+//  Partial frame leaves the stream out of step so start again with next frame
+    if ( n < 0 || len )
+    {
+        close( xfr_fd );
+        xfr_fd = -1;
+        return mop_log( false, LOG_WRN, FAC, "Frame %s not sent to master. %s", p->hdr.name, n < 0 ? strerror(errno) : "Short write" );
+    }
+
+    return true;
+}
+
+
+/** @brief      Slave sender thread. Sends each queued frame to the master and frees its slot
+  *
+  * @param[in] *arg = unused
+  *
+  * @return     NULL
+  */
+static void *xfr_send( void *arg )
+{
+    xfr_pend_t *p;
+
+    for(;;)
+    {
+        pthread_mutex_lock( &xfr_mtx );
+        while ( !xfr_num )
+            pthread_cond_wait( &xfr_cnd, &xfr_mtx );
+        p = xfr_que[xfr_head][XFR_PEER];
+        xfr_head = ( xfr_head + 1 ) % XFR_PEND;
+        xfr_num--;
+        pthread_mutex_unlock( &xfr_mtx );
+
+        xfr_send1( p );
+
+        pthread_mutex_lock( &xfr_mtx );
+        p->state = XFR_FREE;
+        pthread_mutex_unlock( &xfr_mtx );
+    }
+
+    return NULL;
+}
+
+
+/** @brief      Init. frame pairing. Master allocates pending frames and starts listening.
+  *             Slave allocates frames waiting to send and starts the sender, which connects when the first
+  *             frame is sent. Failure is not fatal, pairing is disabled.
+  *
+  * @param[in] *cam = pointer to camera info structure, sensor size known
+  *
+  * @return     true
+  */
+bool xfr_init( mop_cam_t *cam )
+{
+    struct sockaddr_in adr = { .sin_family = AF_INET, .sin_addr.s_addr = INADDR_ANY };
+    int                one = 1;
+    char              *err = NULL;
+
+    if ( !xfr_port || one_cam || xfr_max )
+        return true;
+
+//  Products are pairs so only a two camera network 
+    if ( mop_slaves > 1 )
+        return mop_log( true, LOG_WRN, FAC, "%i cameras. Pairing disabled", mop_slaves + 1 );
+
+//  Largest frame is unbinned Mono16. Slave only needs its send side 
+    xfr_max = 2 * cam->SensorWidth * cam->SensorHeight;
+    for ( int s = mop_master ? 0 : XFR_PEER; s < 2; s++ )
+        for ( int i = 0; i < XFR_PEND; i++ )
+            if ( !( xfr_pend[s][i].pix = aligned_alloc( 16, xfr_max )))
+                err = "aligned_alloc()";
+
+    if ( !mop_master )
+    {
+        if ( !err && pthread_create( &xfr_writer, NULL, xfr_send, NULL ) )
+            err = "pthread_create()";
+        if ( err )
+        {
+            xfr_max = 0;
+            return mop_log( true, LOG_WRN, FAC, "%s %s. Pairing disabled", err, strerror(errno) );
+        }
+        return mop_log( true, LOG_INF, FAC, "Sending frames to master port %i", xfr_port );
+    }
+
+    adr.sin_port = htons( xfr_port );
+    if ( !err && ( xfr_fd = socket( AF_INET, SOCK_STREAM, 0 )) < 0 )
+        err = "socket()";
+
+    if ( !err )
+    {
+        setsockopt( xfr_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one) );
+        if ( bind( xfr_fd, (struct sockaddr *)&adr, sizeof(adr) ) < 0 || listen( xfr_fd, 1 ) < 0 )
+            err = "bind()";
+    }
+
+    if ( !err && ( pthread_create( &xfr_writer, NULL, xfr_write, NULL ) ||
+                   pthread_create( &xfr_thread, NULL, xfr_recv,  NULL )  ))
+        err = "pthread_create()";
+
+    if ( err )
+    {
+        xfr_max = 0;
+        return mop_log( true, LOG_WRN, FAC, "%s port %i %s. Pairing disabled", err, xfr_port, strerror(errno) );
+    }
+
+    pol_init( cam );
+
+    return mop_log( true, LOG_INF, FAC, "Pairing frames from slave on port %i", xfr_port );
+}
+
+
+/** @brief      Pass on an acquired frame. Never waits on the network or disk.
+  *             Slave queues it for the sender thread, dropping it if the queue is full. Master keeps a copy
+  *             until the slave frame arrives, pairs are written by the writer thread.
+  *
+  * @param[in] *cam   = pointer to camera info structure
+  * @param[in]  seq   = image sequence number within run
+  * @param[in] *name  = FITS file name for this frame
+  * @param[in] *pix   = Mono16 pixel data
+  * @param[in]  bytes = pixel data size
+  *
+  * @return     true | false = Success | Failure
+  */
+bool xfr_put( mop_cam_t *cam, int seq, char *name, void *pix, size_t bytes )
+{
+    xfr_pend_t *p = NULL;
+    int         side = mop_master ? XFR_MINE : XFR_PEER;
+
+    if ( !xfr_max )
+        return true;
+
+    if ( bytes > xfr_max )
+        return mop_log( false, LOG_ERR, FAC, "Frame %lu bytes > %lu", bytes, xfr_max );
+
+//  Slave takes a free slot only, the sender still owns the others 
+    pthread_mutex_lock( &xfr_mtx );
+    if ( mop_master )
+        p = xfr_slot( XFR_MINE );
+    else
+        for ( int i = 0; i < XFR_PEND && !p; i++ )
+            if ( xfr_pend[XFR_PEER][i].state == XFR_FREE )
+                p = &xfr_pend[XFR_PEER][i];
+    if ( p )
+        p->state = XFR_FILL;
+    pthread_mutex_unlock( &xfr_mtx );
+    if ( !p )
+        return mop_log( false, LOG_WRN, FAC, "No free slot. Frame %s dropped", name );
+
+//  Master pairs a copy. Slave sends from the ring slot if it holds this frame, else a copy 
+    shm_meta( &p->hdr, cam, seq, name, bytes );
+    if ( mop_master || !( p->frm = shm_last( name, &p->fd, &p->off, &p->lock )))
+        memcpy( p->pix, pix, bytes );
+
+    if ( mop_master )
+    {
+        xfr_done( p, side );
+    }
+    else
+    {
+        pthread_mutex_lock( &xfr_mtx );
+        xfr_que[( xfr_head + xfr_num++ ) % XFR_PEND][side] = p;
+        pthread_cond_signal( &xfr_cnd );
+        pthread_mutex_unlock( &xfr_mtx );
+    }
+
+    return true;
+}
+
+
+/** @brief      Master: Wait for the run's pairs to be written. Done when no frame of this camera is still 
+  *             waiting for its slave frame and the writer has finished with every pair. 
+  *             A slave frame that never arrives, e.g. dropped by the slave, ends the wait at the timeout.
+  *
+  * @param[in]  timeout = timeout [s]
+  *
+  * @return     true | false = Drained | Timeout, unpaired frames remain
+  */
+bool xfr_drain( int timeout )
+{
+    int    pend = 0; // Frames not yet written as pairs
+    struct timespec beg;
+    struct timespec now;
+
+    if ( !xfr_max || !mop_master )
+        return true;
+
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    do
+    {
+        pthread_mutex_lock( &xfr_mtx );
+        pend = xfr_num;
+        for ( int i = 0; i < XFR_PEND; i++ )
+            pend += xfr_pend[XFR_MINE][i].state != XFR_FREE;
+        pthread_mutex_unlock( &xfr_mtx );
+        if ( !pend )
+            return mop_log( true, LOG_DBG, FAC, "Pairs written" );
+
+        usleep( 10 * TIM_TICK );
+        clock_gettime( CLOCK_MONOTONIC, &now );
+    }
+    while ( utl_ts_dif( &now, &beg ) < timeout );
+
+    return mop_log( false, LOG_WRN, FAC, "%i frames still unpaired after %is", pend, timeout );
+}
@@ -11,6 +11,144 @@
 #include "mopnet.h"
 #define FAC FAC_CMD
 
+/** @brief     Read a sequence file into a SEQ message. One line of run options per run.
+  *            Blank lines and lines starting with # are ignored. 
+  *
+  * @param[in]  *file  = sequence file name 
+  * @param[out] *seq   = buffer for SEQ message  
+  * @param[in]   max   = buffer size 
+  * @param[out] *total = expected number of images from all runs 
+  *
+  * @return    Number of runs in sequence. 0 = Failure  
+  */
+static int cmd_seq( char *file, char *seq, int max, int *total )
+{
+    FILE *fp;
+    char  line[MSG_LEN];
+    char  run [MSG_LEN];
+    char *opt;
+    char *foc = foc_list; // String options point into run so restore those used after parsing
+    char *seq_file = mop_seq;
+    char *args[64];
+    char *typ;
+    int   argc;
+    int   len;
+    int   num = 0;
+
+    *total = 0;
+    if ( !(fp = fopen( file, "r" )))
+        return mop_log( 0, LOG_SYS, FAC, "Sequence file fopen(%s) %s", file, strerror(errno)); 
+
+    len = snprintf( seq, max, MSG_SEQ_T );
+    while ( fgets( line, sizeof(line), fp ))
+    {
+        line[ strcspn( line, "\r\n#;" ) ] = '\0';
+        for ( opt = line; isspace( *opt ); opt++ );
+        if ( !*opt )
+            continue;
+        len += snprintf( seq + len, max - len, "%s%s", num++ ? ";" : " ", opt ); 
+
+//      Parse a copy of the options, as the servers will, to find the number of images. 
+//      Options carry over from run to run.
+        snprintf( run, sizeof(run), MSG_RUN" %s", opt );
+        argc = utl_msg2arg( args, run, &typ );
+        mop_opts( argc, args, CMD_ARGS, CMD_CHKS );
+        *total += ( img_stk ? 1 : rot_revs ) * img_cycle * mop_cams; 
+    }
+    fclose( fp );
+    foc_list = foc;
+    mop_seq  = seq_file;
+
+    if ( len >= max )
+        return mop_log( 0, LOG_ERR, FAC, "Sequence file %s too long", file ); 
+    if ( num > MSG_QUEUE )
+        return mop_log( 0, LOG_ERR, FAC, "Sequence file %s too long. Max. %i runs", file, MSG_QUEUE ); 
+
+    return num; 
+}
+
+
+/** @brief     Build a focus sweep SEQ message. One run per -J focus position, each with this
+  *            command's other options plus -F<position> -H<runs>. Needs a focus mover, see cmd_mov()
+  *
+  * @param[in]   argc  = argument count
+  * @param[in]  *argv  = argument variables
+  * @param[out] *seq   = buffer for SEQ message  
+  * @param[in]   max   = buffer size 
+  * @param[out] *total = expected number of images from all runs 
+  *
+  * @return    Number of runs in sweep. 0 = Failure  
+  */
+static int cmd_foc( int argc, char *argv[], char *seq, int max, int *total )
+{
+    char   lst[MSG_LEN] = "";
+    char  *opt = utl_arg2msg( argc, argv, NULL );
+    char  *pos;
+    int    len;
+    int    num = 0;
+    int    runs;
+
+    *total = 0;
+    if ( !getenv( FOC_ENV ) )
+        return mop_log( 0, LOG_ERR, FAC, "Focus sweep needs a focus mover command in %s", FOC_ENV ); 
+
+    strncpy( lst, foc_list, sizeof(lst)-1 );
+    for ( pos = strtok( lst, "," ); pos; pos = strtok( NULL, "," ))
+        num++;
+    if ( num < FOC_MIN || num > MSG_QUEUE )
+        return mop_log( 0, LOG_ERR, FAC, "Focus sweep of %i positions. Use %i to %i", num, FOC_MIN, MSG_QUEUE ); 
+
+    runs = num;
+    strncpy( lst, foc_list, sizeof(lst)-1 );
+    len = snprintf( seq, max, MSG_SEQ_T );
+    for ( pos = strtok( lst, "," ), num = 0; pos; pos = strtok( NULL, "," ))
+        len += snprintf( seq + len, max - len, "%s%s -F%s -H%i", num++ ? ";" : "", opt, pos, runs ); 
+
+    if ( len >= max )
+        return mop_log( 0, LOG_ERR, FAC, "Focus sweep too long" ); 
+
+    *total = num * ( img_stk ? 1 : rot_revs ) * img_cycle * mop_cams; 
+
+    return num; 
+}
+
+
+/** @brief     Handle a focus sweep message that is not an image. A move request runs the FOC_ENV command
+  *            with the position appended and, if it succeeds, tells the master the focus is in position.
+  *            The master's ACK or NAK of that, e.g. a NAK if it gave up waiting, is also swallowed here.
+  *
+  * @param[in]  *msg = received message
+  *
+  * @return    true | false = Handled | Not a focus sweep message
+  */
+static bool cmd_mov( char *msg )
+{
+    char  cmd[MSG_LEN];
+    char  rep[MSG_LEN];
+    char *pos = msg + strlen(MSG_FMV) + 1;
+    int   ret;
+
+    if ( msg_chk( msg, MSG_ACK, strlen(MSG_ACK) )||
+         msg_chk( msg, MSG_NAK, strlen(MSG_NAK) )  )
+        return true;
+    if ( !msg_chk( msg, MSG_FMV" ", strlen(MSG_FMV" ") ))
+        return false;
+
+    snprintf( cmd, sizeof(cmd), "%s %s", getenv( FOC_ENV ), pos );
+    if (( ret = system( cmd )))
+    {
+        mop_log( false, LOG_ERR, FAC, "Focus mover '%s' failed, status %i", cmd, ret );
+        return true;
+    }
+
+//  Master ACK may come after further image names so is not waited for here
+    snprintf( rep, sizeof(rep), MSG_FDN" %s", pos );
+    msg_send( 0, rep, ipmaster, NULL, 0 );
+
+    return mop_log( true, LOG_INF, FAC, "Focus %s in position", pos );
+}
+
+
 /** @brief     Main 
   *
   * @param[in] argc = argument count
@@ -21,8 +159,10 @@
 int main( int argc, char *argv[] )
 {
     char  msg_buf[1024]; // Message buffer
+    char  msg_seq[MSG_SEQ];// Sequence and query reply buffer 
     int   msg_len;
     int   total;
+    int   runs;
 
     log_fp = stdout; // Output to screen
 
@@ -32,21 +172,65 @@ int main( int argc, char *argv[] )
     mop_log ( mop_opts(argc, argv, CMD_ARGS, CMD_CHKS ), LOG_DBG, FAC, "mop_opts()");
     msg_init( IPCOMMAND );
 
-//  If -k kill option then send to both servers
+//  If -k kill option then send to all servers
     if ( mop_kill )
     {
         mop_log( msg_send( 1, utl_arg2msg( argc, argv, MSG_RUN), ipmaster, MSG_ACK, strlen(MSG_ACK) ), LOG_INF, FAC, "Kill Master");
-        mop_log( msg_send( 1, utl_arg2msg( argc, argv, MSG_RUN), ipslave , MSG_ACK, strlen(MSG_ACK) ), LOG_INF, FAC, "Kill Slave" );
+        mop_log( msg_fan ( 1, utl_arg2msg( argc, argv, MSG_RUN), ipslaves, mop_slaves, MSG_ACK, strlen(MSG_ACK), NULL, NULL ), LOG_INF, FAC, "Kill Slaves" );
+    }
+    else if ( mop_qry ) // Query run queue
+    {
+        msg_send( TMO_ACK, MSG_QRY, ipmaster, NULL, 0 ); 
+        if (!mop_log( msg_recv( TMO_ACK, msg_seq, sizeof(msg_seq)-1, &msg_len, NULL, 0 ), LOG_DBG, FAC, "msg_recv()"))
+            return EXIT_FAILURE;
+        puts( msg_seq );
+    }
+    else if ( mop_abt ) // Abort queued runs. Master passes this to slave
+    {
+        if (!mop_log( msg_send( TMO_ACK, MSG_ABT, ipmaster, MSG_ACK, strlen(MSG_ACK) ), LOG_INF, FAC, "Abort"))
+            return EXIT_FAILURE;        
+    }
+    else if ( mop_seq || foc_list ) // Run a sequence file or focus sweep with a single master-slave handshake 
+    {
+        if ( mop_seq )
+            runs = cmd_seq( mop_seq, msg_seq, sizeof(msg_seq), &total );
+        else
+            runs = cmd_foc( argc, argv, msg_seq, sizeof(msg_seq), &total );
+        if ( !runs )
+            return EXIT_FAILURE;        
+
+        if (!mop_log( msg_send( TMO_ACK, msg_seq, ipmaster, MSG_ACK, strlen(MSG_ACK) ), LOG_INF, FAC, "msg_send()"))
+            return EXIT_FAILURE;        
+        else
+            printf( "Waiting for %i runs, %i images%s ...\n", runs, total, foc_list ? " and best focus" : "" );
+
+//      Focus sweep result follows the images 
+        if ( foc_list )
+            total++;
+ 
+        for( int i = total; i--; )
+        {
+             msg_len = 0;
+             if (!mop_log( msg_recv( 20, msg_buf, sizeof(msg_buf)-1, &msg_len, NULL, 0 ), LOG_DBG, FAC, "msg_recv()"))
+                 return EXIT_FAILURE;
+
+//           Focus moves between sweep runs are not counted 
+             if ( foc_list && cmd_mov( msg_buf ))
+                 i++;
+             else if ( msg_len > 0 ) 
+                 puts( msg_buf );
+        }
     }
     else 
     {
-        total = rot_revs * img_cycle * 2; 
+//      Co-added runs write one stack per position 
+        total = ( img_stk ? 1 : rot_revs ) * img_cycle * mop_cams; 
 
-//      Send to Master process to be forwarded to Slave
+//      Send to Master process to be forwarded to Slaves
         if (!mop_log( msg_send( 1, utl_arg2msg( argc, argv, MSG_RUN ), ipmaster, MSG_ACK, strlen(MSG_ACK) ), LOG_INF, FAC, "msg_send()"))
             return EXIT_FAILURE;        
         else
-            printf( "Waiting for 2 x %i x %i = %i images ...\n", rot_revs, img_cycle, total );
+            printf( "Waiting for %i x %i x %i = %i images ...\n", mop_cams, img_stk ? 1 : rot_revs, img_cycle, total );
  
 //      Wait for expected number of images to be acquired
         for( int i = total; i--; )
@@ -13,6 +13,156 @@
 #include "mopnet.h"
 #define FAC FAC_MOP
 
+// Copy of command line options forwarded to slave appended with run number. Used by handshake task
+static char  msg_cpy[MSG_SEQ]; 
+
+// Run taken from the RUN queue. Single run or part of a sequence
+static msg_run_t run_cur; 
+
+// Highest run number offered by a slave. Set by handshake task, applied by main thread once joined
+static int hsk_run;
+
+// Device initialisation tasks started at process start 
+static mop_task_t ini_cam; // Camera
+static mop_task_t ini_rot; // Rotator
+static mop_task_t ini_whl; // Filter wheel
+static struct timespec mop_beg; // Process start 
+
+/** @brief      Log device ready state and time since process start
+  *
+  * @param[in]  ok   = device init. result
+  * @param[in] *dev  = device name
+  *
+  * @return     ok  
+  */
+static bool ini_rdy( bool ok, char *dev )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return mop_log( ok, ok ? LOG_INF : LOG_ERR, FAC, "%s %s after %.3fs", dev, ok ? "ready" : "init. failed", utl_ts_dif( &now, &mop_beg ));
+}
+
+
+/** @brief      Init. task: Camera library, open, configure, allocate buffers and cool
+  *
+  * @return     true | false = Success | Failure 
+  */
+static bool ini_cam_fn( void )
+{
+    mop_cam_t *cam = &mop_cam;
+
+    return ini_rdy( mop_log( cam_init ( cam_num      ), LOG_DBG, FAC, "cam_init()" )&&
+                    mop_log( cam_open ( cam          ), LOG_DBG, FAC, "cam_open()" )&&
+                    mop_log( cam_conf ( cam, cam_exp ), LOG_DBG, FAC, "cam_conf()" )&&
+                    mop_log( cam_alloc( cam          ), LOG_DBG, FAC, "cam_alloc()")&&
+                    mop_log( shm_init ( cam, shm_slots), LOG_DBG, FAC, "shm_init()" )&&
+                    mop_log( xfr_init ( cam          ), LOG_DBG, FAC, "xfr_init()" )&&
+                    mop_log( cam_cool ( cam, cam_temp, TMO_TOK, cam_quick ), LOG_DBG, FAC, "cam_cool()"), "Camera" );
+}
+
+
+/** @brief      Init. task: Rotator connect, configure and move to start position 
+  *
+  * @return     true | false = Success | Failure 
+  */
+static bool ini_rot_fn( void )
+{
+    return ini_rdy( mop_log( rot_init( rot_usb, ROT_BAUD, TMO_ROTATOR, ROT_TRG_HI ), LOG_DBG, FAC, "rot_init()"), "Rotator" ); 
+}
+
+
+/** @brief      Init. task: Filter wheel open and move to default position 
+  *
+  * @return     true | false = Success | Failure 
+  */
+static bool ini_whl_fn( void )
+{
+    return ini_rdy( mop_log( whl_init( whl_pos, TMO_WHL ), LOG_DBG, FAC, "whl_init()" ), "Filter wheel" );
+}
+
+/** @brief      Run setup task: Init. rotator and move to start position
+  *
+  * @return     true | false = Success | Failure 
+  */
+static bool run_rot( void )
+{
+//  Rotator may still be initialising after process start 
+    utl_task_wait( &ini_rot );
+
+    return mop_log( rot_init( rot_usb, ROT_BAUD, TMO_ROTATOR, ROT_TRG_HI ), LOG_DBG, FAC, "rot_init()"); 
+}
+
+
+/** @brief      Run drain task: Wait for the rotator to pass the last trigger then park it ready for the next run.
+  *             Runs while the camera is still reading out and writing the last images. The wait ends a tolerance
+  *             past the last trigger angle so rot_wait() cannot return before the trigger has fired.
+  *
+  * @return     true | false = Success | Failure 
+  */
+static bool run_drn( void )
+{
+    double last    = rot_last + 2.0 * rot_sign * ROT_TOLERANCE; // Just past last trigger
+    int    timeout = TMO_ROTATOR + fabs( last / rot_vel );      // Whole run plus margin 
+
+    sch_set( SCH_ROT );
+    return mop_log( rot_wait( last, timeout, rot_sign == ROT_CW ), LOG_DBG, FAC, "rot_wait(last)")&&
+           mop_log( rot_park(                                   ), LOG_DBG, FAC, "rot_park()"     );
+}
+
+
+/** @brief      Run setup task: Forward RUN to all slaves, wait for every temperature OK and agree run number.
+  *             A sequence is forwarded whole with its first run so later runs only wait for the slave TOKs.
+  *             Slaves are sent the RUN together and their TOKs collected in whatever order they arrive.
+  *             A higher slave run number is only noted in hsk_run. The main thread adopts it after the join
+  *             as fts_mkname() changes fts_run and the camera sequence number.
+  *
+  * @return     true | false = Success | Failure 
+  */
+static bool run_hsk( void )
+{
+    char   msg_tok[CAM_MAX][MSG_LEN]; // Own copy as re-parsed options point into main receive buffer
+    double lat_ack[CAM_MAX] = {0.0};  // Per slave RUN ACK latency
+    double lat_tok[CAM_MAX];          // Per slave TOK latency after RUN ACKs collected
+    double ack = 0.0;                 // Time to collect all RUN ACKs
+    int    run;                       // Slave run number
+    bool   ok;
+    struct timespec beg;
+    struct timespec now;
+
+//  Forward arguments to slaves, unless already sent as part of a sequence, and await messages indicating stable temperature
+    for ( int i = 0; i < mop_slaves; i++ )
+        lat_tok[i] = -1.0;
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    if (( ok = run_cur.pos > 1 ||
+               mop_log( msg_fan( TMO_MSG, msg_cpy, ipslaves, mop_slaves, MSG_ACK, strlen(MSG_ACK), NULL, lat_ack ), LOG_MSG, FAC,"msg_fan(%s)", msg_cpy )))
+    {
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        ack = utl_ts_dif( &now, &beg );
+        ok  = mop_log( msg_fan( TMO_TOK, NULL, ipslaves, mop_slaves, MSG_TOK, strlen(MSG_TOK), msg_tok, lat_tok ), LOG_MSG, FAC,"msg_fan(%s)", MSG_TOK );
+    }
+
+    for ( int i = 0; i < mop_slaves; i++ )
+    {
+        if ( lat_tok[i] < 0.0 )
+            continue;
+
+//      Per slave readiness, total from RUN sent. Slowest slave sets the handshake time
+        mop_log( true, LOG_INF, FAC, "Camera %i %s ACK = %.3fs TOK = %.3fs Ready = %.3fs",
+                 i+2, ipslaves[i], lat_ack[i], lat_tok[i], ack + lat_tok[i] );
+
+//      If slave supplied a run number extract it and compare
+        if ( sscanf( msg_tok[i], MSG_TOK" %d", &run ) == 1 && run > hsk_run )
+        {
+            mop_log( true, LOG_WRN, FAC, "Master RUN=%i low. Camera %i RUN=%i", fts_run, i+2, run );
+            hsk_run = run;
+        }
+    }
+
+    return ok;
+}
+
+
 /** @brief      main() entry point
   *
   * @param[in]  argc   = argument count
@@ -28,10 +178,28 @@ int main( int argc, char *argv[] )
     char *msg_typ;
     char  msg_rcv[1024]; // Receive message buffer
     char  msg_snd[1024]; // Send message buffer 
-    char  msg_cpy[1024]; // Copy of command line options forwarded to slave appended with run number
     int   msg_len;
     int   run;           // Run number
 
+//  Concurrent run setup 
+    mop_task_t task_rot; // Rotator init. and move to start
+    mop_task_t task_hsk; // Slave handshake
+    mop_task_t task_drn; // Rotator drain after last trigger
+    struct timespec run_beg;  
+    struct timespec cam_end;  
+    struct timespec whl_end;  
+    struct timespec run_end;  
+    struct timespec acq_beg;        // Start of acquisition 
+    struct timespec acq_end = {0,0};// End of previous acquisition
+    struct timespec idl_beg;        // Idle waiting for RUN 
+    struct timespec idl_end; 
+    struct timespec seq_beg;        // Start of sequence 
+    double seq_acq = 0.0;           // Sequence time spent acquiring 
+    int    queued;                  // RUN requests already queued when run started 
+    int    len;
+    bool   plan;                    // Exposure fits trigger interval 
+    char   aex_opt[MAX_STR];        // Options chosen by acquisition auto-exposure, forwarded to slaves
+
 //  Substitution arguments for re-parsing
     char *args[64];         
 
@@ -43,125 +211,237 @@ int main( int argc, char *argv[] )
     mop_log( mop_defs(), LOG_DBG, FAC, "mop_defs()"); 
     mop_log( mop_opts(argc, argv, CAM_ARGS, CAM_CHKS ), LOG_DBG, FAC, "mop_opts()"); 
     mop_log( mop_init(), LOG_DBG, FAC, "mop_init()"); 
+    mop_log( sch_init(), LOG_DBG, FAC, "sch_init()"); 
 
 //  Swap argument storage to local array for re-parsing
     argv = args; 
 
     if ( mop_master )              
     {
-//      Initalisations 
-        mop_log( msg_init ( ipmaster       ), LOG_DBG, FAC, "msg_init()" );   
-        mop_log( whl_init ( whl_pos,TMO_WHL), LOG_DBG, FAC, "whl_init()" );
-        mop_log( cam_init ( cam_num        ), LOG_DBG, FAC, "cam_init()" );
-        mop_log( cam_open ( cam            ), LOG_DBG, FAC, "cam_open()" );
-        mop_log( cam_conf ( cam, cam_exp   ), LOG_DBG, FAC, "cam_conf()" );
-        mop_log( cam_alloc( cam            ), LOG_DBG, FAC, "cam_alloc()");
-        mop_log( cam_cool ( cam, cam_temp, TMO_TOK, cam_quick ), LOG_DBG, FAC, "cam_cool()");
+//      Initalisations. Network first so RUN messages can be accepted while devices initialise 
+        clock_gettime( CLOCK_MONOTONIC, &mop_beg );
+        ini_rdy( mop_log( msg_init( ipmaster ), LOG_DBG, FAC, "msg_init()" ), "Network" );   
+        utl_task_run( &ini_whl, "WHL", ini_whl_fn );
+        utl_task_run( &ini_rot, "ROT", ini_rot_fn );
+        utl_task_run( &ini_cam, "CAM", ini_cam_fn );
 
 //      Forever loop
         for(;;)
         { 
-//          Wait for RUN message 
-            while( !mop_log( msg_recv( 0, msg_rcv, sizeof(msg_rcv), &msg_len, MSG_RUN, strlen(MSG_RUN) ), LOG_DBG, FAC, "msg_recv(%s)", msg_rcv ));
+//          Take next queued run or wait for a new RUN or SEQ message 
+            queued = msg_queued();
+            clock_gettime( CLOCK_MONOTONIC, &idl_beg );
+            while( !msg_pop( &run_cur ) )
+                msg_idle( 0 );
+            clock_gettime( CLOCK_MONOTONIC, &idl_end );
+            mop_log( true, LOG_DBG, FAC, "Run %i/%i %s", run_cur.pos, run_cur.num, run_cur.run );
+
+            if ( run_cur.pos == 1 )
+            {
+                seq_beg = idl_end;
+                seq_acq = 0.0;
+            }
 
-//          Copy message for forwarding to Slave 
-            strncpy( msg_cpy, msg_rcv, sizeof(msg_cpy)-1 );  
+//          Camera settings are changed by re-parse so wait if still initialising
+            utl_task_wait( &ini_cam );
 
-//          Re-parse options, re-init data and re-configure camera
+//          Re-parse options and re-init data
+            strncpy( msg_rcv, run_cur.run, sizeof(msg_rcv)-1 );  
             argc=utl_msg2arg ( argv, msg_rcv, &msg_typ );   
             mop_log( mop_opts( argc, argv, CAM_ARGS, CAM_CHKS), LOG_DBG, FAC, "mop_opts()"); 
             mop_log( mop_init(                               ), LOG_DBG, FAC, "mop_init()"); 
-            mop_log( whl_conf( whl_pos, TMO_WHL              ), LOG_DBG, FAC, "whl_conf()");
-            mop_log( cam_conf( cam, cam_exp                  ), LOG_DBG, FAC, "cam_conf()");
+            if ( cam_bits )
+                mop_log( cal_pick( cam, cam_bits, cam_noise  ), LOG_DBG, FAC, "cal_pick()"); 
 
-//          Init. rotator to start position 
-            mop_log( rot_init( rot_usb, ROT_BAUD, TMO_ROTATOR, ROT_TRG_HI ), LOG_DBG, FAC, "rot_init()"); 
+//          Run setup. Rotator, filter wheel and slave handshake are independent of the camera so 
+//          run concurrently with it and are joined before acquisition is enabled
+            clock_gettime( CLOCK_MONOTONIC, &run_beg );
+            utl_task_wait( &ini_whl );
+            mop_log( whl_move( whl_pos ), LOG_DBG, FAC, "whl_move()");
+            mop_log( foc_move(         ), LOG_DBG, FAC, "foc_move()");
 
-//          Queue images, re-check temperature is still OK 
-            mop_log( cam_queue ( cam ), LOG_DBG, FAC, "cam_queue()");
-            mop_log( cam_cool( cam, cam_temp, TMO_TOK, cam_quick ), LOG_DBG, FAC, "cam_cool()");
+//          Acquisition pre-pass may change exposure, binning and velocity so precedes rotator setup.
+//          Slaves get the result appended to their RUN, so in a sequence only the first run can use it
+            *aex_opt = '\0';
+            if ( one_cam || run_cur.pos <= 1 )
+                mop_log( aex_run( cam, aex_opt, sizeof(aex_opt) ), LOG_DBG, FAC, "aex_run()");
+            utl_task_run( &task_rot, "ROT", run_rot );
 
 //          Init. filename, get next available local run number 
             fts_run = FTS_INIT;
             mop_log( !fts_mkname( cam, fts_pfx, &fts_run ), LOG_DBG, FAC, "fts_mkname(INIT)");
 
 //          KLUDGE: Append a suggested local rUn number onto message to slave as -U option
-            sprintf( &msg_cpy[ strlen(msg_cpy) ], " -U%i", fts_run ); 
+//          A sequence is forwarded whole with the run number added to its first run 
+            if ( run_cur.pos == 1 )
+            {
+                len = strcspn( run_cur.seq, ";" );
+                snprintf( msg_cpy, sizeof(msg_cpy), "%.*s -U%i%s%s", len, run_cur.seq, fts_run, aex_opt, &run_cur.seq[len] ); 
+            }
+            else
+            {
+                snprintf( msg_cpy, sizeof(msg_cpy), "%s -U%i%s", run_cur.run, fts_run, aex_opt ); 
+            }
+
+//          If using all cameras then start slave handshake, waits for slave temperature stable OK 
+            hsk_run = fts_run;
+            if ( !one_cam )
+                utl_task_run( &task_hsk, "HSK", run_hsk );
 
-//          If using all cameras then wait for slave temperature stable OK 
+//          Re-configure camera, queue images, re-check temperature is still OK 
+            mop_log( cam_conf ( cam, cam_exp ), LOG_DBG, FAC, "cam_conf()");
+            plan = cam_plan( cam );
+            mop_log( cam_queue( cam          ), LOG_DBG, FAC, "cam_queue()");
+            mop_log( stk_init ( cam          ), LOG_DBG, FAC, "stk_init()");
+            mop_log( lib_init ( cam          ), LOG_DBG, FAC, "lib_init()");
+            mop_log( trg_init (              ), LOG_DBG, FAC, "trg_init()");
+            mop_log( cam_cool ( cam, cam_temp, TMO_TOK, cam_quick ), LOG_DBG, FAC, "cam_cool()");
+            clock_gettime( CLOCK_MONOTONIC, &cam_end );
+
+//          Join run setup tasks 
+            utl_task_wait( &task_rot );
             if ( !one_cam )
+                utl_task_wait( &task_hsk );
+            clock_gettime( CLOCK_MONOTONIC, &run_end );
+
+//          Adopt a higher slave run number 
+            if ( hsk_run > fts_run )
             {
-//              Forward arguments to slave and await message indicating stable temperature
-                mop_log( msg_send( TMO_MSG, msg_cpy, ipslave, MSG_ACK, strlen(MSG_ACK)), LOG_MSG, FAC,"msg_send(%s)", msg_cpy ); 
-                mop_log( msg_recv( TMO_TOK, msg_rcv, sizeof(msg_rcv), &msg_len, MSG_TOK, strlen(MSG_TOK)), LOG_MSG, FAC,"msg_recv(%s)", MSG_TOK );
-
-//              If slave supplied a run number extract it and compare
-                if ( msg_len > strlen(MSG_TOK) )
-                {
-                    sscanf( msg_rcv, MSG_TOK" %d", &run );  
-                    if ( run > fts_run ) 
-                    {
-                        mop_log( !fts_mkname( cam, fts_pfx, &run ), LOG_WRN, FAC, "Master RUN=%i low. Using Slave RUN=%i)", fts_run, run);
-                        fts_run = run;
-                    }
-                }
+                run = hsk_run;
+                mop_log( !fts_mkname( cam, fts_pfx, &run ), LOG_WRN, FAC, "Using Slave RUN=%i", hsk_run );
+                fts_run = hsk_run;
             }
 
+//          Filter wheel move should be long finished, but must be in position before acquisition  
+            mop_log( whl_wait( TMO_WHL ), LOG_DBG, FAC, "whl_wait()");
+            mop_log( foc_wait( TMO_FOC ), LOG_DBG, FAC, "foc_wait()");
+            clock_gettime( CLOCK_MONOTONIC, &whl_end );
+
+//          Exposure will not fit between triggers. Slaves reach the same verdict and reject too 
+            if ( !plan )
+            {
+                mop_log( false, LOG_ERR, FAC, "Run %i/%i skipped", run_cur.pos, run_cur.num );
+                at_try( cam, AT_Flush, L"", NULL ); // Discard queued buffers 
+                continue;
+            }
+
+//          Log the run setup critical path
+            mop_log( true, LOG_INF, FAC, "Run setup %.3fs"
+                     LOG_BLANK "CAM = %.3fs"
+                     LOG_BLANK "ROT = %.3fs"
+                     LOG_BLANK "HSK = %.3fs"
+                     LOG_BLANK "WHL = %.3fs wait",
+                     utl_ts_dif( &whl_end, &run_beg ), utl_ts_dif( &cam_end, &run_beg ),
+                     utl_task_dur( &task_rot ), one_cam ? 0.0 : utl_task_dur( &task_hsk ), utl_ts_dif( &whl_end, &run_end ) );
+
 //          CAUTION: AT_Command can take > 0.5s (!) to complete so call any fn() using them before rotation
 //          Reset camera clock and enable acquisition
             mop_log( cam_clk_rst( cam         ), LOG_DBG, FAC, "cam_clk_rst()"    );  
             mop_log( cam_acq_ena( cam, AT_TRUE), LOG_DBG, FAC, "cam_acq_ena(true)");  
 
-//          If not single camera, signal slave that rotation is starting
+//          If not single camera, signal slaves that rotation is starting
             if ( !one_cam )
-                mop_log(msg_send(TMO_ACK,MSG_ROT,ipslave,MSG_ACK,strlen(MSG_ACK)),LOG_MSG,FAC,"msg_send(%s)",MSG_ROT); 
+                mop_log(msg_fan(TMO_ACK,MSG_ROT,ipslaves,mop_slaves,MSG_ACK,strlen(MSG_ACK),NULL,NULL),LOG_MSG,FAC,"msg_fan(%s)",MSG_ROT); 
 
-//          Position rotator and start selected action 
+//          Position rotator and start selected action. Acquisition thread real-time while acquiring 
+            clock_gettime( CLOCK_MONOTONIC, &acq_beg );
+            sch_set( SCH_ACQ );
             if ( !rot_sign &&  // 0 = Static 
                  !rot_stp    ) // 0 = Single position
             {
 //              No rotation, single static position, software trigger (test mode) 
                 mop_log( rot_goto( rot_zero, TMO_ROTATOR, &rot_zero ), LOG_INF, FAC, "Static position=%f", rot_zero );
-                mop_log( cam_acq_stat( cam                          ), LOG_DBG, FAC, "cam_acq_stat(FIXED ANGLE)");
+                if ( !cam_stp )
+                    mop_log( cam_acq_stat( cam                      ), LOG_DBG, FAC, "cam_acq_stat(FIXED ANGLE)");
+                else
+                    mop_log( cam_acq_step( cam                      ), LOG_DBG, FAC, "cam_acq_step(FIXED ANGLE)");
             }
             else if ( rot_sign ) // Rotating with hardware triggering (normal mode) 
             {
 //              Enable hardware trigger, start rotation, circular acquisition 
                 mop_log( rot_trg_ena( true ), LOG_DBG, FAC, "rot_trg_ena(true)" );
                 mop_log( rot_move(rot_final), LOG_DBG, FAC, "rot_move(final)"   );
+                clock_gettime( CLOCK_MONOTONIC, &acq_beg );
+
+//              Park rotator for next run as soon as the last trigger has fired 
+                utl_task_run( &task_drn, "DRN", run_drn );
                 mop_log( cam_acq_circ(cam  ), LOG_DBG, FAC, "cam_acq_circ()"    );
+                utl_task_wait( &task_drn );
                 mop_log( rot_trg_ena( false), LOG_DBG, FAC, "rot_trg_ena(false)"); 
             }
             else // Rotating with software triggering (alternate test mode) 
             {
-                mop_log( cam_acq_stat( cam ), LOG_DBG, FAC, "cam_acq_stat(ROTATING)");
+                if ( !cam_stp )
+                    mop_log( cam_acq_stat( cam ), LOG_DBG, FAC, "cam_acq_stat(ROTATING)");
+                else
+                    mop_log( cam_acq_step( cam ), LOG_DBG, FAC, "cam_acq_step(STEPPED)");
             }
+
+//          Write co-added stacks and master bias or dark, if any. Timing reports. Fit focus at end of sweep 
+            sch_set( SCH_OTH );
+            mop_log( stk_write( cam ), LOG_DBG, FAC, "stk_write()" );
+            mop_log( lib_done ( cam ), LOG_DBG, FAC, "lib_done()"  );
+            mop_log( xfr_drain( XFR_DRAIN ), LOG_DBG, FAC, "xfr_drain()" );
+            mop_log( trg_done ( cam ), LOG_DBG, FAC, "trg_done()"  );
+            mop_log( sch_done (     ), LOG_DBG, FAC, "sch_done()"  );
+            mop_log( foc_run  ( run_cur.pos <= 1, run_cur.pos >= run_cur.num ), LOG_DBG, FAC, "foc_run()" );
+
+//          Dead time between end of previous acquisition and start of this one, excluding idle time waiting for a RUN
+            if ( acq_end.tv_sec )
+                mop_log( true, LOG_INF, FAC, "Dead time = %.3fs. Idle = %.3fs. Queued = %i",
+                         utl_ts_dif( &acq_beg, &acq_end ) - utl_ts_dif( &idl_end, &idl_beg ), utl_ts_dif( &idl_end, &idl_beg ), queued );
+            clock_gettime( CLOCK_MONOTONIC, &acq_end );
+
+//          Sequence summary once last run is done or the rest were aborted 
+            seq_acq += utl_ts_dif( &acq_end, &acq_beg );
+            if ( run_cur.pos && ( run_cur.pos == run_cur.num || !msg_queued() ) )
+                mop_log( true, LOG_INF, FAC, "Sequence %i/%i runs = %.3fs. Acquiring = %.3fs. Overhead = %.3fs (%.3fs/run)",
+                         run_cur.pos, run_cur.num, utl_ts_dif( &acq_end, &seq_beg ), seq_acq, 
+                         utl_ts_dif( &acq_end, &seq_beg ) - seq_acq, ( utl_ts_dif( &acq_end, &seq_beg ) - seq_acq ) / run_cur.pos );
         }
     }
     else // Running as slave
     {
-//      Network, camera and image inits
-        mop_log( msg_init ( ipslave      ), LOG_DBG, FAC, "msg_init()" );   
-        mop_log( cam_init ( cam_num      ), LOG_DBG, FAC, "cam_init()" );
-        mop_log( cam_open ( cam          ), LOG_DBG, FAC, "cam_open()" );
-        mop_log( cam_conf ( cam, cam_exp ), LOG_DBG, FAC, "cam_conf()" );
-        mop_log( cam_alloc( cam          ), LOG_DBG, FAC, "cam_alloc()");
-        mop_log( cam_cool ( cam, cam_temp, TMO_TOK, cam_quick ), LOG_DBG, FAC, "cam_cool()");
+//      Network first, then camera init. in background so RUN messages can be accepted immediately
+//      Camera N listens on entry N-1 of the slave list 
+        clock_gettime( CLOCK_MONOTONIC, &mop_beg );
+        if ( cam_num > mop_slaves )
+            mop_exit( mop_log( EXIT_FAILURE, LOG_CRIT, FAC, "Camera %i has no entry in -S slave list of %i", cam_num+1, mop_slaves ));
+        ipslave = ipslaves[cam_num-1];
+        ini_rdy( mop_log( msg_init( ipslave ), LOG_DBG, FAC, "msg_init()" ), "Network" );   
+        utl_task_run( &ini_cam, "CAM", ini_cam_fn );
 
 //      Forever loop
         for(;;)
         { 
-//          Wait for run message 
-            while( !mop_log(msg_recv(0,msg_rcv,sizeof(msg_rcv),&msg_len,MSG_RUN,strlen(MSG_RUN)),LOG_DBG,FAC,"msg_recv(%s)",msg_rcv));
+//          Take next run of a sequence or wait for a RUN or SEQ message from master 
+            while( !msg_pop( &run_cur ) )
+                msg_idle( 0 );
+
+//          Camera settings are changed by re-parse so wait if still initialising
+            utl_task_wait( &ini_cam );
 
 //          Extract run-time arguments, re-parse and re-init
+            strncpy( msg_rcv, run_cur.run, sizeof(msg_rcv)-1 );  
             argc = utl_msg2arg( argv, msg_rcv, &msg_typ );   
             mop_log( mop_opts ( argc, argv, CAM_ARGS, CAM_CHKS), LOG_DBG, FAC, "mop_opts(Re-parse)"); 
             mop_log( mop_init (                               ), LOG_DBG, FAC, "mop_init(Re-init)" ); 
+            if ( cam_bits )
+                mop_log( cal_pick ( cam, cam_bits, cam_noise      ), LOG_DBG, FAC, "cal_pick()" ); 
             mop_log( cam_conf ( cam, cam_exp                  ), LOG_DBG, FAC, "cam_conf(Re-conf)" );
 
+//          Reject run if exposure will not fit between triggers 
+            if ( !cam_plan( cam ) )
+            {
+                mop_log( msg_send( TMO_MSG, MSG_REJ, ipmaster, MSG_ACK, strlen(MSG_ACK)), LOG_MSG, FAC,"msg_send(%s)", MSG_REJ );
+                continue;
+            }
+
 //          Queue images, re-check temperature 
             mop_log( cam_queue ( cam ), LOG_DBG, FAC, "cam_queue()" );
+            mop_log( stk_init  ( cam ), LOG_DBG, FAC, "stk_init()" );
+            mop_log( lib_init  ( cam ), LOG_DBG, FAC, "lib_init()" );
+            mop_log( trg_init  (     ), LOG_DBG, FAC, "trg_init()" );
             mop_log( cam_cool( cam, cam_temp, TMO_TOK, cam_quick ), LOG_DBG, FAC, "cam_cool()");
 
 //          Init. filename for this run 
@@ -178,20 +458,35 @@ int main( int argc, char *argv[] )
             sprintf( msg_snd, MSG_TOK" %i", fts_run ); 
 
 //          Tell master temperature is OK and wait for ACK
-            mop_log( msg_send( TMO_MSG, msg_snd, ipmaster, MSG_ACK, strlen(MSG_ACK)), LOG_MSG, FAC,"msg_send(%s)",msg_snd); 
+//          A NAK for a sequence run means master aborted the sequence before starting it, so skip it 
+            if ( !mop_log( msg_send( TMO_MSG, msg_snd, ipmaster, MSG_ACK, strlen(MSG_ACK)), LOG_MSG, FAC,"msg_send(%s)",msg_snd) &&
+                 run_cur.pos > 1 )
+            {
+                mop_log( false, LOG_WRN, FAC, "Sequence run %i/%i skipped", run_cur.pos, run_cur.num );
+                at_try( cam, AT_Flush, L"", NULL ); // Discard queued buffers 
+                continue;
+            }
 
 //          Reset camera clock and enable acquisition
             mop_log( cam_clk_rst( cam          ), LOG_DBG, FAC, "cam_clk_rst()" );  
             mop_log( cam_acq_ena( cam, AT_TRUE ), LOG_DBG, FAC, "cam_acq_ena(T)");  
 
 //          Synchronise on rotation starting
-            mop_log( msg_recv(TMO_ROT,msg_rcv,sizeof(msg_rcv),&msg_len,MSG_ROT,strlen(MSG_ROT)),LOG_MSG,FAC,"msg_recv(%s)",MSG_ROT); 
+            mop_log( msg_wait(TMO_ROT,msg_snd,sizeof(msg_snd)-1,&msg_len,MSG_ROT,strlen(MSG_ROT)),LOG_MSG,FAC,"msg_wait(%s)",MSG_ROT); 
 
-//          Acquire images	
+//          Acquire images, real-time while acquiring	
+            sch_set( SCH_ACQ );
             if ( rot_sign )
                 mop_log( cam_acq_circ( cam ), LOG_DBG, FAC, "cam_acq_circ()");
-            else
+            else if ( !cam_stp )
                 mop_log( cam_acq_stat( cam ), LOG_DBG, FAC, "cam_acq_stat()");
+            else
+                mop_log( cam_acq_step( cam ), LOG_DBG, FAC, "cam_acq_step()");
+            sch_set( SCH_OTH );
+            mop_log( stk_write( cam ), LOG_DBG, FAC, "stk_write()" );
+            mop_log( lib_done ( cam ), LOG_DBG, FAC, "lib_done()"  );
+            mop_log( trg_done ( cam ), LOG_DBG, FAC, "trg_done()"  );
+            mop_log( sch_done (     ), LOG_DBG, FAC, "sch_done()"  );
         } 
     }
 }
@@ -26,6 +26,9 @@
 #include <pthread.h>
 #include <dirent.h>
 #include <wchar.h> 
+#include <stdint.h>
+#include <poll.h>
+#include <termios.h>
 
 // System headers
 #include <sys/dir.h>
@@ -36,6 +39,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 
 // Linux headers
 #include <linux/hidraw.h>
@@ -58,11 +62,11 @@
 
 // Argument options, OPTS and checks, CHKS 
 // CAM = Camera run-time options, MSG = Message options, CMD = Command options       
-#define OPTS_CAM      "p:m:u:l:c:E:i:h?s"
-#define OPTS_MSG      "b:U:e:x:f:n:o:r:v:t:q:S:M:W:O:R:D:F:C:A:Z:d:a:L:w:N:k"
+#define OPTS_CAM      "p:m:u:l:c:E:i:h?sj:G:KV:@:"
+#define OPTS_MSG      "b:U:e:x:f:n:o:r:v:t:q:S:M:W:O:R:D:F:C:A:Z:d:a:L:w:N:kP:QXy:Y:g:z:B:T:H:J:I:"
 
-#define CHKS_CAM      "pmulcEihs"
-#define CHKS_MSG      "bUexfnorvtqSMWORDFCAZdaLwNk"
+#define CHKS_CAM      "pmulcEihsjGKV@"
+#define CHKS_MSG      "bUexfnorvtqSMWORDFCAZdaLwNkPQXyYgzBTHJI"
 
 #define CAM_ARGS      OPTS_MSG OPTS_CAM 
 #define CAM_CHKS      CHKS_MSG CHKS_CAM
@@ -89,6 +93,20 @@
 #define MSG_TRG   "TRG" //!< Process sync, SW trigger 
 #define MSG_REJ   "REJ" //!< Request rejected 
 #define MSG_IMG   "CAM" //!< Image written 
+#define MSG_GAP   "GAP" //!< Frame missed, sent in place of its notification
+#define MSG_SEQ_T "SEQ" //!< Sequence of runs
+#define MSG_FOC   "FOCUS" //!< Focus sweep result sent to command process
+#define MSG_FMV   "FOCMOVE" //!< Focus sweep, move telescope focus. Sent to command process
+#define MSG_FDN   "FOCDONE" //!< Focus sweep, telescope focus in position. Sent to master
+#define MSG_QRY   "QRY" //!< Query run queue
+#define MSG_ABT   "ABT" //!< Abort queued runs
+
+// Message queue
+#define MSG_LEN   1024 //!< Message buffer size
+#define MSG_SEQ   8192 //!< Sequence message buffer size 
+#define MSG_QUEUE 64   //!< Max. number of queued RUN requests
+#define MSG_HOLD  8    //!< Max. messages held for a later waiter, e.g. an early TOK
+#define MSG_SLICE 50   //!< Socket poll slice so a waiter sees messages held by another thread [ms] 
 
 // Andor error ranges
 #define AT_ERR_MIN 0
@@ -124,6 +142,19 @@
 #define FAC_MSG  8  //!< Inter process messaging
 #define FAC_WHL  9  //!< Filter wheel     
 #define FAC_CMD  10 //!< Commands to service 
+#define FAC_SHM  11 //!< Shared memory frame ring 
+#define FAC_XFR  12 //!< Frame transfer and pairing
+#define FAC_CAL  13 //!< Readout mode calibration
+#define FAC_STK  14 //!< Co-added stacks
+#define FAC_POL  15 //!< Polarimetry reduction
+#define FAC_LIB  16 //!< Master bias and dark library
+#define FAC_IMG  17 //!< Image statistics
+#define FAC_AEX  18 //!< Acquisition auto-exposure
+#define FAC_FOC  19 //!< Focus sweep
+#define FAC_BPM  20 //!< Bad pixel map
+#define FAC_TRG  21 //!< Trigger timing diagnostics
+#define FAC_SCH  22 //!< Real-time scheduling profile
+#define FAC_TST  23 //!< Self tests 
 
 // ANSI text colour 30=Black, 31=red, 32=green, 33=yellow, 34=blue, 35=magenta, 36=cyan, 37=white  
 #define COL_RED     "\x1b[31m"  
@@ -148,6 +179,7 @@
 #define TMO_MSG         30              //!< [s]  Timeout Sync. on message
 #define TMO_XFR         30000           //!< [ms] Timeout Image transfer  
 #define TMO_WHL         10000           //!< [ms] Timeout filter wheel   
+#define TMO_FOC         120             //!< [s]  Timeout Telescope focus move during sweep
 
 // PI prefix = ROT_
 #define ROT_BAUD        460800          //!< Baud rate 
@@ -155,10 +187,12 @@
 #define ROT_STP8        45.0            //!< [deg] Step between triggers,  8 position  
 #define ROT_STP16       22.5            //!< [deg] Step between triggers, 16 position
 #define ROT_STP32       11.25           //!< [deg] Step between triggers, 32 postion 
+#define ROT_STP_RES     10000           //!< Steps per degree. N positions/rev. must give a whole number of steps 
 #define ROT_VEL         45.0            //!< [deg/s] Default rotator velocity deg/sec 
 #define ROT_REVS        3               //!< Default revolutions
 #define ROT_ZERO        0.0             //!< [deg] Default starting position
 #define ROT_TOLERANCE   0.004           //!< [deg] Rotator tolerance 
+#define ROT_SETTLE      0.10            //!< [s] Settling time after a step move 
 #define ROT_LIM_MAX     36000.0         //!< Limit: Maximum travel distance      
 #define ROT_VEL_MAX     360.0           //!< Limit: Maximum velocity 
 
@@ -180,6 +214,7 @@
 #define ROT_TRG_HI      "CTO 1 7 1"     //!< Trigger polarity high
 #define ROT_TRG_LO      "CTO 1 7 0"     //!< Trigger polarity low
 #define ROT_TRG_POSBEG  "CTO 1 8 0"     //!< Value: Trigger start when position=0.0 deg       
+#define ROT_TRG_OFF     0.0             //!< [deg] First trigger offset from zero position, see ROT_TRG_POSBEG
 #define ROT_TRG_POSEND  "CTO 1 9 %f"    //!< Value: Trigger ends at this travel limit      
 #define ROT_TRG_POSINIT "CTO 1 10 0"    //!< Value: Trigger enabled at position=0.0 deg       
 #define ROT_TRG_LEN     "CTO 1 11 50"   //!< Trigger pulse width in 33.3ns increments
@@ -193,11 +228,86 @@
 // Filter wheel defines
 #define WHL_DEV		"/dev/hidraw0"	//!< Filter wheel device 
 
+// Shared memory frame ring 
+#define SHM_NAME     "/mopnet%i"      //!< Ring name. Camera number appended
+#define SHM_SLOTS    8                //!< Default number of frame slots
+#define SHM_MAGIC    0x4D4F5052       //!< "MOPR" Marks ring as valid
+#define SHM_VERSION  1                //!< Layout version. Change if shm_ring_t or shm_frm_t change  
+#define SHM_ALIGN    4096             //!< Slot alignment [bytes] 
+
+// Frame transfer and pairing
+#define XFR_PORT     0                //!< Default TCP port. 0 = disabled 
+#define XFR_PEND     4                //!< Frames per camera waiting for a pair, or slave frames waiting to send
+#define XFR_TMO      2                //!< [s] Slave send and connect timeout 
+#define XFR_DRAIN    5                //!< [s] Master wait at end of run for late slave frames to pair
+
+// Readout mode calibration
+#define CAL_FILE     "/var/tmp/mopnet%i.cal" //!< Mode cache. Camera number appended 
+#define CAL_FRAMES   5                //!< Frames used to measure frame period
+
+// Co-added stacks
+#define STK_ALIGN    64               //!< Accumulator alignment [bytes] 
+
+// Image statistics
+#define IMG_HIST     65536            //!< Histogram bins, one per ADU 
+#define IMG_SAMPLES  262144           //!< Approx. pixels sampled for histogram 
+#define IMG_SAT      0.95             //!< Saturated above this fraction of ADU or well limit 
+#define IMG_SRC_NSIG 5.0              //!< Source detection threshold, background sigma 
+#define IMG_SRC_NPIX 4                //!< Min. pixels in a source, fewer are hot pixels or cosmics
+#define IMG_SRC_MAX  4096             //!< Max. connected components per frame
+#define IMG_SRC_TOP  5                //!< Brightest sources reported 
+
+// Acquisition auto-exposure
+#define AEX_PEAK     0.5              //!< Default target peak, fraction of saturation level 
+#define AEX_FRAMES   6                //!< Max. frames in pre-pass 
+#define AEX_STEP     8.0              //!< Max. exposure change per frame, up or down 
+#define AEX_TOL      0.15             //!< Done when peak within this fraction of target
+#define AEX_EXP_MAX  30.0             //!< [s] Max. exposure, as -e option 
+#define AEX_VEL_MIN  5.0              //!< [deg/s] Min. rotator velocity before binning up 
+#define AEX_BIN_MAX  4                //!< Max. binning used 
+
+// Focus sweep
+#define FOC_MIN      3                //!< Min. points for parabola fit 
+#define FOC_ENV      "MOP_FOCUS"      //!< Environment. Command moving telescope focus, position appended
+
+// Master bias and dark library
+#define LIB_FILE     "/var/tmp/mopnet_%s.fits" //!< Master file. Configuration key inserted
+#define LIB_GRP      8                //!< Group means combined by median 
+#define LIB_MAX      8                //!< Masters cached in memory
+
+// Bad pixel map
+#define BPM_NSIG     8.0f             //!< Flag pixels this many robust sigma from master dark median
+#define BPM_ADU      10.0f            //!< [ADU] ... and at least this far 
+#define BPM_SAMPLES  65536            //!< Max. master pixels sampled for median and sigma
+#define BPM_HOT      1                //!< Map value of hot pixel
+#define BPM_COLD     2                //!< Map value of cold pixel
+#define BPM_OFF      0                //!< -I0 Map not used
+#define BPM_DQ       1                //!< -I1 Map written as DQ extension
+#define BPM_FIX      2                //!< -I2 Flagged pixels interpolated
+
+// Trigger timing diagnostics
+#define TRG_FILE     "%s/%c_%c_%i_trg.txt" //!< Run report. Directory, camera, type and run inserted
+#define TRG_CLIP     5.0              //!< Skew refit excludes pairs beyond this x median residual 
+#define TRG_CLIP_MIN 1.0E-6           //!< [s] ... but keeps all within this
+
+// Real-time scheduling profile roles
+#define SCH_ACQ      0                //!< Acquisition loop. SCHED_FIFO on own core
+#define SCH_ROT      1                //!< Rotator drain task. Own core
+#define SCH_XFR      2                //!< Pairing receiver. Other cores
+#define SCH_OTH      3                //!< Everything else. Other cores
+#define SCH_ROLES    4
+
+// Polarimetry reduction
+#define POL_MIN_DET  1.0E-6           //!< Min. design matrix determinant, below this q/u are not separable
+
 // FITS file defines
 #define FTS_SFX       "_0.fits"         //!< FITS file suffix 
+#define FTS_SFX_PAIR  "_pair.fits"      //!< Paired product suffix 
+#define FTS_SFX_POL   "_pol.fits"       //!< Stokes q/u product suffix 
 #define FTS_PFX       "%i_"             //!< FITS file prefix 
 #define FTS_INIT      -1                //!< Init. fts_mkname() 
 #define FTS_NEXT       0                //!< Get next fts_mkname()
+#define FTS_STACK     -2                //!< Get next co-added stack fts_mkname()
                                            
 // File prefix
 #define FTS_PFX_BIAS  'b'               //!< Bias frame
@@ -228,6 +338,9 @@
 #define TIM_MILLISECOND  1000.0
 #define TIM_MICROSECOND  1000000.0
 #define TIM_NANOSECOND   1000000000
+
+// Memory size constants
+#define MEM_MB           1048576.0  //!< [bytes] Megabyte
                                
 // Camera idenification
 #define CAM1     0          //!< Device index. 0 is master
@@ -236,8 +349,17 @@
 
 // Camera defaults
 #define CAM_COUNT      2     //!< Total number: Prototype = 2
+#define CAM_MAX        6     //!< Max. cameras in a network, one per FTS_ID character 
 #define CAM_TEMP       4.0   //!< [deg C] Target cooling temperature  
 #define CAM_EXP        0.45  //!< [s] Default exposure time 
+#define CAM_STP_LEAD   0.25  //!< [s] Stepped mode. Schedule start ahead of now so slaves receive it in time
+#define CAM_STP_MARGIN 0.02  //!< [s] Stepped mode. Period margin and allowed trigger lateness
+#define CAM_BUF_ALIGN  64    //!< [bytes] Image arena alignment of scratch and buffers. SDK needs 8
+#define CAM_HUGE_PAGE  0x200000 //!< [bytes] Hugepage size. Image arena is mapped in multiples
+#define CAM_GAP_TRY    3     //!< Rotating mode. Consecutive failed buffer waits before remaining frames are gaps
+#define CAM_GAP_WAIT   1.5   //!< Rotating mode. Buffer wait after first frame, trigger periods plus exposure
+#define CAM_GAP_LEAD   1.0   //!< [s] Rotating mode. First buffer wait allowance for rotation start, added to lead-in
+#define CAM_ANCHOR_TOL 0.25  //!< Rotating mode. Max. first frame timing error, fraction of trigger period
 
 // Binning 
 #define CAM_BIN_1      L"1x1" //!< Binning 1x1
@@ -274,6 +396,17 @@
 #define CAM_ENC_16     L"Mono16"
 #define CAM_ENC_32     L"Mono32"
 
+// Metadata appended to each frame. Blocks are data, CID and length, parsed backwards from the buffer end 
+#define CAM_MD_FIELD   4     //!< [bytes] CID and length field size. Length counts CID and data 
+#define CAM_MD_BLOCKS  8     //!< Max. blocks parsed 
+#define CAM_MD_FRAME   0     //!< CID: Frame data, pixels with any row padding 
+#define CAM_MD_TICKS   1     //!< CID: Timestamp clock, 64-bit 
+#define CAM_MD_INFO    7     //!< CID: Frame info, stride, encoding, width, height 
+#define CAM_MD_INFO_N  8     //!< [bytes] Frame info size. uint16 stride, uint8 encoding, uint8 reserved, uint16 width, height 
+#define CAM_MD_ENC_12  0     //!< Frame info encoding Mono12 
+#define CAM_MD_ENC_12P 1     //!< Frame info encoding Mono12Packed 
+#define CAM_MD_ENC_16  2     //!< Frame info encoding Mono16 
+
 // Trigger source
 #define CAM_TRG_INT    L"Internal" 
 #define CAM_TRG_EDGE   L"External" 
@@ -286,7 +419,7 @@
 #define IMG_DIMENSIONS 2     //!< Numer of dimension on sCMOS chip 
 #define IMG_CYCLE      16    //!< Default images per revolution 
 #define IMG_TOTAL      IMG_CYCLE * ROT_REVS     
-#define MAX_CYCLE      16    //<! Max. images per revolution 
+#define MAX_CYCLE      64    //<! Max. images per revolution and image buffer ring size 
 #define MAX_REVS       100   //<! Max. PI stage rotations
 #define MAX_IMAGES     MAX_CYCLE * MAX_REVS
 
@@ -313,6 +446,48 @@ typedef struct cam_info_s
 } cam_info_t;
 
 
+/// Statistics of one frame [ADU]
+///
+typedef struct img_sta_s
+{
+    uint16_t min;              //!< Minimum 
+    uint16_t max;              //!< Maximum
+    double   mean;             //!< Mean
+    double   median;           //!< Median, from sampled histogram
+    double   bkg;              //!< Background, mode estimate from sampled histogram
+    double   sigma;            //!< Background noise, from interquartile range
+    uint32_t sat;              //!< Pixels above saturation level
+    uint16_t lim;              //!< Saturation level
+} img_sta_t;
+
+/// Source found in a frame. Image pixels, 1-based as FITS 
+///
+typedef struct img_src_s
+{
+    double   x;                //!< [px] Flux weighted centroid
+    double   y;
+    double   flux;             //!< [ADU] Sum above background
+    double   fwhm;             //!< [px] From second moments, Gaussian equivalent 
+    uint32_t npix;             //!< Pixels above threshold
+    uint16_t peak;             //!< [ADU] Brightest pixel 
+} img_src_t;
+
+/// Frame metadata decoded in place. Pointers are into the image buffer
+///
+typedef struct cam_md_s
+{
+    AT_U8   *pix;              //!< Frame data. NULL = No frame data block 
+    size_t   bytes;            //!< [bytes] Frame data size, with any row padding 
+    uint64_t ticks;            //!< Detector timestamp clock 
+    uint16_t stride;           //!< [bytes] Row stride 
+    uint16_t width;            //!< [px] Width 
+    uint16_t height;           //!< [px] Height 
+    uint8_t  enc;              //!< Pixel encoding, CAM_MD_ENC_xxx 
+    bool     has_ticks;        //!< Timestamp block decoded 
+    bool     has_info;         //!< Frame info block decoded 
+    int      blocks;           //!< Blocks decoded 
+} cam_md_t;
+
 /// Camera structure. Member names match Andor SDK V3.12 (mostly)
 ///
 typedef struct mop_cam_s
@@ -327,6 +502,7 @@ typedef struct mop_cam_s
     double Gain;            
     double Noise;  
     char  *Filter;
+    double PolAngle;           //!< [deg] Polarisation angle WRT rotator
     char  *FilterID;
 
     AT_U8 *UserBuffer;
@@ -345,6 +521,12 @@ typedef struct mop_cam_s
     AT_64  TimestampClock[MAX_IMAGES]; 
     unsigned long Ticks[MAX_IMAGES];
     AT_BOOL FullAOIControl;
+    AT_64  AOIWidth;           //!< [px] Area of interest width, binned
+    AT_64  AOIHeight;          //!< [px] Area of interest height, binned
+    AT_64  AOILeft;            //!< [px] Area of interest left column, 1-based unbinned
+    AT_64  AOITop;             //!< [px] Area of interest top row, 1-based unbinned
+    AT_64  AOIStride;          //!< [bytes] Row length in camera buffer incl. padding
+    AT_64  BufferBytes;        //!< [bytes] Size of each ImageBuffer
     unsigned char *ReturnBuffer[MAX_IMAGES];
     int            ReturnSize  [MAX_IMAGES];
 
@@ -361,12 +543,102 @@ typedef struct mop_cam_s
     int    SeqN[MAX_IMAGES];   //!< Position within rotation 1-8 or 1-16 
     struct timeval ObsStart;
     struct timeval ObsEnd;
+    img_sta_t Sta;             //!< Statistics of last frame written
+    img_src_t Src[IMG_SRC_TOP];//!< Brightest sources in last acquisition frame 
+    int       SrcN;            //!< Sources found. Src holds up to IMG_SRC_TOP. -1 = Not searched
+    cam_md_t  Meta;            //!< Metadata of last frame unpacked 
+    int       GapN;            //!< Frames missed this run 
+    bool      Anchored;        //!< First frame's trigger confirmed by its timestamp this run
 
     char   id;                 //!< FITS file prefix
     int   seq;                 //!< Sequence 
     char *dir;                 //!< Destination directory
 } mop_cam_t;
 
+/// Task run concurrently by utl_task_run() and joined by utl_task_wait()
+///
+typedef struct mop_task_s
+{
+    pthread_t thread;          //!< Thread running task function
+    char     *name;            //!< Task name for logging
+    bool    (*fn)( void );     //!< Task function
+    bool      ok;              //!< Task function result
+    bool      busy;            //!< Started but not yet joined
+    struct timespec beg;       //!< [CLOCK_MONOTONIC] Task start
+    struct timespec end;       //!< [CLOCK_MONOTONIC] Task end
+} mop_task_t;
+
+/// Queued run. Either a single RUN request or one run taken from a sequence 
+///
+typedef struct msg_run_s
+{
+    char run[MSG_LEN];         //!< RUN message for this run
+    char seq[MSG_SEQ];         //!< Whole SEQ message. Only held by first run in sequence
+    int  pos;                  //!< Position in sequence 1 to num. 0 = not a sequence 
+    int  num;                  //!< Number of runs in sequence
+} msg_run_t;
+
+/// Shared memory frame ring header. Slots follow at offset data
+///
+typedef struct shm_ring_s
+{
+    uint32_t magic;            //!< SHM_MAGIC once ring is ready
+    uint32_t version;          //!< SHM_VERSION
+    uint32_t slots;            //!< Number of frame slots
+    uint32_t spare;
+    uint64_t slot_size;        //!< [bytes] Slot size including header 
+    uint64_t frame_max;        //!< [bytes] Max. pixel data per slot
+    uint64_t data;             //!< [bytes] Offset to first slot 
+    uint64_t size;             //!< [bytes] Total ring size
+    uint64_t head;             //!< Number of frames published. Next frame number
+} shm_ring_t;
+
+/// Shared memory frame slot header. Mono16 pixel data follows immediately
+///
+typedef struct shm_frm_s
+{
+    uint64_t lock;             //!< Sequence lock. Odd = being written
+    uint64_t frame;            //!< Frame number since process start
+    int32_t  run;              //!< Run number
+    int32_t  cam;              //!< Camera number
+    int32_t  rot_n;            //!< Rotation number 
+    int32_t  seq_n;            //!< Position within rotation 
+    int32_t  width;            //!< [px] Image width
+    int32_t  height;           //!< [px] Image height
+    char     pfx;              //!< FITS file prefix, image type
+    double   exp;              //!< [s] Exposure time 
+    double   rot_req;          //!< [deg] Requested rotator position
+    double   rot_ang;          //!< [deg] Rotator angle 
+    double   rot_end;          //!< [deg] End rotator position
+    double   rot_dif;          //!< [deg] Length of arc
+    double   temp;             //!< [C] Sensor temperature
+    uint64_t clock;            //!< Detector timestamp clock
+    uint64_t clock_frq;        //!< [Hz] Detector timestamp clock frequency
+    struct timeval obs_start;  //!< Observation start
+    struct timeval obs_end;    //!< Observation end
+    uint64_t bytes;            //!< [bytes] Pixel data size
+    char     name[MAX_STR];    //!< FITS file name
+} __attribute__((aligned(64))) shm_frm_t;
+
+/// Co-added stack of one rotator position across all rotations
+///
+typedef struct stk_pos_s
+{
+    int      num;              //!< Frames added
+    double   exp;              //!< [s] Summed exposure
+    double   req;              //!< [deg] Requested angle, first frame
+    double   ang;              //!< [deg] Begin angle, first frame 
+    double   ang_sum;          //!< [deg] Sum of begin angle offsets from first frame 
+    double   ang_sq;           //!< [deg^2] Sum of squared offsets
+    double   end;              //!< [deg] End angle, first frame 
+    double   end_sum;          //!< [deg] Sum of end angle offsets from first frame 
+    double   end_sq;           //!< [deg^2] Sum of squared offsets
+    double   arc_sum;          //!< [deg] Sum of exposure arcs 
+    struct timeval obs_start;  //!< First frame start
+    struct timeval obs_end;    //!< Last frame end
+    uint32_t *sum;             //!< Accumulated pixels 
+} stk_pos_t;
+
 // Macros
 #define btoa(x) ((x)?"true":"false")  /// Boolean to ascii string 
 
@@ -387,6 +659,7 @@ bool   rot_goto( double  angle, int timeout, double *actual ); // Goto position
 bool   rot_wait( double  angle, int timeout, bool cw );        // Wait for position within timeout 
 bool   rot_trg_ena( bool enable );             // Trigger enable/disable 
 bool   rot_ont ( int delay );                  // Wait for on target state
+bool   rot_park( void );                       // Move to initial position for next run
 double rot_dbg( char *dbg );                   // Debug: Print & return rotator angle
 
 // Andor camera functions
@@ -396,6 +669,7 @@ bool cam_init    ( int i );
 bool cam_chk     ( mop_cam_t *cam );
 bool cam_open    ( mop_cam_t *cam );
 bool cam_conf    ( mop_cam_t *cam, double exp );
+bool cam_aoi     ( mop_cam_t *cam );                // Set area of interest
 bool cam_close   ( mop_cam_t *cam );
 bool cam_cool    ( mop_cam_t *cam, double TargetTemperature, int timeout, bool fast );
 bool cam_queue   ( mop_cam_t *cam );
@@ -403,6 +677,9 @@ bool cam_param   ( mop_cam_t *cam );
 bool cam_alloc   ( mop_cam_t *cam );                // Allocate memory buffers 
 void cam_feature ( mop_cam_t *cam, AT_WC *Feature );// Get feature options
 bool cam_acq_circ( mop_cam_t *cam );                // Acquire images - circular buffer
+bool cam_acq_step( mop_cam_t *cam );                // Acquire images - pipelined software trigger
+bool cam_ring    ( mop_cam_t *cam, int cycle );     // Size image buffer ring
+bool cam_plan    ( mop_cam_t *cam );                // Check exposure fits trigger interval
 bool cam_acq_stat( mop_cam_t *cam );                // Acquire images -static 
 bool cam_acq_ena ( mop_cam_t *cam, AT_BOOL );       // Acquisition enable/disable
 bool cam_trg_set ( mop_cam_t *cam, AT_WC *trg );    // Set trigger mode 
@@ -411,10 +688,15 @@ bool cam_clk_rst ( mop_cam_t *cam );                // Reset camera clock to zer
 // FITS file functions
 char *fts_mkname( mop_cam_t *cam, char typ, int *frun );
 bool  fts_write ( char *filename, mop_cam_t *cam, int seq, int buf );
+AT_U8*fts_mono16( mop_cam_t *cam, int buf );           // Mono16 pixels for a buffer
+bool  fts_stack ( char *filename, mop_cam_t *cam, stk_pos_t *pos, int seq ); // Co-added stack
+bool  fts_pair  ( shm_frm_t *mine, AT_U8 *mine_pix, shm_frm_t *peer, AT_U8 *peer_pix ); // Paired product
+bool  fts_pol   ( shm_frm_t *frm, int num, float *q, float *u, double fq, double fu ); // Stokes q/u product
 
 // Error & logging functions
 bool mop_log( bool ret, int level, int fac, char *fmt, ... );
 unsigned long cam_ticks( mop_cam_t *cam, int img );
+bool cam_meta( AT_U8 *buf, size_t size, cam_md_t *md ); // Decode frame metadata in place
 
 // Utility functions
 char *utl_arg2msg   ( int   argc, char *argv[], char  *typ );
@@ -426,16 +708,101 @@ struct timespec utl_dbl2ts( double dbl );
 struct timespec utl_ts_add( struct timespec *t1, struct timespec *t2 );
 struct timespec utl_ts_sub( struct timespec *t1, struct timespec *t2 );
 int             utl_ts_cmp( struct timespec *t1, struct timespec *t2 );
+double          utl_ts_dif( struct timespec *t1, struct timespec *t2 );
+double          utl_ts_sleep( struct timespec *t );     // Sleep until CLOCK_REALTIME time
+
+bool   utl_task_run ( mop_task_t *task, char *name, bool (*fn)(void) ); // Start concurrent task 
+bool   utl_task_wait( mop_task_t *task );                               // Join task, get result
+double utl_task_dur ( mop_task_t *task );                               // Task run time [s]
 
 // Network functions
 bool msg_init( char *ip );
 bool msg_recv( int timeout, char *recv, int max, int *len, char *exp, int explen );
 bool msg_send( int timeout, char *send, char *dst, char *exp, int explen );
 bool msg_chk ( char *msg,   char *exp, int explen );
+struct sockaddr_in msg_str2adr( char *ip_port );
+bool msg_wait( int timeout, char *recv, int max, int *len, char *exp, int explen );
+bool msg_poll( char *exp, int explen ); // Handle waiting queue control messages 
+bool msg_fan ( int timeout, char *send, char **dst, int num, char *exp, int explen, char rep[][MSG_LEN], double *lat );
+bool msg_idle( int timeout );           // Wait for and handle queue control messages 
+bool msg_push( char *run, int pos, int num, char *seq ); // Queue a run 
+bool msg_pop ( msg_run_t *run );        // Get oldest queued run 
+bool msg_clear( void );                 // Discard queued runs 
+int  msg_queued( void );                // Number of queued runs
+
+// Shared memory frame ring functions
+bool        shm_init  ( mop_cam_t *cam, int slots ); // Create ring
+bool        shm_exit  ( void );                      // Remove ring
+bool        shm_put   ( mop_cam_t *cam, int seq, char *name, void *pix, size_t bytes ); // Publish frame 
+bool        shm_meta  ( shm_frm_t *frm, mop_cam_t *cam, int seq, char *name, size_t bytes ); // Fill frame header
+shm_frm_t  *shm_last  ( char *name, int *fd, off_t *off, uint64_t *lock ); // Last published slot 
+shm_ring_t *shm_attach( char *name );                // Reader: map ring
+bool        shm_detach( shm_ring_t *ring );          // Reader: unmap ring
+shm_frm_t  *shm_next  ( shm_ring_t *ring, uint64_t *next, uint64_t *lock, uint64_t *missed ); // Reader: next frame
+bool        shm_done  ( shm_frm_t *frm, uint64_t lock ); // Reader: frame still valid after use
+
+// Frame transfer and pairing functions
+bool xfr_init( mop_cam_t *cam );        // Master listen, slave prepare 
+bool xfr_put ( mop_cam_t *cam, int seq, char *name, void *pix, size_t bytes ); // Send or pair frame
+bool xfr_drain( int timeout );          // Master wait for pairs to be written
+
+// Image statistics functions
+bool img_stats( mop_cam_t *cam, AT_U8 *pix, img_sta_t *sta ); // Single pass frame statistics 
+int  img_find ( mop_cam_t *cam, AT_U8 *pix, img_sta_t *sta, img_src_t *src ); // Detect and centroid sources 
+int  img_note ( char *buf, size_t len, char *name, mop_cam_t *cam ); // Notification with statistics and sources 
+
+// Acquisition auto-exposure functions
+bool aex_run( mop_cam_t *cam, char *opt, size_t len ); // Pre-pass for -xq runs. Master only 
+
+// Focus sweep functions
+bool foc_add( mop_cam_t *cam );         // Add metric of frame just searched
+bool foc_run( bool first, bool last );  // End of sweep run, fit after last
+bool foc_move( void );                  // Request focus move for this run. Master only
+bool foc_wait( int timeout );           // Wait for focus move to be confirmed
+
+// Master bias and dark library functions
+bool   lib_init ( mop_cam_t *cam );     // Start building if bias or dark run 
+bool   lib_add  ( AT_U8 *pix );         // Add frame to master being built
+bool   lib_done ( mop_cam_t *cam );     // Combine, cache and save master
+float *lib_apply( mop_cam_t *cam, AT_U8 *pix, char *ref ); // Calibrate to electrons
+
+// Bad pixel map functions
+bool     bpm_make( mop_cam_t *cam, const float *dark );              // Make and save map from master dark
+uint8_t *bpm_get ( mop_cam_t *cam, int *num, char *key );            // Map for current geometry
+AT_U8   *bpm_fix ( mop_cam_t *cam, AT_U8 *pix, const uint8_t *bad ); // Interpolated copy of frame
+int      bpm_dq  ( fitsfile *fp, mop_cam_t *cam, uint8_t *bad );     // Append DQ extension
+
+// Trigger timing diagnostics functions
+bool trg_init( void );                           // Start collecting for a run
+void trg_add ( mop_cam_t *cam, int seq );        // Record frame timestamp
+void trg_pair( shm_frm_t *mst, shm_frm_t *slv ); // Record timestamps of a paired frame
+bool trg_done( mop_cam_t *cam );                 // Summarise, log and write report
+
+// Real-time scheduling profile functions
+bool sch_init( void );                           // Lock memory, set cores for other threads
+bool sch_set ( int role );                       // Apply role to calling thread
+void sch_mark( int role );                       // Latency sample
+bool sch_done( void );                           // Log thread latencies this run
+
+// Polarimetry reduction functions
+bool pol_init( mop_cam_t *cam );        // Allocate accumulators 
+bool pol_add ( shm_frm_t *mine, AT_U8 *mine_pix, shm_frm_t *peer, AT_U8 *peer_pix ); // Add a frame pair
+
+// Co-added stack functions
+bool stk_init ( mop_cam_t *cam );       // Allocate and clear accumulators for this run 
+bool stk_add  ( mop_cam_t *cam, int seq, int buf ); // Add frame to its position
+bool stk_gap  ( void );                 // Note a missed frame
+bool stk_write( mop_cam_t *cam );       // Write stacks and notify 
+
+// Readout mode calibration functions
+bool cal_run ( mop_cam_t *cam );        // Calibrate all modes, write cache 
+bool cal_pick( mop_cam_t *cam, int bits, double noise ); // Apply fastest cached mode 
 
 // Filter wheel functions
 bool whl_init( int  pos, int timeout );
-bool whl_conf( int  pos, int timeout );
+bool whl_conf( int  pos, int timeout ); // Move and wait
+bool whl_move( int  pos );              // Start move
+bool whl_wait( int  timeout );          // Wait for move to complete
 
 // Include global data and external definitions
 #include "mop_dat.h"
@@ -0,0 +1,89 @@
+/** @file mopshm.c
+  *
+  * @brief MOPTOP example shared memory frame ring consumer.
+  *        Reads frames in-place from a running mopnet, reports each frame and overall throughput
+  *
+  * @author asp
+  *
+  * @date 2026-10-18
+  */
+
+#define MAIN
+#include "mopnet.h"
+#define FAC FAC_SHM
+
+/** @brief     Main
+  *
+  * @param[in] argc = argument count
+  * @param[in] argv = argument variables. Use -c to select camera ring
+  *
+  * @return    EXIT_SUCCESS | EXIT_FAILURE
+  */
+int main( int argc, char *argv[] )
+{
+    char        name[MAX_STR];
+    shm_ring_t *ring;
+    shm_frm_t  *frm;
+    uint16_t   *pix;
+    uint64_t    next   = 0;
+    uint64_t    lock;
+    uint64_t    missed = 0;
+    uint64_t    frames = 0;
+    uint64_t    bytes  = 0;
+    uint64_t    npix;
+    double      sum;
+    double      dur;
+    struct timespec beg;
+    struct timespec now;
+
+    log_fp = stdout; // Output to screen
+    cam_num = 0;     // Default camera 1 ring
+
+//  Parse command line arguments
+    mop_log( mop_opts( argc, argv, CAM_ARGS, CAM_CHKS ), LOG_DBG, FAC, "mop_opts()");
+    snprintf( name, sizeof(name), SHM_NAME, cam_num+1 );
+
+    if ( !( ring = shm_attach( name )))
+        return mop_log( EXIT_FAILURE, LOG_ERR, FAC, "shm_attach(%s) No frame ring. Is mopnet running?", name );
+    printf( "Attached to %s %u slots. Waiting for frames ...\n", name, ring->slots );
+
+//  Only want new frames
+    next = ring->head;
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+
+    for(;;)
+    {
+        if ( !( frm = shm_next( ring, &next, &lock, &missed )))
+        {
+            usleep( TIM_TICK );
+            continue;
+        }
+
+//      Use pixels in-place. Mean is an example of some real processing
+        pix  = (uint16_t *)( frm + 1 );
+        npix = frm->bytes / sizeof(uint16_t);
+        sum  = 0.0;
+        for ( uint64_t i = 0; i < npix; i++ )
+            sum += pix[i];
+
+//      Slot may have been overwritten while in use
+        if ( !shm_done( frm, lock ))
+        {
+            missed++;
+            continue;
+        }
+
+        frames++;
+        bytes += frm->bytes;
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        dur = utl_ts_dif( &now, &beg );
+
+        printf( "%6lu Run %i Cam %i Rot %2i Seq %2i %ix%i Exp %.3f Ang %7.2f Mean %8.1f %s\n",
+                frm->frame, frm->run, frm->cam, frm->rot_n, frm->seq_n, frm->width, frm->height,
+                frm->exp, frm->rot_ang, npix ? sum / npix : 0.0, frm->name );
+        printf( "       %lu frames %.1f frame/s %.1f MB/s %lu missed\n",
+                frames, frames / dur, bytes / dur / TIM_MICROSECOND, missed );
+    }
+
+    return EXIT_SUCCESS;
+}
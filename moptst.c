@@ -0,0 +1,592 @@
+/** @file moptst.c
+  *
+  * @brief MOPTOP self tests and benchmarks. Exercise modules without cameras, rotator or filter wheel.
+  *        Run all tests, or the tests and benchmarks named on the command line. Used by 'make test' and
+  *        'make bench'.
+  *
+  * @author asp
+  *
+  * @date 2026-10-18
+  */
+
+#define MAIN
+#include "mopnet.h"
+#define FAC FAC_TST
+
+#define TST_MASTER  "127.0.0.1:47101" //!< Master address under test 
+#define TST_SLAVE   "127.0.0.1:47102" //!< Stand-in slave 
+#define TST_COMMAND "127.0.0.1:47103" //!< Stand-in mopcmd 
+#define TST_XFR     47104             //!< Stand-in master frame port 
+#define TST_TMO     5                 //!< Test message timeout [sec] 
+#define TST_PUT     0.05              //!< Max. time to pass on a frame [sec] 
+#define TST_WHL     0.3               //!< Stand-in filter wheel move time [sec] 
+#define TST_LAG     0.05              //!< Allowed timing error [sec] 
+
+#define TST_FUZZ    200000            //!< Metadata fuzz iterations of each kind 
+#define TST_BCH     200               //!< Benchmark frames 
+#define TST_BCH_W   2048              //!< Benchmark frame width [px] 
+#define TST_BCH_H   2048              //!< Benchmark frame height [px] 
+#define TST_BCH_PAD 64                //!< Benchmark padded row extra [bytes] 
+
+/// Named test or benchmark 
+typedef struct tst_s
+{
+    char  *name;
+    bool (*fn)( void );
+    bool   bench;                     //!< Benchmark, only run when named 
+} tst_t;
+
+static int  tst_slv;                  // Stand-in slave socket
+static int  tst_cmd;                  // Stand-in mopcmd socket
+static char tst_tok[CAM_MAX][MSG_LEN];
+static char *tst_peer[] = { TST_SLAVE };
+static mop_cam_t tst_cam;
+static int  tst_lsn;                  // Stand-in master frame listener
+static int  tst_frames;               // Frames received whole by stand-in master
+static bool tst_stall;                // Stand-in master stops reading
+static char tst_last[MAX_STR];        // Name of last frame received
+static int  tst_pty = -1;             // Stand-in filter wheel, pty master side
+static int  tst_reqs;                 // Requests seen by stand-in filter wheel
+static bool tst_mute;                 // Stand-in filter wheel stops replying
+
+
+/** @brief     Bind a stand-in peer socket 
+  *
+  * @param[in] *ip_port = peer address 
+  *
+  * @return    Socket | -1 = Failure 
+  */
+static int tst_udp( char *ip_port )
+{
+    int fd;
+    struct sockaddr_in adr = msg_str2adr( ip_port );
+    struct timeval     tmo = { 1, 0 };
+
+    if ( (fd = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP )) < 0 ||
+         setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &tmo, sizeof(tmo) ) < 0 ||
+         bind( fd, (const struct sockaddr *)&adr, sizeof(adr) ) < 0 )
+        return mop_log( -1, LOG_SYS, FAC, "tst_udp(%s) %s", ip_port, strerror(errno) ); 
+
+    return fd;
+}
+
+
+/** @brief     Send from a stand-in peer to the master 
+  *
+  * @param[in]  fd  = peer socket 
+  * @param[in] *msg = message 
+  *
+  * @return    true | false = Sent | Failure 
+  */
+static bool tst_put( int fd, char *msg )
+{
+    struct sockaddr_in adr = msg_str2adr( TST_MASTER );
+
+    return sendto( fd, msg, strlen(msg), 0, (const struct sockaddr *)&adr, sizeof(adr) ) == strlen(msg);
+}
+
+
+/** @brief     Check the next message to a stand-in peer 
+  *
+  * @param[in]  fd  = peer socket 
+  * @param[in] *exp = expected message, NULL = none 
+  *
+  * @return    true | false = As expected | Not 
+  */
+static bool tst_get( int fd, char *exp )
+{
+    char msg[MSG_LEN];
+    int  len = recv( fd, msg, sizeof(msg)-1, 0 );
+
+    if ( len >= 0 )
+        msg[len] = '\0';
+
+    if ( !exp )
+        return len < 0 || mop_log( false, LOG_ERR, FAC, "Unexpected %s", msg );  
+    if ( len < 0 )
+        return mop_log( false, LOG_ERR, FAC, "No %s", exp );  
+
+    return msg_chk( msg, exp, strlen(exp) ) || mop_log( false, LOG_ERR, FAC, "Got %s. Expected %s", msg, exp );  
+}
+
+
+/** @brief     Report a failed check 
+  *
+  * @param[in]  ok   = check result 
+  * @param[in] *what = check description 
+  *
+  * @return    ok 
+  */
+static bool tst_chk( bool ok, char *what )
+{
+    return ok || mop_log( false, LOG_ERR, FAC, "%s", what );  
+}
+
+
+/** @brief     Master handshake thread stand-in. Collect TOK from the slave 
+  *
+  * @return    true | false = TOK collected | Failure 
+  */
+static bool tst_hsk( void )
+{
+    return msg_fan( TST_TMO, NULL, tst_peer, 1, MSG_TOK, strlen(MSG_TOK), tst_tok, NULL );
+}
+
+
+/** @brief     Master handshake thread stand-in. Send ROT to the slave and collect its ACK 
+  *
+  * @return    true | false = ACK collected | Failure 
+  */
+static bool tst_rot( void )
+{
+    return msg_fan( TST_TMO, MSG_ROT, tst_peer, 1, MSG_ACK, strlen(MSG_ACK), NULL, NULL );
+}
+
+
+/** @brief     Shared master socket. Messages read by the wrong master thread, or before they are 
+  *            waited for, reach their waiter and are never NAKed. Slave and mopcmd are stand-ins.
+  *
+  * @return    true | false = Pass | Fail 
+  */
+static bool tst_msg( void )
+{
+    char    msg[MSG_LEN];
+    int     len;
+    bool    ok = true;
+    mop_task_t hsk = {0};
+
+    if ( !msg_init( TST_MASTER ) ||
+         (tst_slv = tst_udp( TST_SLAVE   )) < 0 ||
+         (tst_cmd = tst_udp( TST_COMMAND )) < 0  )
+        return false;
+
+//  FOCDONE read by handshake thread while it waits for TOK, focus wait follows  
+    utl_task_run( &hsk, "HSK", tst_hsk );
+    usleep( 100 * TIM_TICK );
+    ok &= tst_put( tst_cmd, MSG_FDN" 1.0000" );
+    usleep( 100 * TIM_TICK );
+    ok &= tst_put( tst_slv, MSG_TOK" 7" );
+    ok &= tst_chk( msg_wait( TST_TMO, msg, sizeof(msg)-1, &len, MSG_FDN, strlen(MSG_FDN) ), "FOCDONE held by handshake" );
+    ok &= tst_chk( utl_task_wait( &hsk ) && msg_chk( tst_tok[0], MSG_TOK" 7", 5 ), "TOK collected" );
+    ok &= tst_get( tst_slv, MSG_ACK ) && tst_get( tst_cmd, MSG_ACK );
+
+//  Early TOK for next sequence run read by acquisition loop poll, collected later 
+    ok &= tst_put( tst_slv, MSG_TOK" 8" );
+    usleep( 100 * TIM_TICK );
+    msg_poll( NULL, 0 );
+    ok &= tst_get( tst_slv, NULL );
+    ok &= tst_chk( tst_hsk() && msg_chk( tst_tok[0], MSG_TOK" 8", 5 ), "Early TOK collected" );
+    ok &= tst_get( tst_slv, MSG_ACK );
+
+//  TOK read by main thread waiting for FOCDONE, collected by handshake thread started later 
+    ok &= tst_put( tst_slv, MSG_TOK" 9" );
+    ok &= !msg_wait( 1, msg, sizeof(msg)-1, &len, MSG_FDN, strlen(MSG_FDN) );
+    utl_task_run( &hsk, "HSK", tst_hsk );
+    ok &= tst_chk( utl_task_wait( &hsk ) && msg_chk( tst_tok[0], MSG_TOK" 9", 5 ), "TOK held by focus wait" );
+    ok &= tst_get( tst_slv, MSG_ACK );
+
+//  Slave ACK to handshake thread may be read by main thread waiting for FOCDONE 
+    utl_task_run( &hsk, "ROT", tst_rot );
+    ok &= tst_get( tst_slv, MSG_ROT );
+    ok &= tst_put( tst_slv, MSG_ACK );
+    usleep( 100 * TIM_TICK );
+    ok &= tst_put( tst_cmd, MSG_FDN" 2.0000" );
+    ok &= tst_chk( msg_wait( TST_TMO, msg, sizeof(msg)-1, &len, MSG_FDN, strlen(MSG_FDN) ), "FOCDONE" );
+    ok &= tst_chk( utl_task_wait( &hsk ), "ROT ACK" );
+    ok &= tst_get( tst_cmd, MSG_ACK ) && tst_get( tst_slv, NULL );
+
+    return ok;
+}
+
+
+/** @brief     Stand-in master frame receiver. Reads whole frames until told to stall 
+  *
+  * @param[in] *arg = unused
+  *
+  * @return    NULL
+  */
+static void *tst_rcv( void *arg )
+{
+    shm_frm_t hdr;
+    char     *pix = malloc( 2 * tst_cam.SensorWidth * tst_cam.SensorHeight );
+    int       fd  = accept( tst_lsn, NULL, NULL );
+
+    while ( !tst_stall && recv( fd, &hdr, sizeof(hdr), MSG_WAITALL ) == sizeof(hdr) &&
+                          recv( fd, pix, hdr.bytes, MSG_WAITALL ) == hdr.bytes )
+    {
+        strcpy( tst_last, hdr.name );
+        tst_frames++;
+    }
+
+    free( pix );
+    return NULL;
+}
+
+
+/** @brief     Slave frame transfer. Frames reach the master whole and passing on a frame never 
+  *            waits on the network, even when the master stops reading. Master is a stand-in.
+  *
+  * @return    true | false = Pass | Fail 
+  */
+static bool tst_xfr( void )
+{
+    char      name[MAX_STR];
+    int       sent  = 0;
+    double    worst = 0.0;
+    uint16_t *pix;
+    pthread_t thread;
+    struct sockaddr_in adr = { .sin_family = AF_INET, .sin_port = htons( TST_XFR ), .sin_addr.s_addr = htonl( INADDR_LOOPBACK ) };
+    struct timespec beg;
+    struct timespec end;
+    bool   ok = true;
+
+    mop_master = false;
+    xfr_port   = TST_XFR;
+    ipmaster   = TST_MASTER;
+    tst_cam.SensorWidth  = 1024;
+    tst_cam.SensorHeight = 1024;
+    pix = calloc( tst_cam.SensorWidth * tst_cam.SensorHeight, sizeof(uint16_t) );
+
+    if ( (tst_lsn = socket( AF_INET, SOCK_STREAM, 0 )) < 0 ||
+         setsockopt( tst_lsn, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int) ) < 0 ||
+         bind( tst_lsn, (struct sockaddr *)&adr, sizeof(adr) ) < 0 || listen( tst_lsn, 1 ) < 0 ||
+         !xfr_init( &tst_cam ) || pthread_create( &thread, NULL, tst_rcv, NULL ) )
+        return mop_log( false, LOG_SYS, FAC, "tst_xfr() %s", strerror(errno) ); 
+
+//  Master reading, every frame arrives 
+    for ( int i = 0; i < 3; i++ )
+    {
+        snprintf( name, sizeof(name), "x_e_test_%i"FTS_SFX, i );
+        ok &= xfr_put( &tst_cam, 0, name, pix, 2 * tst_cam.SensorWidth * tst_cam.SensorHeight );
+        usleep( 100 * TIM_TICK );
+    }
+    ok &= tst_chk( tst_frames == 3 && strstr( tst_last, "_2"FTS_SFX ), "Frames received" );
+
+//  Master stalled, frames are dropped rather than wait 
+    tst_stall = true;
+    usleep( 100 * TIM_TICK );
+    for ( int i = 0; i < 50; i++ )
+    {
+        clock_gettime( CLOCK_MONOTONIC, &beg );
+        sent += xfr_put( &tst_cam, 0, name, pix, 2 * tst_cam.SensorWidth * tst_cam.SensorHeight );
+        clock_gettime( CLOCK_MONOTONIC, &end );
+        worst = fmax( worst, utl_ts_dif( &end, &beg ) );
+    }
+    ok &= tst_chk( sent < 50, "Frames dropped with master stalled" );
+    ok &= tst_chk( worst < TST_PUT, "xfr_put() waited on the network" );
+    mop_log( true, LOG_INF, FAC, "Stalled master. %i of 50 frames queued. Worst xfr_put() %.4fs", sent, worst );
+
+    free( pix );
+    return ok;
+}
+
+
+/** @brief     Stand-in filter wheel. Replies to each request with its position, 0 while moving.
+  *            A request for a new position takes TST_WHL to complete.
+  *
+  * @param[in] *arg = unused
+  *
+  * @return    NULL
+  */
+static void *tst_wheel( void *arg )
+{
+    char   req[2];
+    char   rep[2] = {0,0};
+    int    pos = 0;
+    struct pollfd   pfd = { .fd = tst_pty, .events = POLLIN };
+    struct timespec now;
+    struct timespec end = {0};
+
+    for(;;)
+    {
+        if ( poll( &pfd, 1, -1 ) <= 0 || 2 != read( tst_pty, req, 2 ))
+            continue;
+        tst_reqs++;
+
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        if ( req[0] != pos )
+        {
+            pos = req[0];
+            end = utl_dbl2ts( TST_WHL );
+            end = utl_ts_add( &now, &end );
+        }
+        rep[0] = utl_ts_dif( &now, &end ) >= 0.0 ? pos : 0;
+        if ( !tst_mute )
+            write( tst_pty, rep, 2 );
+    }
+
+    return NULL;
+}
+
+
+/** @brief     Filter wheel timing with a pty stand-in. Move returns at once and the wait only blocks for
+  *            the rest of the move. A move to the current position does no I/O. A silent wheel times out.
+  *
+  * @return    true | false = Pass | Fail 
+  */
+static bool tst_whl( void )
+{
+    double    dur;
+    int       reqs;
+    pthread_t thread;
+    struct timespec beg;
+    struct timespec now;
+    bool   ok = true;
+
+    if ( (tst_pty = posix_openpt( O_RDWR|O_NOCTTY )) < 0 || grantpt( tst_pty ) || unlockpt( tst_pty ) ||
+         pthread_create( &thread, NULL, tst_wheel, NULL ) )
+        return mop_log( false, LOG_SYS, FAC, "tst_whl() %s", strerror(errno) ); 
+    whl_dev = ptsname( tst_pty );
+
+//  Init. moves to first position and waits 
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    ok &= tst_chk( whl_init( 1, TMO_WHL ), "whl_init()" );
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    dur = utl_ts_dif( &now, &beg );
+    ok &= tst_chk( dur > TST_WHL - TST_LAG && dur < TST_WHL + TST_LAG, "whl_init() time" );
+
+//  Move overlaps other work, wait only blocks for the rest 
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    ok &= tst_chk( whl_move( 3 ), "whl_move()" );
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    ok &= tst_chk( utl_ts_dif( &now, &beg ) < TST_LAG, "whl_move() waited" );
+    usleep( TIM_MICROSECOND * TST_WHL / 2 );
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    ok &= tst_chk( whl_wait( TMO_WHL ), "whl_wait()" );
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    dur = utl_ts_dif( &now, &beg );
+    ok &= tst_chk( dur > TST_WHL / 2 - TST_LAG && dur < TST_WHL / 2 + TST_LAG, "whl_wait() time" );
+    mop_log( true, LOG_INF, FAC, "Stand-in wheel move %.3fs. Wait after %.3fs work = %.3fs", TST_WHL, TST_WHL / 2, dur );
+
+//  Already in position 
+    reqs = tst_reqs;
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    ok &= tst_chk( whl_move( 3 ) && whl_wait( TMO_WHL ), "Already in position" );
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    usleep( 20 * TIM_TICK );
+    ok &= tst_chk( reqs == tst_reqs && utl_ts_dif( &now, &beg ) < TST_LAG / 10, "Already in position did I/O" );
+
+//  Silent wheel times out 
+    tst_mute = true;
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    ok &= tst_chk( whl_move( 2 ) && !whl_wait( 200 ), "whl_wait() silent wheel" );
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    dur = utl_ts_dif( &now, &beg );
+    ok &= tst_chk( dur > 0.2 - TST_LAG && dur < 0.2 + TST_LAG, "whl_wait() timeout time" );
+
+    return ok;
+}
+
+
+/** @brief     Build a frame as the camera does. Frame data, timestamp and frame info blocks, each followed
+  *            by its CID and length. 
+  *
+  * @param[out] *buf    = buffer 
+  * @param[in]   width  = [px] width 
+  * @param[in]   height = [px] height 
+  * @param[in]   stride = [bytes] row stride 
+  * @param[in]   enc    = CAM_MD_ENC_xxx 
+  * @param[in]   ticks  = timestamp 
+  *
+  * @return    Frame size [bytes] 
+  */
+static size_t tst_frame( AT_U8 *buf, int width, int height, int stride, int enc, uint64_t ticks )
+{
+    AT_U8   *ptr = buf + (size_t)stride * height;
+    uint32_t fld[2];
+    uint16_t info[4] = { stride, enc, width, height };
+
+    fld[0] = CAM_MD_FRAME;
+    fld[1] = ptr - buf + CAM_MD_FIELD;
+    memcpy( ptr, fld, sizeof(fld) );
+    ptr += sizeof(fld);
+
+    memcpy( ptr, &ticks, sizeof(ticks) );
+    fld[0] = CAM_MD_TICKS;
+    fld[1] = sizeof(ticks) + CAM_MD_FIELD;
+    memcpy( ptr + sizeof(ticks), fld, sizeof(fld) );
+    ptr += sizeof(ticks) + sizeof(fld);
+
+    memcpy( ptr, info, sizeof(info) ); // Encoding is a byte followed by a reserved byte 
+    fld[0] = CAM_MD_INFO;
+    fld[1] = sizeof(info) + CAM_MD_FIELD;
+    memcpy( ptr + sizeof(info), fld, sizeof(fld) );
+    ptr += sizeof(info) + sizeof(fld);
+
+    return ptr - buf;
+}
+
+
+/** @brief     Check a decode stayed inside its buffer 
+  *
+  * @param[in] *buf  = buffer 
+  * @param[in]  size = buffer size 
+  * @param[in] *md   = decoded metadata 
+  *
+  * @return    true | false = Inside | Outside 
+  */
+static bool tst_inside( AT_U8 *buf, size_t size, cam_md_t *md )
+{
+    return md->pix == buf && md->bytes <= size && md->blocks <= CAM_MD_BLOCKS;
+}
+
+
+/** @brief     Metadata parser. A camera frame decodes whole. A frame data block that does not start the 
+  *            buffer is rejected. Random trailers and bit flips are fuzzed and any accepted decode must 
+  *            stay inside the buffer.
+  *
+  * @return    true | false = Pass | Fail 
+  */
+static bool tst_meta( void )
+{
+    static AT_U8 buf[4096];
+    AT_U8   *rnd;
+    size_t   size;
+    size_t   n;
+    uint32_t len;
+    long     good = 0;
+    cam_md_t md;
+    bool     ok = true;
+
+    size = tst_frame( buf, 16, 16, 40, CAM_MD_ENC_16, 123456789ULL );
+    ok &= tst_chk( cam_meta( buf, size, &md ) && tst_inside( buf, size, &md ) && md.blocks == 3 &&
+                   md.has_ticks && md.ticks == 123456789ULL && md.has_info && md.stride == 40 &&
+                   md.width == 16 && md.height == 16 && md.enc == CAM_MD_ENC_16 && md.bytes == 40 * 16, "Frame decoded" );
+
+//  Frame data block after a gap 
+    size = tst_frame( buf + 8, 16, 16, 40, CAM_MD_ENC_16, 1 );
+    ok &= tst_chk( !cam_meta( buf, size + 8, &md ), "Frame data not at start accepted" );
+
+    srand( 1 );
+    for ( int i = 0; i < TST_FUZZ; i++ )
+    {
+//      Random bytes, half with a plausible length field 
+        n   = 8 + rand() % 64;
+        rnd = malloc( n );
+        for ( size_t j = 0; j < n; j++ )
+            rnd[j] = rand();
+        if ( rand() & 1 )
+        {
+            len = rand() % n;
+            memcpy( rnd + n - CAM_MD_FIELD, &len, CAM_MD_FIELD );
+        }
+        if ( cam_meta( rnd, n, &md ) && ++good && !tst_inside( rnd, n, &md ) )
+            ok = tst_chk( false, "Random decode outside buffer" );
+        free( rnd );
+
+//      Camera frame with a bit flipped in its trailer 
+        size = tst_frame( buf, 16, 16, 32, CAM_MD_ENC_16, i );
+        buf[ size - 1 - rand() % 48 ] ^= 1 << ( rand() % 8 );
+        if ( cam_meta( buf, size, &md ) && !tst_inside( buf, size, &md ) )
+            ok = tst_chk( false, "Flipped decode outside buffer" );
+    }
+    mop_log( true, LOG_INF, FAC, "Metadata fuzz %i random, %li accepted, %i flipped", TST_FUZZ, good, TST_FUZZ );
+
+    return ok;
+}
+
+
+/** @brief     Time a number of unpacks of one frame 
+  *
+  * @param[in] *cam  = pointer to camera info structure, buffer 0 filled 
+  * @param[in] *what = case description 
+  *
+  * @return    true | false = Unpacked in place | Copied 
+  */
+static bool bch_unpack( mop_cam_t *cam, char *what )
+{
+    AT_U8 *pix = NULL;
+    double dur;
+    struct timespec beg;
+    struct timespec end;
+
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    for ( int i = 0; i < TST_BCH; i++ )
+        pix = fts_mono16( cam, 0 );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    dur = utl_ts_dif( &end, &beg ) / TST_BCH;
+
+    printf( "%-24s %9.1f us/frame %8.2f GB/s %s\n", what, TIM_MICROSECOND * dur, 
+            2.0 * img_mono16size / dur / 1e9, pix == cam->ImageBuffer[0] ? "in place" : "copied" );
+
+    return pix == cam->ImageBuffer[0];
+}
+
+
+/** @brief     Benchmark metadata decode and Mono16 unpacking of full frames, unpadded and padded rows 
+  *
+  * @return    true | false = Pass | Fail 
+  */
+static bool bch_mono16( void )
+{
+    static mop_cam_t cam;
+    cam_md_t md;
+    size_t   size;
+    double   dur;
+    volatile uint64_t ticks = 0;
+    struct timespec beg;
+    struct timespec end;
+    bool     ok = true;
+
+    img_mono16size     = TST_BCH_W * TST_BCH_H;
+    img_mono16         = aligned_alloc( SHM_ALIGN, 2 * img_mono16size );
+    cam.ImageBuffer[0] = aligned_alloc( SHM_ALIGN, ( 2 * TST_BCH_W + TST_BCH_PAD ) * TST_BCH_H + SHM_ALIGN );
+    memset( cam.ImageBuffer[0], 1, ( 2 * TST_BCH_W + TST_BCH_PAD ) * TST_BCH_H );
+
+    size = tst_frame( cam.ImageBuffer[0], TST_BCH_W, TST_BCH_H, 2 * TST_BCH_W, CAM_MD_ENC_16, 1 );
+    clock_gettime( CLOCK_MONOTONIC, &beg );
+    for ( int i = 0; i < TST_BCH * 1000; i++ )
+    {
+        cam_meta( cam.ImageBuffer[0], size, &md );
+        ticks += md.ticks;
+    }
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    dur = utl_ts_dif( &end, &beg ) / ( TST_BCH * 1000 );
+    printf( "%-24s %9.1f ns/frame\n", "cam_meta()", 1e9 * dur );
+
+    cam.ImageSizeBytes = size;
+    ok &= tst_chk(  bch_unpack( &cam, "Mono16 unpadded" ), "Unpadded frame copied" );
+
+    cam.ImageSizeBytes = tst_frame( cam.ImageBuffer[0], TST_BCH_W, TST_BCH_H, 2 * TST_BCH_W + TST_BCH_PAD, CAM_MD_ENC_16, 1 );
+    ok &= tst_chk( !bch_unpack( &cam, "Mono16 padded rows" ), "Padded frame not copied" );
+
+    free( cam.ImageBuffer[0] );
+    free( img_mono16 );
+    return ok;
+}
+
+
+static tst_t tst_list[] = { { "msg",    tst_msg    }, { "xfr",  tst_xfr  }, { "whl", tst_whl }, 
+                            { "meta",   tst_meta   }, 
+                            { "mono16", bch_mono16, true } };
+
+
+/** @brief     Main
+  *
+  * @param[in] argc = argument count
+  * @param[in] argv = test or benchmark names. None = all tests 
+  *
+  * @return    EXIT_SUCCESS | EXIT_FAILURE
+  */
+int main( int argc, char *argv[] )
+{
+    int  fail = 0;
+    bool run;
+    bool ok;
+
+    log_fp = stdout; // Output to screen
+    for ( int i = 0; i < sizeof(tst_list)/sizeof(tst_list[0]); i++ )
+    {
+        run = argc < 2 && !tst_list[i].bench;
+        for ( int j = 1; j < argc; j++ )
+            run |= !strcmp( argv[j], tst_list[i].name );
+        if ( !run )
+            continue;
+
+        if ( !( ok = tst_list[i].fn() ))
+            fail++;
+        printf( "%-8s %s\n", tst_list[i].name, ok ? "PASS" : "FAIL" );
+    }
+
+    return fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}